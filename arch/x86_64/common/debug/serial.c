@@ -18,43 +18,218 @@
 /*********************************************************************************/
 
 #include <debug/serial.h>
+#include <firmware/hwmgmnt.h>
+#include <firmware/serial.h>
 #include <arch/cpu/cpu.h>
+#include <print.h>
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
-#define COM1 0x3f8
+// UART input clock divided by 16; boards with faster clocks can override it
+#ifndef SERIAL_BASE_CLOCK
+#define SERIAL_BASE_CLOCK 115200
+#endif
 
-static int is_tx_empty(void)
+#define UART_THR 0 // transmit holding register
+#define UART_DLL 0 // divisor latch, low byte
+#define UART_IER 1 // interrupt enable
+#define UART_DLM 1 // divisor latch, high byte
+#define UART_IIR 2 // interrupt identification (read)
+#define UART_FCR 2 // FIFO control (write)
+#define UART_LCR 3 // line control
+#define UART_MCR 4 // modem control
+#define UART_LSR 5 // line status
+#define UART_SCR 7 // scratch
+
+#define UART_LCR_8N1 0x03
+#define UART_LCR_DLAB 0x80
+#define UART_LSR_THRE 0x20
+#define UART_MCR_DTR_RTS_OUT2 0x0b
+
+// enable and clear both FIFOs, 64-byte mode on 16750s, 14 byte RX trigger
+#define UART_FCR_SETUP 0xe7
+
+#define UART_IIR_FIFO 0xc0
+#define UART_IIR_FIFO64 0x20
+
+static const uint16_t com_ports[] = {0x3f8, 0x2f8, 0x3e8, 0x2e8};
+
+static struct {
+	uint16_t base;
+	uint32_t fifo_depth; // bytes that can be written per THRE
+	bool present;
+	bool use_firmware;
+} uart = {
+	.base = 0x3f8,
+	.fifo_depth = 1, // until the FIFO has been probed
+	.present = true,
+	.use_firmware = false,
+};
+
+static void uart_write(const uint8_t *data, size_t len)
 {
-	return inb(COM1 + 5) & 0x20;
+	if (!uart.present) {
+		return;
+	}
+
+	while (len > 0) {
+		size_t burst = (len < uart.fifo_depth) ? len : uart.fifo_depth;
+
+		// THRE means the whole FIFO is empty, so a full burst fits
+		while ((inb(uart.base + UART_LSR) & UART_LSR_THRE) == 0);
+		for (size_t i = 0; i < burst; i++) {
+			outb(uart.base + UART_THR, data[i]);
+		}
+
+		data += burst;
+		len -= burst;
+	}
 }
 
-void serial_init(void)
+void serial_init(uint16_t port, uint32_t baud)
 {
-	// TODO: Initialize all COM ports
-	outb(COM1 + 1, 0x00);
-	outb(COM1 + 3, 0x80);
-	outb(COM1, 0x03);
-	outb(COM1 + 1, 0x00);
-	outb(COM1 + 3, 0x03);
-	outb(COM1 + 2, 0xC7);
-	outb(COM1 + 4, 0x0B);
-	outb(COM1 + 4, 0x0F);
+	uint32_t divisor;
+	uint8_t iir;
+
+	uart.base = port;
+
+	outb(port + UART_SCR, 0xae);
+	uart.present = (inb(port + UART_SCR) == 0xae);
+	if (!uart.present) {
+		return;
+	}
+
+	outb(port + UART_IER, 0x00);
+	if (baud != 0) {
+		divisor = SERIAL_BASE_CLOCK / baud;
+		if (divisor == 0) {
+			divisor = 1;
+		}
+
+		outb(port + UART_LCR, UART_LCR_DLAB);
+		outb(port + UART_DLL, divisor & 0xff);
+		outb(port + UART_DLM, (divisor >> 8) & 0xff);
+	}
+
+	// the 64-byte FIFO can only be enabled while DLAB is set
+	outb(port + UART_LCR, UART_LCR_DLAB);
+	outb(port + UART_FCR, UART_FCR_SETUP);
+	outb(port + UART_LCR, UART_LCR_8N1);
+	outb(port + UART_MCR, UART_MCR_DTR_RTS_OUT2);
+
+	iir = inb(port + UART_IIR);
+	if ((iir & UART_IIR_FIFO) != UART_IIR_FIFO) {
+		uart.fifo_depth = 1;
+	} else if (iir & UART_IIR_FIFO64) {
+		uart.fifo_depth = 64;
+	} else {
+		uart.fifo_depth = 16;
+	}
 }
 
-void serial_send(char c)
+void serial_configure(uint32_t port, uint32_t baud)
 {
-	while (is_tx_empty() == 0);
-	outb(COM1, c);
+	uint16_t spcr_port;
+	uint32_t spcr_baud;
+	uint32_t index;
+
+	if (port == 0 && fw_get_spcr_port(&spcr_port, &spcr_baud)) {
+		port = spcr_port;
+		if (baud == 0) {
+			baud = spcr_baud;
+		}
+	} else if (port >= 1 && port <= sizeof(com_ports) / sizeof(com_ports[0])) {
+		port = com_ports[port - 1];
+	}
+
+	// with nothing to go by, the firmware's serial driver knows best; the
+	// UART is only taken over once the firmware lets go of it, and only if
+	// its device path says which one it is
+	if (port == 0) {
+		uart.use_firmware = (fw_serial_init(baud) == 0);
+		if (!uart.use_firmware) {
+			port = com_ports[0];
+		} else if (fw_serial_get_com_index(&index) == 0 && index < sizeof(com_ports) / sizeof(com_ports[0])) {
+			port = com_ports[index];
+		}
+	}
+
+	if (uart.use_firmware) {
+		uart.base = port;
+	} else {
+		serial_init(port, baud != 0 ? baud : SERIAL_DEFAULT_BAUD);
+	}
+	debug("Serial: port 0x%x, %u byte FIFO%s\r\n", uart.base, uart.fifo_depth,
+		  uart.use_firmware ? ", through the firmware" : "");
 }
 
-void serial_sendstr(char *s)
+void serial_release_firmware(void)
 {
-	while (*s != '\0') {
-		if (*s == '\r') {
-			s++;
+	if (!uart.use_firmware) {
+		return;
+	}
+
+	uart.use_firmware = false;
+	fw_serial_release();
+
+	// writing to a guessed port could land on anything
+	if (uart.base == 0) {
+		uart.present = false;
+		return;
+	}
+
+	// keep whatever baud rate the firmware was using
+	serial_init(uart.base, 0);
+}
+
+void serial_write_raw(const void *data, size_t len)
+{
+	if (uart.use_firmware && fw_serial_write(data, len) == 0) {
+		return;
+	}
+
+	uart_write(data, len);
+}
+
+void serial_write(const char *s, size_t len)
+{
+	char chunk[128];
+	size_t used = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == '\r') {
 			continue;
 		}
-		serial_send(*s++);
+		if (s[i] == '\n') {
+			chunk[used++] = '\r';
+		}
+		chunk[used++] = s[i];
+
+		if (used >= sizeof(chunk) - 1) {
+			serial_write_raw(chunk, used);
+			used = 0;
+		}
+	}
+
+	if (used > 0) {
+		serial_write_raw(chunk, used);
 	}
-}
\ No newline at end of file
+}
+
+void serial_send(char c)
+{
+	serial_write_raw(&c, 1);
+}
+
+void serial_sendstr(char *s)
+{
+	size_t len = 0;
+
+	while (s[len] != '\0') {
+		len++;
+	}
+
+	serial_write(s, len);
+}
@@ -20,6 +20,7 @@
 #include <arch/cpu/cpu.h>
 #include <arch/mm/paging.h>
 #include <firmware/memmap.h>
+#include <lib/memstat.h>
 #include <lib/string.h>
 #include <print.h>
 #include <axboot.h>
@@ -32,69 +33,193 @@ struct page_table *pml4;
 
 struct memory_map_info *g_memmap;
 
+static uint32_t page_size_flags = 0;
+
+// pages handed out from the start of each memory map entry
+static uint64_t *used_pages = NULL;
+
+// firmware reports page 0 and the rest of low memory as usable, but it's
+// never handed out: a table at 0 would look like a NULL pointer, and the
+// real-mode area is left for the kernel and the AP trampoline
+#define LOW_MEMORY_LIMIT 0x100000
+
+static struct paging_stats stats = {0};
+
+static uint32_t preferred_proximity = MEMMAP_NO_PROXIMITY;
+
+void paging_set_preferred_proximity(uint32_t proximity)
+{
+	preferred_proximity = proximity;
+}
+
 static void *alloc_mmap(uint64_t np)
 {
-	static void *next_page_address = NULL;
-	static uint64_t cur_entry = 0;
-	static uint64_t remaining_pages = 0;
+	// mirrored and local, mirrored, local, then anything; persistent and
+	// specific-purpose memory isn't MemoryMapUsable so it's never touched.
+	// Every pass scans the whole map: an entry skipped by one tier may
+	// still serve a later one.
+	for (int pass = 0; pass < 4; pass++) {
+		bool mirrored = pass < 2;
+		bool local = (pass % 2) == 0;
+
+		if (local && preferred_proximity == MEMMAP_NO_PROXIMITY) {
+			continue;
+		}
 
-	if (remaining_pages < np) {
-		uint32_t i = cur_entry + 1;
-		for (; i < g_memmap->entry_count; i++) {
+		for (uint64_t i = 0; i < g_memmap->entry_count; i++) {
 			struct memory_map_entry *entry = &g_memmap->entries[i];
 
-			if (entry->type == MemoryMapUsable && (entry->length / PAGE_SIZE) >= np) {
-				cur_entry = i;
-				remaining_pages = ((entry->length + PAGE_SIZE - 1) / PAGE_SIZE) - np;
-				next_page_address = (void *)(entry->base + (np * PAGE_SIZE));
-				return (void *)entry->base;
+			if (entry->type != MemoryMapUsable ||
+				(mirrored && !(entry->flags & MEMMAP_FLAG_MIRRORED)) ||
+				(local && entry->proximity != preferred_proximity)) {
+				continue;
 			}
-		}
 
-		if (i >= g_memmap->entry_count) {
-			debug("Couldn't find any memory to allocate memory for.\r\n");
-			return NULL;
+			// used_pages[] already covers low memory, see alloc_init()
+			if ((entry->length / PAGE_SIZE) - used_pages[i] >= np) {
+				void *page = (void *)(entry->base + (used_pages[i] * PAGE_SIZE));
+				used_pages[i] += np;
+				return page;
+			}
 		}
 	}
 
-	remaining_pages -= np;
-	void *page = next_page_address;
-	next_page_address = (void *)((uint8_t *)page + (np * PAGE_SIZE));
+	debug("Couldn't find any memory to allocate memory for.\r\n");
+	return NULL;
+}
+
+// Pages of an entry that lie below LOW_MEMORY_LIMIT
+static uint64_t low_pages(struct memory_map_entry *entry)
+{
+	uint64_t limit = LOW_MEMORY_LIMIT;
 
-	return page;
+	if (entry->base >= limit) {
+		return 0;
+	}
+	if (entry->length < limit - entry->base) {
+		return entry->length / PAGE_SIZE;
+	}
+	return (limit - entry->base) / PAGE_SIZE;
 }
 
-int paging_init(struct memory_map_info *memmap)
+// The usage counters are carved out of the first usable entry they fit
+// in, so alloc_mmap() can never hand the same memory out again. Low
+// memory starts out counted as used.
+static int alloc_init(struct memory_map_info *memmap)
 {
+	uint64_t np = ROUND_UP(memmap->entry_count * sizeof(uint64_t), PAGE_SIZE) / PAGE_SIZE;
+
+	g_memmap = memmap;
+	used_pages = NULL;
+
+	for (uint64_t i = 0; i < memmap->entry_count; i++) {
+		struct memory_map_entry *entry = &memmap->entries[i];
+		uint64_t low = low_pages(entry);
+
+		if (entry->type == MemoryMapUsable && (entry->length / PAGE_SIZE) - low >= np) {
+			used_pages = (uint64_t *)(entry->base + (low * PAGE_SIZE));
+			for (uint64_t j = 0; j < memmap->entry_count; j++) {
+				used_pages[j] = low_pages(&memmap->entries[j]);
+			}
+			used_pages[i] += np;
+			return 0;
+		}
+	}
+
+	debug("Couldn't find any memory to track page allocations in.\r\n");
+	return 1;
+}
+
+int paging_init(struct memory_map_info *memmap, uint64_t hhdm_base, uint32_t page_sizes)
+{
+	uint32_t eax, ebx, ecx, edx;
+
 	// disable write protection
 	//uint64_t cr0 = read_cr0();
 	//cr0 &= ~(1 << 16);
 	//write_cr0(cr0);
 
-	g_memmap = memmap;
+	memset(&stats, 0, sizeof(stats));
+	if (alloc_init(memmap) != 0) {
+		return 1;
+	}
+
 	pml4 = alloc_mmap(1);
+	if (pml4 == NULL) {
+		return 1;
+	}
+	stats.tables[0]++;
+	memstat_alloc(MemStatPageTables, PAGE_SIZE);
 	memset(pml4, 0, sizeof(struct page_table));
 
+	// 1 GiB pages are optional
+	if (page_sizes & PAGING_PAGE_1G) {
+		cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+		if (!(edx & (1 << 26))) {
+			debug("1 GiB pages are not supported, falling back to 2 MiB pages\r\n");
+			page_sizes = (page_sizes & ~PAGING_PAGE_1G) | PAGING_PAGE_2M;
+		}
+	}
+	page_size_flags = page_sizes;
+
 	// identity map the memmap
 	debug("Identity mapping the entire memory map...\r\n");
 	for (uint32_t i = 0; i < memmap->entry_count; i++) {
 		struct memory_map_entry *entry = &memmap->entries[i];
 
-		for (uint64_t j = 0; j < (entry->length + PAGE_SIZE - 1) / PAGE_SIZE; j++) {
-			paging_identity_map(entry->base + (j * PAGE_SIZE));
-			paging_map(entry->base + (j * PAGE_SIZE), entry->base + 0xffff800000000000 + (j * PAGE_SIZE));
+		uint64_t before = paging_get_table_pages();
+
+		if (paging_map_range(entry->base, entry->base, entry->length) != 0) {
+			return 1;
+		}
+		stats.identity_tables += paging_get_table_pages() - before;
+
+		if (hhdm_base != 0) {
+			before = paging_get_table_pages();
+			if (paging_map_range(entry->base, entry->base + hhdm_base, entry->length) != 0) {
+				return 1;
+			}
+			stats.hhdm_tables += paging_get_table_pages() - before;
 		}
 	}
 
 	return 0;
 }
 
-void paging_identity_map(uint64_t addr)
+int paging_identity_map(uint64_t addr)
+{
+	return paging_map(addr, addr);
+}
+
+// level is where the table sits below the PML4: 1 = PDPT, 2 = PD, 3 = PT.
+// *table is NULL if a large page already covers the entry. Returns 1 if
+// a new table couldn't be allocated.
+static int paging_get_table(struct page_table *parent, uint16_t index, int level, struct page_table **table)
 {
-	paging_map(addr, addr);
+	const int flags = PTE_PRESENT | PTE_READ_WRITE;
+
+	*table = NULL;
+	if (!(parent->entries[index] & PTE_PRESENT)) {
+		void *page = alloc_mmap(1);
+		if (page == NULL) {
+			return 1;
+		}
+		memset(page, 0, sizeof(struct page_table));
+		parent->entries[index] = (uint64_t)page | flags;
+		stats.tables[level]++;
+		memstat_alloc(MemStatPageTables, PAGE_SIZE);
+	}
+
+	// already covered by a large page
+	if (parent->entries[index] & PTE_PAGE_SIZE) {
+		return 0;
+	}
+
+	*table = (struct page_table *)(parent->entries[index] & PHYS_PAGE_ADDR_MASK);
+	return 0;
 }
 
-void paging_map(uint64_t phys, uint64_t virt)
+int paging_map(uint64_t phys, uint64_t virt)
 {
 	const int flags = PTE_PRESENT | PTE_READ_WRITE;
 
@@ -103,30 +228,105 @@ void paging_map(uint64_t phys, uint64_t virt)
 	uint16_t pd_index = (virt >> 21) & 0x1ff;
 	uint16_t pt_index = (virt >> 12) & 0x1ff;
 
-	if (!(pml4->entries[pml4_index] & PTE_PRESENT)) {
-		void *pdpt = alloc_mmap(1);
-		memset(pdpt, 0, sizeof(struct page_table));
-		pml4->entries[pml4_index] = (uint64_t)pdpt | flags;
+	struct page_table *pdpt = NULL, *pd = NULL, *pt = NULL;
+	if (paging_get_table(pml4, pml4_index, 1, &pdpt) != 0 ||
+		(pdpt != NULL && paging_get_table(pdpt, pdpt_index, 2, &pd) != 0) ||
+		(pdpt != NULL && pd != NULL && paging_get_table(pd, pd_index, 3, &pt) != 0)) {
+		return 1;
 	}
 
-	struct page_table *pdpt = (struct page_table *)(pml4->entries[pml4_index] & PHYS_PAGE_ADDR_MASK);
-	if (!(pdpt->entries[pdpt_index] & PTE_PRESENT)) {
-		void *pd = alloc_mmap(1);
-		memset(pd, 0, sizeof(struct page_table));
-		pdpt->entries[pdpt_index] = (uint64_t)pd | flags;
-	}
-
-	struct page_table *pd = (struct page_table *)(pdpt->entries[pdpt_index] & PHYS_PAGE_ADDR_MASK);
-	if (!(pd->entries[pd_index] & PTE_PRESENT)) {
-		void *pt = alloc_mmap(1);
-		memset(pt, 0, sizeof(struct page_table));
-		pd->entries[pd_index] = (uint64_t)pt | flags;
+	// covered by a large page
+	if (pdpt == NULL || pd == NULL || pt == NULL) {
+		return 0;
 	}
 
-	struct page_table *pt = (struct page_table *)(pd->entries[pd_index] & PHYS_PAGE_ADDR_MASK);
 	if (!(pt->entries[pt_index] & PTE_PRESENT)) {
 		pt->entries[pt_index] = (phys & PHYS_PAGE_ADDR_MASK) | flags;
 	}
+	return 0;
+}
+
+// Returns 0 if the range is mapped, or already covered by a large page,
+// -1 if a page table is in the way and smaller pages have to be used,
+// and 1 if a table couldn't be allocated
+static int paging_map_large(uint64_t phys, uint64_t virt, uint64_t size)
+{
+	const int flags = PTE_PRESENT | PTE_READ_WRITE | PTE_PAGE_SIZE;
+
+	uint16_t pml4_index = (virt >> 39) & 0x1ff;
+	uint16_t pdpt_index = (virt >> 30) & 0x1ff;
+	uint16_t pd_index = (virt >> 21) & 0x1ff;
+
+	struct page_table *pdpt, *pd;
+	if (paging_get_table(pml4, pml4_index, 1, &pdpt) != 0) {
+		return 1;
+	}
+	if (pdpt == NULL) {
+		return 0;
+	}
+
+	if (size == PAGE_SIZE_1G) {
+		// don't replace an existing page directory
+		if (pdpt->entries[pdpt_index] & PTE_PRESENT) {
+			return (pdpt->entries[pdpt_index] & PTE_PAGE_SIZE) ? 0 : -1;
+		}
+		pdpt->entries[pdpt_index] = (phys & PHYS_PAGE_ADDR_MASK) | flags;
+		return 0;
+	}
+
+	if (paging_get_table(pdpt, pdpt_index, 2, &pd) != 0) {
+		return 1;
+	}
+	if (pd == NULL) {
+		return 0;
+	}
+
+	// don't replace an existing page table
+	if (pd->entries[pd_index] & PTE_PRESENT) {
+		return (pd->entries[pd_index] & PTE_PAGE_SIZE) ? 0 : -1;
+	}
+	pd->entries[pd_index] = (phys & PHYS_PAGE_ADDR_MASK) | flags;
+	return 0;
+}
+
+int paging_map_range(uint64_t phys, uint64_t virt, uint64_t length)
+{
+	uint64_t end = phys + ROUND_UP(length, PAGE_SIZE);
+
+	phys = ROUND_DOWN(phys, PAGE_SIZE);
+	virt = ROUND_DOWN(virt, PAGE_SIZE);
+
+	while (phys < end) {
+		uint64_t size = PAGE_SIZE;
+		int status = -1;
+
+		if ((page_size_flags & PAGING_PAGE_1G) && end - phys >= PAGE_SIZE_1G &&
+			((phys | virt) & (PAGE_SIZE_1G - 1)) == 0) {
+			size = PAGE_SIZE_1G;
+			status = paging_map_large(phys, virt, size);
+		}
+
+		if (status < 0 && (page_size_flags & (PAGING_PAGE_2M | PAGING_PAGE_1G)) && end - phys >= PAGE_SIZE_2M &&
+			((phys | virt) & (PAGE_SIZE_2M - 1)) == 0) {
+			size = PAGE_SIZE_2M;
+			status = paging_map_large(phys, virt, size);
+		}
+
+		if (status < 0) {
+			size = PAGE_SIZE;
+			status = paging_map(phys, virt);
+		}
+
+		if (status != 0) {
+			debug("ERROR: Out of memory for page tables mapping 0x%llx\r\n", phys);
+			return status;
+		}
+
+		phys += size;
+		virt += size;
+	}
+
+	return 0;
 }
 
 void paging_unmap(uint64_t virt)
@@ -167,6 +367,16 @@ uint64_t paging_get_pml4(void)
 	return (uint64_t)pml4;
 }
 
+uint64_t paging_get_table_pages(void)
+{
+	return stats.tables[0] + stats.tables[1] + stats.tables[2] + stats.tables[3];
+}
+
+void paging_get_stats(struct paging_stats *out)
+{
+	*out = stats;
+}
+
 void *paging_allocate(size_t np)
 {
 	return alloc_mmap(np);
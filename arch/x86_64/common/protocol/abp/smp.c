@@ -0,0 +1,499 @@
+/*********************************************************************************/
+/* Module Name:  smp.c                                                           */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <arch/cpu/cpu.h>
+#include <arch/cpu/gdt.h>
+#include <arch/mm/paging.h>
+#include <firmware/hwmgmnt.h>
+#include <firmware/memory.h>
+#include <lib/memstat.h>
+#include <lib/numa.h>
+#include <lib/string.h>
+#include <lib/timestamp.h>
+#include <protocol/abp.h>
+#include <print.h>
+#include <axboot.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// The firmware takes its APs back in ExitBootServices(), so they are woken
+// again afterwards with one round of INIT, SIPI, SIPI sent to all of them
+// before each wait. The trampoline goes from real mode through a temporary
+// identity map onto the kernel's page tables, finds its mailbox by APIC ID
+// and spins there until the kernel stores a goto address.
+//
+
+#define SMP_DEFAULT_STACK_SIZE (4 * PAGE_SIZE)
+#define SMP_CHECKIN_TIMEOUT_US 100000
+
+// code and data, then the temporary PML4, PDPT and PD
+#define SMP_TRAMPOLINE_PAGES 4
+#define SMP_TRAMPOLINE_LIMIT 0x100000
+
+// trampoline data, at a fixed offset in the first page
+#define SMP_DATA 0x800
+#define SMP_DATA_GDTR 0x800
+#define SMP_DATA_PM_JUMP 0x810
+#define SMP_DATA_LM_JUMP 0x818
+#define SMP_DATA_TEMP_CR3 0x820
+#define SMP_DATA_CR4 0x824
+#define SMP_DATA_CR0 0x828
+#define SMP_DATA_EFER 0x82c
+#define SMP_DATA_KERNEL_CR3 0x830
+#define SMP_DATA_CPUS 0x838
+#define SMP_DATA_CPU_COUNT 0x840
+#define SMP_DATA_CHECKED_IN 0x848
+
+// struct abp_smp_cpu, as the trampoline sees it
+#define SMP_CPU_FLAGS 4
+#define SMP_CPU_STACK_TOP 24
+#define SMP_CPU_GOTO 40
+#define SMP_CPU_SIZE 64
+
+// 0x18 and 0x20 are the BSP's code and data selectors
+#define SMP_SEL_CODE64 0x18
+#define SMP_SEL_DATA64 0x20
+#define SMP_SEL_CODE32 0x28
+#define SMP_SEL_DATA32 0x30
+
+struct smp_trampoline_data {
+	uint16_t gdt_limit;
+	uint64_t gdt_base;
+	uint8_t reserved0[6];
+	uint32_t pm_entry;
+	uint16_t pm_selector;
+	uint16_t reserved1;
+	uint32_t lm_entry;
+	uint16_t lm_selector;
+	uint16_t reserved2;
+	uint32_t temp_cr3;
+	uint32_t cr4;
+	uint32_t cr0;
+	uint32_t efer;
+	uint64_t kernel_cr3;
+	uint64_t cpus;
+	uint64_t cpu_count;
+	uint32_t checked_in;
+	uint32_t reserved3;
+	struct gdt_descriptor gdt[7];
+} __attribute__((packed));
+
+_Static_assert(offsetof(struct smp_trampoline_data, checked_in) == SMP_DATA_CHECKED_IN - SMP_DATA, "trampoline data layout");
+_Static_assert(offsetof(struct abp_smp_cpu, stack_top) == SMP_CPU_STACK_TOP, "abp_smp_cpu layout");
+_Static_assert(offsetof(struct abp_smp_cpu, goto_address) == SMP_CPU_GOTO, "abp_smp_cpu layout");
+_Static_assert(sizeof(struct abp_smp_cpu) == SMP_CPU_SIZE, "abp_smp_cpu layout");
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+// Copied below 1 MiB and entered with CS = base >> 4; ebx/r15 hold the base
+__asm__(
+	".text\n"
+	".balign 16\n"
+	".globl smp_trampoline_start\n"
+	"smp_trampoline_start:\n"
+	".code16\n"
+	"cli\n"
+	"cld\n"
+	"movw %cs, %bx\n"
+	"movw %bx, %ds\n"
+	"movzwl %bx, %ebx\n"
+	"shll $4, %ebx\n"
+	"lgdtl " STR(SMP_DATA_GDTR) "\n"
+	"movl %cr0, %eax\n"
+	"orl $1, %eax\n"
+	"movl %eax, %cr0\n"
+	"ljmpl *" STR(SMP_DATA_PM_JUMP) "\n"
+
+	".code32\n"
+	".globl smp_trampoline_pm\n"
+	"smp_trampoline_pm:\n"
+	"movw $" STR(SMP_SEL_DATA32) ", %ax\n"
+	"movw %ax, %ds\n"
+	"movw %ax, %es\n"
+	"movw %ax, %ss\n"
+	"movl " STR(SMP_DATA_CR4) "(%ebx), %eax\n"
+	"movl %eax, %cr4\n"
+	"movl " STR(SMP_DATA_TEMP_CR3) "(%ebx), %eax\n"
+	"movl %eax, %cr3\n"
+	"movl $0xc0000080, %ecx\n"
+	"movl " STR(SMP_DATA_EFER) "(%ebx), %eax\n"
+	"xorl %edx, %edx\n"
+	"wrmsr\n"
+	// the BSP's CR0 also turns the caches back on
+	"movl " STR(SMP_DATA_CR0) "(%ebx), %eax\n"
+	"movl %eax, %cr0\n"
+	"ljmpl *" STR(SMP_DATA_LM_JUMP) "(%ebx)\n"
+
+	".code64\n"
+	".globl smp_trampoline_lm\n"
+	"smp_trampoline_lm:\n"
+	"movl %ebx, %r15d\n"
+	"movw $" STR(SMP_SEL_DATA64) ", %ax\n"
+	"movw %ax, %ds\n"
+	"movw %ax, %es\n"
+	"movw %ax, %fs\n"
+	"movw %ax, %gs\n"
+	"movw %ax, %ss\n"
+	"movq " STR(SMP_DATA_KERNEL_CR3) "(%r15), %rax\n"
+	"movq %rax, %cr3\n"
+
+	// x2APIC ID from leaf 0xb if there is one, the initial APIC ID otherwise
+	"xorl %eax, %eax\n"
+	"cpuid\n"
+	"cmpl $0xb, %eax\n"
+	"jb 1f\n"
+	"movl $0xb, %eax\n"
+	"xorl %ecx, %ecx\n"
+	"cpuid\n"
+	"testl %ebx, %ebx\n"
+	"jz 1f\n"
+	"movl %edx, %esi\n"
+	"jmp 2f\n"
+	"1:\n"
+	"movl $1, %eax\n"
+	"cpuid\n"
+	"shrl $24, %ebx\n"
+	"movl %ebx, %esi\n"
+
+	"2:\n"
+	"movq " STR(SMP_DATA_CPUS) "(%r15), %rdi\n"
+	"movq " STR(SMP_DATA_CPU_COUNT) "(%r15), %rcx\n"
+	"3:\n"
+	"testq %rcx, %rcx\n"
+	"jz 5f\n"
+	"cmpl %esi, (%rdi)\n"
+	"je 4f\n"
+	"addq $" STR(SMP_CPU_SIZE) ", %rdi\n"
+	"decq %rcx\n"
+	"jmp 3b\n"
+
+	// not in the list, nobody will ever start this one
+	"5:\n"
+	"cli\n"
+	"hlt\n"
+	"jmp 5b\n"
+
+	"4:\n"
+	"movq " STR(SMP_CPU_STACK_TOP) "(%rdi), %rsp\n"
+	"lock orl $" STR(ABP_SMP_CPU_PARKED) ", " STR(SMP_CPU_FLAGS) "(%rdi)\n"
+	"lock incl " STR(SMP_DATA_CHECKED_IN) "(%r15)\n"
+	"6:\n"
+	"pause\n"
+	"movq " STR(SMP_CPU_GOTO) "(%rdi), %rax\n"
+	"testq %rax, %rax\n"
+	"jz 6b\n"
+	"movq %rdi, %rcx\n"
+	"xorl %ebp, %ebp\n"
+	"pushq $0\n"
+	"jmpq *%rax\n"
+	".globl smp_trampoline_end\n"
+	"smp_trampoline_end:\n"
+);
+
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_pm[];
+extern uint8_t smp_trampoline_lm[];
+extern uint8_t smp_trampoline_end[];
+
+#define MSR_APIC_BASE 0x1b
+#define MSR_EFER 0xc0000080
+
+#define APIC_BASE_X2APIC (1 << 10)
+#define APIC_BASE_ADDR_MASK 0x000ffffffffff000
+
+#define EFER_LMA (1 << 10)
+
+#define CR4_LA57 (1 << 12)
+#define CR4_PCIDE (1 << 17)
+#define CR4_CET (1 << 23)
+
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define X2APIC_MSR_ICR 0x830
+
+#define ICR_INIT 0x00004500
+#define ICR_STARTUP 0x00004600
+#define ICR_PENDING (1 << 12)
+
+static struct {
+	uint8_t *trampoline;
+	void *block; // mailboxes, then the AP stacks
+	uint64_t block_size;
+	uint32_t ap_count;
+	bool x2apic;
+	uint64_t lapic_base;
+} smp_state;
+
+static void smp_delay_us(uint64_t us)
+{
+	uint64_t frequency = timestamp_get_frequency();
+
+	if (frequency == 0) {
+		// a write to port 0x80 takes about a microsecond
+		for (uint64_t i = 0; i < us; i++) {
+			outb(0x80, 0);
+		}
+		return;
+	}
+
+	uint64_t end = rdtsc() + us * (frequency / 1000000);
+	while (rdtsc() < end) {
+		cpu_pause();
+	}
+}
+
+// Like Linux, skip the 10 ms INIT delay where the vendor says it's not needed
+static bool smp_init_delay_needed(void)
+{
+	uint32_t eax, ebx, ecx, edx, family;
+	uint32_t vendor[3];
+
+	cpuid(0, 0, &eax, &vendor[0], &vendor[2], &vendor[1]);
+	cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+
+	family = (eax >> 8) & 0xf;
+	if (family == 0xf) {
+		family += (eax >> 20) & 0xff;
+	}
+
+	if (!memcmp(vendor, "GenuineIntel", 12) && family >= 6) {
+		return false;
+	}
+	if ((!memcmp(vendor, "AuthenticAMD", 12) || !memcmp(vendor, "HygonGenuine", 12)) && family >= 0xf) {
+		return false;
+	}
+
+	return true;
+}
+
+static void smp_send_ipi(uint32_t apic_id, uint32_t icr)
+{
+	if (smp_state.x2apic) {
+		wrmsr(X2APIC_MSR_ICR, ((uint64_t)apic_id << 32) | icr);
+		return;
+	}
+
+	volatile uint32_t *lapic = (volatile uint32_t *)smp_state.lapic_base;
+	lapic[LAPIC_ICR_HIGH / 4] = apic_id << 24;
+	lapic[LAPIC_ICR_LOW / 4] = icr;
+	while (lapic[LAPIC_ICR_LOW / 4] & ICR_PENDING) {
+		cpu_pause();
+	}
+}
+
+static void smp_build_trampoline(uint8_t *trampoline, struct abp_smp_info *smp)
+{
+	struct smp_trampoline_data *data = (struct smp_trampoline_data *)(trampoline + SMP_DATA);
+	uint64_t *pml4 = (uint64_t *)(trampoline + PAGE_SIZE);
+	uint64_t *pdpt = (uint64_t *)(trampoline + 2 * PAGE_SIZE);
+	uint64_t *pd = (uint64_t *)(trampoline + 3 * PAGE_SIZE);
+	uint64_t base = (uint64_t)trampoline;
+
+	memset(trampoline, 0, SMP_TRAMPOLINE_PAGES * PAGE_SIZE);
+	memcpy(trampoline, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+
+	// the first 2 MiB, identity mapped, for the jump into long mode
+	pml4[0] = (base + 2 * PAGE_SIZE) | PTE_PRESENT | PTE_READ_WRITE;
+	pdpt[0] = (base + 3 * PAGE_SIZE) | PTE_PRESENT | PTE_READ_WRITE;
+	pd[0] = PTE_PRESENT | PTE_READ_WRITE | PTE_PAGE_SIZE;
+
+	// the BSP's descriptors, and flat 32-bit ones for the way up
+	gdt_set_entry(&data->gdt[1], 0, 0xFFFF, 0x9a, 0x0a);
+	gdt_set_entry(&data->gdt[2], 0, 0xFFFF, 0x92, 0x0c);
+	gdt_set_entry(&data->gdt[3], 0, 0, 0x9a, 0x0a);
+	gdt_set_entry(&data->gdt[4], 0, 0, 0x92, 0x0c);
+	data->gdt[5] = (struct gdt_descriptor){ 0xffff, 0, 0, 0x9a, 0xf, 0xc, 0 };
+	data->gdt[6] = (struct gdt_descriptor){ 0xffff, 0, 0, 0x92, 0xf, 0xc, 0 };
+
+	data->gdt_limit = sizeof(data->gdt) - 1;
+	data->gdt_base = (uint64_t)data->gdt;
+	data->pm_entry = base + (smp_trampoline_pm - smp_trampoline_start);
+	data->pm_selector = SMP_SEL_CODE32;
+	data->lm_entry = base + (smp_trampoline_lm - smp_trampoline_start);
+	data->lm_selector = SMP_SEL_CODE64;
+	data->temp_cr3 = base + PAGE_SIZE;
+	data->cpus = (uint64_t)smp->cpus;
+	data->cpu_count = smp->cpu_count;
+}
+
+int abp_smp_prepare(struct abp_smp_info *smp, uint64_t stack_size)
+{
+	const struct fw_cpu *fw_cpus;
+	uint32_t fw_count;
+	uint32_t count = 0;
+	uint64_t mailbox_size;
+	uint8_t *stacks;
+
+	memset(smp, 0, sizeof(struct abp_smp_info));
+
+	if (smp_trampoline_end - smp_trampoline_start > SMP_DATA) {
+		log("ERROR: SMP trampoline overlaps its data\r\n");
+		return -1;
+	}
+
+	fw_cpus = fw_get_cpus(&fw_count);
+	if (fw_cpus == NULL) {
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < fw_count; i++) {
+		if ((fw_cpus[i].flags & FW_CPU_BSP) ||
+			(fw_cpus[i].flags & (FW_CPU_ENABLED | FW_CPU_HEALTHY)) == (FW_CPU_ENABLED | FW_CPU_HEALTHY)) {
+			count++;
+		}
+	}
+
+	if (count < 2) {
+		debug("SMP: the firmware reports no APs\r\n");
+		return -1;
+	}
+
+	stack_size = (stack_size != 0) ? ROUND_UP(stack_size, PAGE_SIZE) : SMP_DEFAULT_STACK_SIZE;
+	mailbox_size = ROUND_UP(count * sizeof(struct abp_smp_cpu), PAGE_SIZE);
+
+	smp_state.trampoline = fw_allocpages_below(SMP_TRAMPOLINE_PAGES, SMP_TRAMPOLINE_LIMIT, FwMemoryReclaimable);
+	if (smp_state.trampoline == NULL) {
+		log("ERROR: No memory below 1 MiB for the SMP trampoline\r\n");
+		return -1;
+	}
+
+	// the BSP keeps its own stack
+	smp_state.block_size = mailbox_size + (count - 1) * stack_size;
+	smp_state.block = fw_allocpages(smp_state.block_size / PAGE_SIZE, FwMemoryReclaimable);
+	if (smp_state.block == NULL) {
+		log("ERROR: Couldn't allocate %u AP stacks\r\n", count - 1);
+		fw_freepages(smp_state.trampoline, SMP_TRAMPOLINE_PAGES);
+		smp_state.trampoline = NULL;
+		return -1;
+	}
+	memset(smp_state.block, 0, mailbox_size);
+	memstat_alloc(MemStatStack, (count - 1) * stack_size);
+
+	smp->cpus = smp_state.block;
+	stacks = (uint8_t *)smp_state.block + mailbox_size;
+	for (uint32_t i = 0; i < fw_count; i++) {
+		const struct fw_cpu *fw_cpu = &fw_cpus[i];
+		struct abp_smp_cpu *cpu;
+
+		if (!(fw_cpu->flags & FW_CPU_BSP) &&
+			(fw_cpu->flags & (FW_CPU_ENABLED | FW_CPU_HEALTHY)) != (FW_CPU_ENABLED | FW_CPU_HEALTHY)) {
+			debug("SMP: skipping disabled or unhealthy CPU %u\r\n", fw_cpu->apic_id);
+			continue;
+		}
+
+		cpu = &smp->cpus[smp->cpu_count++];
+		cpu->apic_id = fw_cpu->apic_id;
+		cpu->package = fw_cpu->package;
+		cpu->core = fw_cpu->core;
+		cpu->thread = fw_cpu->thread;
+		cpu->proximity = numa_get_cpu_proximity(fw_cpu->apic_id);
+
+		if (fw_cpu->flags & FW_CPU_BSP) {
+			cpu->flags = ABP_SMP_CPU_BSP;
+			smp->bsp_apic_id = fw_cpu->apic_id;
+		} else {
+			stacks += stack_size;
+			cpu->stack_top = (uint64_t)stacks;
+		}
+	}
+
+	uint64_t apic_base = rdmsr(MSR_APIC_BASE);
+	smp_state.x2apic = (apic_base & APIC_BASE_X2APIC) != 0;
+	smp_state.lapic_base = apic_base & APIC_BASE_ADDR_MASK;
+	smp_state.ap_count = count - 1;
+	if (smp_state.x2apic) {
+		smp->flags |= ABP_SMP_X2APIC;
+	}
+
+	smp_build_trampoline(smp_state.trampoline, smp);
+
+	debug("SMP: %u APs, %llu KiB stacks, trampoline at 0x%llx\r\n", smp_state.ap_count, stack_size / 1024, smp_state.trampoline);
+	return 0;
+}
+
+int abp_smp_map(struct abp_smp_info *smp)
+{
+	if (smp->cpus == NULL) {
+		return 0;
+	}
+
+	if (paging_map_range((uint64_t)smp_state.trampoline, (uint64_t)smp_state.trampoline, SMP_TRAMPOLINE_PAGES * PAGE_SIZE) != 0) {
+		return 1;
+	}
+	return paging_map_range((uint64_t)smp_state.block, (uint64_t)smp_state.block, smp_state.block_size);
+}
+
+void abp_smp_start(struct abp_smp_info *smp)
+{
+	volatile struct smp_trampoline_data *data;
+	uint32_t vector;
+	bool init_delay;
+	uint64_t waited = 0;
+
+	if (smp->cpus == NULL || smp_state.ap_count == 0) {
+		return;
+	}
+
+	data = (volatile struct smp_trampoline_data *)(smp_state.trampoline + SMP_DATA);
+	vector = (uint64_t)smp_state.trampoline >> 12;
+	init_delay = smp_init_delay_needed();
+
+	// APs come up the way the BSP enters the kernel
+	data->kernel_cr3 = paging_get_pml4();
+	data->cr0 = read_cr0();
+	data->cr4 = read_cr4() & ~(CR4_LA57 | CR4_PCIDE | CR4_CET);
+	data->efer = rdmsr(MSR_EFER) & ~EFER_LMA;
+	data->checked_in = 0;
+
+	// each step goes to every AP before the wait, so the delays are paid once
+	for (uint64_t i = 0; i < smp->cpu_count; i++) {
+		if (!(smp->cpus[i].flags & ABP_SMP_CPU_BSP)) {
+			smp_send_ipi(smp->cpus[i].apic_id, ICR_INIT);
+		}
+	}
+	if (init_delay) {
+		smp_delay_us(10000);
+	}
+
+	for (int round = 0; round < 2; round++) {
+		for (uint64_t i = 0; i < smp->cpu_count; i++) {
+			if (!(smp->cpus[i].flags & ABP_SMP_CPU_BSP)) {
+				smp_send_ipi(smp->cpus[i].apic_id, ICR_STARTUP | vector);
+			}
+		}
+		smp_delay_us(init_delay ? 200 : 10);
+	}
+
+	while (data->checked_in < smp_state.ap_count && waited < SMP_CHECKIN_TIMEOUT_US) {
+		smp_delay_us(10);
+		waited += 10;
+	}
+
+	for (uint64_t i = 0; i < smp->cpu_count; i++) {
+		if (!(smp->cpus[i].flags & (ABP_SMP_CPU_BSP | ABP_SMP_CPU_PARKED))) {
+			log("SMP: AP %u didn't check in\r\n", smp->cpus[i].apic_id);
+		}
+	}
+
+	debug("SMP: %u of %u APs parked\r\n", data->checked_in, smp_state.ap_count);
+}
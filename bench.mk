@@ -0,0 +1,68 @@
+###################################################################################
+## Module Name:  bench.mk                                                        ##
+## Project:      AurixOS                                                         ##
+##                                                                               ##
+## Copyright (c) 2024 Jozef Nagy                                                 ##
+##                                                                               ##
+## This source is subject to the MIT License.                                    ##
+## See License.txt in the root of this repository.                               ##
+## All other rights reserved.                                                    ##
+##                                                                               ##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    ##
+## IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      ##
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   ##
+## AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        ##
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, ##
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE ##
+## SOFTWARE.                                                                     ##
+###################################################################################
+
+# End-to-end boot-time benchmark: boots a minimal ABP kernel from an ESP
+# built out of $(SYSROOT_DIR) under QEMU/OVMF and reports the loader's boot
+# timeline. See tools/bench-boot/bench-boot.sh for the knobs.
+
+BENCH_BOOT_DIR := $(BUILD_DIR)/bench-boot
+
+BENCH_KERNEL_CC ?= $(HOST_CC)
+BENCH_KERNEL_CFLAGS := -O2 -ffreestanding -fpie -fvisibility=hidden -fno-stack-protector \
+				-fno-jump-tables -mno-red-zone -mgeneral-regs-only \
+				$(foreach d, $(HOST_INCLUDE_DIRS), -I$d)
+BENCH_KERNEL_LDFLAGS := -nostdlib -static -no-pie -Wl,--build-id=none \
+				-Wl,-T,tools/bench-boot/kernel.ld
+
+# kernel image sizes, in MiB
+BENCH_KERNEL_SIZES ?= 1 16 128
+# guest memory sizes, in GiB
+BENCH_MEM_SIZES ?= 1 16 256
+BENCH_RUNS ?= 10
+# a results.json to compare against, and the allowed regression in percent
+BENCH_BASELINE ?=
+BENCH_THRESHOLD ?= 5
+
+BENCH_KERNEL := $(BENCH_BOOT_DIR)/kernel.elf
+BENCH_KERNELS := $(foreach s, $(BENCH_KERNEL_SIZES), $(BENCH_BOOT_DIR)/kernel-$(s)M.elf)
+
+$(BENCH_KERNEL): tools/bench-boot/kernel.c tools/bench-boot/kernel.ld
+	@mkdir -p $(@D)
+	@printf "  CC\t$(notdir $@)\n"
+	@$(BENCH_KERNEL_CC) $(BENCH_KERNEL_CFLAGS) $(BENCH_KERNEL_LDFLAGS) $< -o $@
+
+# pad the kernel out to size with a non-allocated section, so it's read
+# from disk but never copied
+$(BENCH_BOOT_DIR)/kernel-%M.elf: $(BENCH_KERNEL)
+	@printf "  PAD\t$(notdir $@)\n"
+	@head -c $$(($* * 1024 * 1024)) /dev/zero > $@.pad
+	@objcopy --add-section .axpad=$@.pad $< $@
+	@rm -f $@.pad
+
+.PHONY: bench-boot
+bench-boot: uefi $(BENCH_KERNELS)
+	@$(MAKE) --no-print-directory install-uefi
+	@BENCH_DIR=$(BENCH_BOOT_DIR) \
+		SYSROOT_DIR=$(SYSROOT_DIR) \
+		KERNEL_SIZES="$(BENCH_KERNEL_SIZES)" \
+		MEM_SIZES="$(BENCH_MEM_SIZES)" \
+		RUNS=$(BENCH_RUNS) \
+		BASELINE=$(BENCH_BASELINE) \
+		THRESHOLD=$(BENCH_THRESHOLD) \
+		sh tools/bench-boot/bench-boot.sh
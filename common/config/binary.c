@@ -0,0 +1,116 @@
+/*********************************************************************************/
+/* Module Name:  binary.c                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <config/binary.h>
+#include <config/config.h>
+#include <lib/crc32.h>
+#include <lib/string.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static char *config_bin_string(struct config_bin_header *header, uint32_t offset)
+{
+	char *strings = (char *)header + header->strings_offset;
+
+	if (offset >= header->strings_size) {
+		return NULL;
+	}
+
+	return strings + offset;
+}
+
+int config_load_binary(void *image, size_t size, struct config *config)
+{
+	struct config_bin_header *header = (struct config_bin_header *)image;
+	struct config_bin_entry *bin_entries;
+
+	if (size < sizeof(struct config_bin_header) ||
+		header->magic != CONFIG_BIN_MAGIC) {
+		debug("Invalid binary configuration magic\r\n");
+		return -1;
+	}
+
+	if (header->version != CONFIG_BIN_VERSION ||
+		header->header_size != sizeof(struct config_bin_header)) {
+		debug("Unsupported binary configuration version %u\r\n", header->version);
+		return -1;
+	}
+
+	if (header->total_size > size ||
+		header->entry_count > CONFIG_MAX_ENTRIES ||
+		header->entry_offset + (uint64_t)header->entry_count * sizeof(struct config_bin_entry) > header->total_size ||
+		header->strings_offset + (uint64_t)header->strings_size > header->total_size ||
+		header->strings_size == 0) {
+		debug("Binary configuration is truncated\r\n");
+		return -1;
+	}
+
+	if (crc32((uint8_t *)image + header->header_size, header->total_size - header->header_size) != header->checksum) {
+		debug("Binary configuration checksum mismatch\r\n");
+		return -1;
+	}
+
+	// the pool must end with a terminator so no string can run past it
+	if (((char *)image)[header->strings_offset + header->strings_size - 1] != '\0') {
+		debug("Binary configuration string pool is not terminated\r\n");
+		return -1;
+	}
+
+	config->timeout = header->timeout;
+	config->default_entry = header->default_entry;
+	config->serial_port = header->serial_port;
+	config->serial_baud = header->serial_baud;
+	config->video_mode = header->video_mode;
+	config->video_width = header->video_width;
+	config->video_height = header->video_height;
+	config->splash_path = (header->splash_path != 0) ? config_bin_string(header, header->splash_path) : NULL;
+	config->entry_count = header->entry_count;
+
+	bin_entries = (struct config_bin_entry *)((uint8_t *)image + header->entry_offset);
+	for (uint32_t i = 0; i < header->entry_count; i++) {
+		struct config_bin_entry *bin_entry = &bin_entries[i];
+		struct config_entry *entry = &config->entries[i];
+
+		entry->name = config_bin_string(header, bin_entry->name);
+		entry->protocol = (int)bin_entry->protocol;
+		entry->image_path = config_bin_string(header, bin_entry->image_path);
+		entry->module_count = bin_entry->module_count;
+
+		if (entry->name == NULL || entry->image_path == NULL || entry->module_count > CONFIG_MAX_MODULES) {
+			debug("Binary configuration entry %u is invalid\r\n", i);
+			return -1;
+		}
+
+		for (uint32_t j = 0; j < entry->module_count; j++) {
+			entry->module_paths[j] = config_bin_string(header, bin_entry->module_paths[j]);
+			if (entry->module_paths[j] == NULL) {
+				debug("Binary configuration entry %u is invalid\r\n", i);
+				return -1;
+			}
+		}
+	}
+
+	if (config->default_entry >= config->entry_count) {
+		config->default_entry = 0;
+	}
+
+	return 0;
+}
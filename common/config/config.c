@@ -18,13 +18,18 @@
 /*********************************************************************************/
 
 #include <config/config.h>
+#include <config/binary.h>
+#include <lib/arena.h>
 #include <firmware/file.h>
+#include <lib/crc32.h>
 #include <lib/string.h>
+#include <loader/loader.h>
 #include <print.h>
 #include <axboot.h>
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 char *config_paths[] = {
 	"\\axboot.cfg",
@@ -33,46 +38,237 @@ char *config_paths[] = {
 	"\\EFI\\BOOT\\axboot.cfg",
 };
 
-void config_init(void)
+static struct config config = {0};
+
+static void config_use_defaults(void)
+{
+	memset(&config, 0, sizeof(struct config));
+	config.timeout = CONFIG_DEFAULT_TIMEOUT;
+	config.entries[0].name = "AurixOS";
+	config.entries[0].protocol = ProtocolAbp;
+	config.entries[0].image_path = "\\System\\axkrnl";
+	config.entry_count = 1;
+}
+
+// Reads a whole file into a freshly allocated buffer with one spare byte
+// at the end. Returns the file size, or -1 on failure.
+static int config_read_file(FILE *file, char **buffer)
+{
+	int filesize = fw_file_size(file);
+
+	*buffer = malloc(filesize + 1);
+	if (*buffer == NULL) {
+		log("ERROR: Couldn't allocate memory for the configuration file!\r\n");
+		return -1;
+	}
+
+	if (fw_file_read(file, filesize, *buffer) != 0) {
+		log("ERROR: Couldn't read the configuration file!\r\n");
+		free(*buffer);
+		*buffer = NULL;
+		return -1;
+	}
+
+	return filesize;
+}
+
+// '\\EFI\\axboot.cfg' -> '\\EFI\\axboot.bin'
+static void config_binary_path(const char *path, char *out, size_t out_size)
+{
+	size_t len = strlen(path);
+
+	if (len >= out_size || len < 4) {
+		out[0] = '\0';
+		return;
+	}
+
+	strcpy(out, path);
+	strcpy(out + len - 3, "bin");
+}
+
+// A binary image is stale if the text config it was compiled from has
+// changed size since, or a different checksum if the image asks for it.
+// Images shipped without the text config are never stale.
+static bool config_binary_is_stale(const char *text_path, struct config_bin_header *header)
+{
+	struct arena_mark mark = arena_mark(&g_loader_arena);
+	FILE *text_file;
+	char *text;
+	int text_size;
+	bool stale;
+
+	text_file = fw_file_open(NULL, text_path);
+	if (text_file == NULL) {
+		return false;
+	}
+
+	if ((uint32_t)fw_file_size(text_file) != header->source_size) {
+		fw_file_close(text_file);
+		return true;
+	}
+
+	// reading the whole text back defeats the point of the image
+	if (!(header->flags & CONFIG_BIN_VERIFY_SOURCE)) {
+		fw_file_close(text_file);
+		return false;
+	}
+
+	text_size = config_read_file(text_file, &text);
+	fw_file_close(text_file);
+	if (text_size < 0) {
+		return false;
+	}
+
+	stale = crc32(text, text_size) != header->source_crc;
+	free(text);
+	arena_reset(&g_loader_arena, mark);
+	return stale;
+}
+
+static int config_init_binary(const char *text_path)
+{
+	struct arena_mark mark = arena_mark(&g_loader_arena);
+	FILE *bin_file;
+	char bin_path[256];
+	char *image;
+	int image_size;
+
+	config_binary_path(text_path, bin_path, sizeof(bin_path));
+	if (bin_path[0] == '\0') {
+		return -1;
+	}
+
+	bin_file = fw_file_open(NULL, bin_path);
+	if (bin_file == NULL) {
+		return -1;
+	}
+
+	image_size = config_read_file(bin_file, &image);
+	fw_file_close(bin_file);
+	if (image_size < 0) {
+		return -1;
+	}
+
+	// entries point into the image, so it's only freed on failure
+	if (config_load_binary(image, image_size, &config) != 0 ||
+		config_binary_is_stale(text_path, (struct config_bin_header *)image)) {
+		log("Ignoring invalid or stale binary configuration '%s'\r\n", bin_path);
+		free(image);
+		arena_reset(&g_loader_arena, mark);
+		return -1;
+	}
+
+	debug("Using binary configuration '%s'\r\n", bin_path);
+	return 0;
+}
+
+static int config_init_text(const char *path)
 {
 	FILE *config_file;
 	char *config_buffer;
 	int filesize;
-	
+	int config_errors;
+
+	config_file = fw_file_open(NULL, path);
+	if (config_file == NULL) {
+		return -1;
+	}
+
+	filesize = config_read_file(config_file, &config_buffer);
+	fw_file_close(config_file);
+	if (filesize < 0) {
+		return -1;
+	}
+	config_buffer[filesize] = '\0';
+
+	// entries point into config_buffer, so it's never freed
+	config_errors = config_parse(config_buffer, filesize, &config);
+	if (config_errors != 0) {
+		log("\r\nConfiguration file has %d error(s)!\r\n", config_errors);
+		log("Please correct your config file.\r\n\r\n");
+	}
+
+	return 0;
+}
+
+void config_init(void)
+{
+	bool found = false;
+
+	// prefer a precompiled image next to each text config
 	for (size_t i = 0; i < ARRAY_LENGTH(config_paths); i++) {
-		config_file = fw_file_open(NULL, config_paths[i]);
-		if (config_file != NULL) {
+		if (config_init_binary(config_paths[i]) == 0 ||
+			config_init_text(config_paths[i]) == 0) {
+			found = true;
 			break;
 		}
 	}
 
-	if (config_file == NULL) {
-		//print("No configuration file found! Please refer to the AxBoot documentation.\n");
-		//print("Entering console...\n\n");
-		//console();
+	if (!found) {
+		log("No configuration file found! Please refer to the AxBoot documentation.\r\n");
+		config_use_defaults();
+		return;
 	}
 
-	filesize = fw_file_size(config_file);
-	config_buffer = malloc(filesize);
-	if (config_buffer == NULL) {
-		log("Entering console...\r\n\r\n");
-		//console();
+	if (config.entry_count == 0) {
+		log("No valid entries found, using built-in defaults.\r\n");
+		config_use_defaults();
 	}
 
-	fw_file_read(config_file, filesize, config_buffer);
+	debug("Loaded %u configuration entries (default: %u, timeout: %us)\r\n", config.entry_count, config.default_entry, config.timeout);
+}
 
-	// TODO: parse configuration file
+uint32_t config_get_timeout(void)
+{
+	return config.timeout;
+}
 
-	free(config_buffer);
+uint32_t config_get_serial_port(void)
+{
+	return config.serial_port;
+}
+
+uint32_t config_get_serial_baud(void)
+{
+	return config.serial_baud;
+}
+
+uint32_t config_get_video_mode(void)
+{
+	return config.video_mode;
+}
+
+void config_get_video_resolution(uint32_t *width, uint32_t *height)
+{
+	*width = config.video_width;
+	*height = config.video_height;
+}
+
+const char *config_get_splash_path(void)
+{
+	return config.splash_path;
+}
 
-	/*
-	if (config_errors != 0 || config_get_menu_root() == NULL) {
-		//print("\nConfiguration invalid!\n");
-		//print("Please correct your config file.\n");
-		//print("Entering console...\n\n");
-		//console();
+uint32_t config_get_entry_count(void)
+{
+	return config.entry_count;
+}
+
+uint32_t config_get_default_index(void)
+{
+	return config.default_entry;
+}
+
+struct config_entry *config_get_entry(uint32_t index)
+{
+	if (index >= config.entry_count) {
+		return NULL;
 	}
-	*/
 
-	fw_file_close(config_file);
-}
\ No newline at end of file
+	return &config.entries[index];
+}
+
+struct config_entry *config_get_default_entry(void)
+{
+	return config_get_entry(config.default_entry);
+}
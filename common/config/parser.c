@@ -0,0 +1,592 @@
+/*********************************************************************************/
+/* Module Name:  parser.c                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <config/config.h>
+#include <loader/loader.h>
+#include <lib/string.h>
+#include <print.h>
+#include <axboot.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// The parser does a single forward pass over the configuration buffer and
+// tokenizes it in place: names and values are NUL-terminated inside the
+// buffer and entries point straight into it, so the buffer has to outlive
+// the parsed configuration and must have room for a terminating NUL at
+// buffer[size].
+//
+
+struct config_key_name {
+	const char *name;
+	size_t length;
+	enum ConfigKey key;
+};
+
+static const struct config_key_name config_keys[] = {
+	{ "TIMEOUT", 7, ConfigKeyTimeout },
+	{ "DEFAULT_ENTRY", 13, ConfigKeyDefaultEntry },
+	{ "SERIAL_PORT", 11, ConfigKeySerialPort },
+	{ "SERIAL_BAUD", 11, ConfigKeySerialBaud },
+	{ "VIDEO_MODE", 10, ConfigKeyVideoMode },
+	{ "SPLASH_IMAGE", 12, ConfigKeySplashImage },
+	{ "PROTOCOL", 8, ConfigKeyProtocol },
+	{ "IMAGE_PATH", 10, ConfigKeyImagePath },
+	{ "MODULE_PATH", 11, ConfigKeyModulePath },
+};
+
+struct config_protocol_name {
+	const char *name;
+	size_t length;
+	int protocol;
+};
+
+static const struct config_protocol_name config_protocols[] = {
+	{ "aurix", 5, ProtocolAbp },
+	{ "abp", 3, ProtocolAbp },
+	{ "multiboot", 9, ProtocolMultiboot },
+	{ "multiboot2", 10, ProtocolMultiboot2 },
+	{ "linux", 5, ProtocolLinux },
+	{ "chainload", 9, ProtocolChainload },
+};
+
+struct config_video_name {
+	const char *name;
+	size_t length;
+	uint32_t mode;
+};
+
+static const struct config_video_name config_video_modes[] = {
+	{ "firmware", 8, ConfigVideoFirmware },
+	{ "native", 6, ConfigVideoNative },
+	{ "smallest", 8, ConfigVideoSmallest },
+	{ "headless", 8, ConfigVideoHeadless },
+};
+
+struct config_parser {
+	char *cur;
+	char *end;
+	uint32_t line;
+	int errors;
+
+	struct config *config;
+	struct config_entry *entry;
+	char *default_name;
+	char terminator;
+};
+
+static inline bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_ident(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool is_value_end(char c)
+{
+	return c == '\0' || c == '\n' || c == ';' || c == '}' || is_space(c);
+}
+
+static void config_error(struct config_parser *parser, const char *msg)
+{
+	log("axboot.cfg:%u: %s\r\n", parser->line, msg);
+	parser->errors++;
+}
+
+static void skip_line(struct config_parser *parser)
+{
+	while (parser->cur < parser->end && *parser->cur != '\n') {
+		parser->cur++;
+	}
+}
+
+static void skip_spaces(struct config_parser *parser)
+{
+	while (parser->cur < parser->end && is_space(*parser->cur)) {
+		parser->cur++;
+	}
+}
+
+static enum ConfigKey config_lookup_key(const char *ident, size_t length)
+{
+	for (size_t i = 0; i < ARRAY_LENGTH(config_keys); i++) {
+		if (config_keys[i].length == length && memcmp(config_keys[i].name, ident, length) == 0) {
+			return config_keys[i].key;
+		}
+	}
+
+	return ConfigKeyUnknown;
+}
+
+static int config_lookup_protocol(const char *name)
+{
+	size_t length = strlen(name);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(config_protocols); i++) {
+		if (config_protocols[i].length == length && memcmp(config_protocols[i].name, name, length) == 0) {
+			return config_protocols[i].protocol;
+		}
+	}
+
+	return -1;
+}
+
+// Turns 'boot:///path/to/file' into '\path\to\file' on the boot volume.
+static char *config_resolve_path(char *value)
+{
+	if (memcmp(value, "boot://", 7) == 0) {
+		value += 7;
+	}
+
+	if (*value != '/' && *value != '\\') {
+		return NULL;
+	}
+
+	for (char *c = value; *c != '\0'; c++) {
+		if (*c == '/') {
+			*c = '\\';
+		}
+	}
+
+	return value;
+}
+
+static uint32_t config_parse_number(const char *value, bool *ok)
+{
+	uint32_t number = 0;
+
+	// I/O ports read better in hex
+	if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
+		value += 2;
+		*ok = (*value != '\0');
+		for (; *value != '\0'; value++) {
+			if (*value >= '0' && *value <= '9') {
+				number = (number * 16) + (*value - '0');
+			} else if (*value >= 'a' && *value <= 'f') {
+				number = (number * 16) + (*value - 'a' + 10);
+			} else if (*value >= 'A' && *value <= 'F') {
+				number = (number * 16) + (*value - 'A' + 10);
+			} else {
+				*ok = false;
+				break;
+			}
+		}
+		return number;
+	}
+
+	*ok = (*value != '\0');
+	for (; *value != '\0'; value++) {
+		if (*value < '0' || *value > '9') {
+			*ok = false;
+			break;
+		}
+		number = (number * 10) + (*value - '0');
+	}
+
+	return number;
+}
+
+// Takes one of config_video_modes, or WIDTHxHEIGHT
+static bool config_parse_video_mode(char *value, struct config *config)
+{
+	size_t length = strlen(value);
+	bool ok_width;
+	bool ok_height;
+	char *x;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(config_video_modes); i++) {
+		if (config_video_modes[i].length == length && memcmp(config_video_modes[i].name, value, length) == 0) {
+			config->video_mode = config_video_modes[i].mode;
+			return true;
+		}
+	}
+
+	for (x = value; *x != '\0' && *x != 'x'; x++);
+	if (*x != 'x') {
+		return false;
+	}
+
+	*x = '\0';
+	config->video_width = config_parse_number(value, &ok_width);
+	config->video_height = config_parse_number(x + 1, &ok_height);
+	*x = 'x';
+	if (!ok_width || !ok_height || config->video_width == 0 || config->video_height == 0) {
+		return false;
+	}
+
+	config->video_mode = ConfigVideoFixed;
+	return true;
+}
+
+// Reads a quoted or bare value and terminates it in place. Returns NULL on error.
+static char *config_read_value(struct config_parser *parser)
+{
+	char *value;
+
+	if (parser->cur < parser->end && *parser->cur == '"') {
+		value = ++parser->cur;
+		while (parser->cur < parser->end && *parser->cur != '"' && *parser->cur != '\n') {
+			parser->cur++;
+		}
+
+		if (parser->cur >= parser->end || *parser->cur != '"') {
+			config_error(parser, "Unterminated string");
+			return NULL;
+		}
+
+		*parser->cur++ = '\0';
+		return value;
+	}
+
+	value = parser->cur;
+	while (parser->cur < parser->end && !is_value_end(*parser->cur)) {
+		parser->cur++;
+	}
+
+	if (parser->cur == value) {
+		config_error(parser, "Missing value");
+		return NULL;
+	}
+
+	// the terminator may still be meaningful to the scanner, so remember it
+	// before overwriting it (buffer[size] is reserved for the last value)
+	parser->terminator = (parser->cur < parser->end) ? *parser->cur : '\0';
+	*parser->cur = '\0';
+	if (parser->terminator != '\0') {
+		parser->cur++;
+	}
+
+	return value;
+}
+
+static void config_parse_entry_header(struct config_parser *parser)
+{
+	struct config *config = parser->config;
+	char *name;
+
+	skip_spaces(parser);
+	if (parser->cur >= parser->end || *parser->cur != '"') {
+		config_error(parser, "Expected entry name");
+		skip_line(parser);
+		return;
+	}
+
+	name = config_read_value(parser);
+	if (name == NULL) {
+		skip_line(parser);
+		return;
+	}
+
+	// the opening brace may be on the next line
+	while (parser->cur < parser->end && (is_space(*parser->cur) || *parser->cur == '\n')) {
+		if (*parser->cur == '\n') {
+			parser->line++;
+		}
+		parser->cur++;
+	}
+
+	if (parser->cur >= parser->end || *parser->cur != '{') {
+		config_error(parser, "Expected '{' after entry name");
+		skip_line(parser);
+		return;
+	}
+	parser->cur++;
+
+	if (config->entry_count >= CONFIG_MAX_ENTRIES) {
+		config_error(parser, "Too many entries");
+		return;
+	}
+
+	parser->entry = &config->entries[config->entry_count++];
+	memset(parser->entry, 0, sizeof(struct config_entry));
+	parser->entry->name = name;
+	parser->entry->protocol = -1;
+}
+
+static void config_close_entry(struct config_parser *parser)
+{
+	struct config_entry *entry = parser->entry;
+
+	if (entry == NULL) {
+		config_error(parser, "Unexpected '}'");
+		return;
+	}
+
+	if (entry->protocol < 0 || entry->image_path == NULL) {
+		config_error(parser, "Entry is missing PROTOCOL or IMAGE_PATH");
+		parser->config->entry_count--;
+	}
+
+	parser->entry = NULL;
+}
+
+static void config_handle_terminator(struct config_parser *parser)
+{
+	char terminator = parser->terminator;
+
+	parser->terminator = '\0';
+	switch (terminator) {
+		case '\n':
+			parser->line++;
+			break;
+		case ';':
+			skip_line(parser);
+			break;
+		case '}':
+			config_close_entry(parser);
+			break;
+		default:
+			break;
+	}
+}
+
+static void config_parse_assignment(struct config_parser *parser, enum ConfigKey key)
+{
+	struct config_entry *entry = parser->entry;
+	char *value;
+	bool ok;
+
+	skip_spaces(parser);
+	if (parser->cur >= parser->end || *parser->cur != '=') {
+		config_error(parser, "Expected '='");
+		skip_line(parser);
+		return;
+	}
+	parser->cur++;
+	skip_spaces(parser);
+
+	value = config_read_value(parser);
+	if (value == NULL) {
+		skip_line(parser);
+		return;
+	}
+
+	switch (key) {
+		case ConfigKeyTimeout:
+			if (entry != NULL) {
+				config_error(parser, "TIMEOUT is only valid outside of entries");
+				break;
+			}
+			parser->config->timeout = config_parse_number(value, &ok);
+			if (!ok) {
+				config_error(parser, "Invalid TIMEOUT value");
+				parser->config->timeout = CONFIG_DEFAULT_TIMEOUT;
+			}
+			break;
+		case ConfigKeyDefaultEntry:
+			if (entry != NULL) {
+				config_error(parser, "DEFAULT_ENTRY is only valid outside of entries");
+				break;
+			}
+			parser->default_name = value;
+			break;
+		case ConfigKeySerialPort:
+			if (entry != NULL) {
+				config_error(parser, "SERIAL_PORT is only valid outside of entries");
+				break;
+			}
+			// COM1-COM4, or an I/O port
+			if ((value[0] == 'C' || value[0] == 'c') && (value[1] == 'O' || value[1] == 'o') &&
+				(value[2] == 'M' || value[2] == 'm') && value[3] >= '1' && value[3] <= '4' && value[4] == '\0') {
+				parser->config->serial_port = value[3] - '0';
+				break;
+			}
+			parser->config->serial_port = config_parse_number(value, &ok);
+			if (!ok || parser->config->serial_port > 0xffff) {
+				config_error(parser, "Invalid SERIAL_PORT value");
+				parser->config->serial_port = 0;
+			}
+			break;
+		case ConfigKeySerialBaud:
+			if (entry != NULL) {
+				config_error(parser, "SERIAL_BAUD is only valid outside of entries");
+				break;
+			}
+			parser->config->serial_baud = config_parse_number(value, &ok);
+			if (!ok) {
+				config_error(parser, "Invalid SERIAL_BAUD value");
+				parser->config->serial_baud = 0;
+			}
+			break;
+		case ConfigKeyVideoMode:
+			if (entry != NULL) {
+				config_error(parser, "VIDEO_MODE is only valid outside of entries");
+				break;
+			}
+			if (!config_parse_video_mode(value, parser->config)) {
+				config_error(parser, "Invalid VIDEO_MODE value");
+				parser->config->video_mode = ConfigVideoFirmware;
+			}
+			break;
+		case ConfigKeySplashImage:
+			if (entry != NULL) {
+				config_error(parser, "SPLASH_IMAGE is only valid outside of entries");
+				break;
+			}
+			parser->config->splash_path = config_resolve_path(value);
+			if (parser->config->splash_path == NULL) {
+				config_error(parser, "Unsupported SPLASH_IMAGE URI");
+			}
+			break;
+		case ConfigKeyProtocol:
+			if (entry == NULL) {
+				config_error(parser, "PROTOCOL is only valid inside of entries");
+				break;
+			}
+			entry->protocol = config_lookup_protocol(value);
+			if (entry->protocol < 0) {
+				config_error(parser, "Unknown protocol");
+			}
+			break;
+		case ConfigKeyImagePath:
+			if (entry == NULL) {
+				config_error(parser, "IMAGE_PATH is only valid inside of entries");
+				break;
+			}
+			entry->image_path = config_resolve_path(value);
+			if (entry->image_path == NULL) {
+				config_error(parser, "Unsupported IMAGE_PATH URI");
+			}
+			break;
+		case ConfigKeyModulePath:
+			if (entry == NULL) {
+				config_error(parser, "MODULE_PATH is only valid inside of entries");
+				break;
+			}
+			if (entry->module_count >= CONFIG_MAX_MODULES) {
+				config_error(parser, "Too many modules");
+				break;
+			}
+			entry->module_paths[entry->module_count] = config_resolve_path(value);
+			if (entry->module_paths[entry->module_count] == NULL) {
+				config_error(parser, "Unsupported MODULE_PATH URI");
+				break;
+			}
+			entry->module_count++;
+			break;
+		default:
+			config_error(parser, "Unknown key");
+			break;
+	}
+
+	config_handle_terminator(parser);
+}
+
+int config_parse(char *buffer, size_t size, struct config *config)
+{
+	struct config_parser parser = {
+		.cur = buffer,
+		.end = buffer + size,
+		.line = 1,
+		.errors = 0,
+		.config = config,
+		.entry = NULL,
+		.default_name = NULL,
+		.terminator = '\0',
+	};
+
+	config->timeout = CONFIG_DEFAULT_TIMEOUT;
+	config->default_entry = 0;
+	config->serial_port = 0;
+	config->serial_baud = 0;
+	config->video_mode = ConfigVideoFirmware;
+	config->video_width = 0;
+	config->video_height = 0;
+	config->splash_path = NULL;
+	config->entry_count = 0;
+
+	while (parser.cur < parser.end) {
+		char c = *parser.cur;
+
+		if (c == '\n') {
+			parser.line++;
+			parser.cur++;
+			continue;
+		}
+
+		if (is_space(c)) {
+			parser.cur++;
+			continue;
+		}
+
+		if (c == ';') {
+			skip_line(&parser);
+			continue;
+		}
+
+		if (c == '}') {
+			parser.cur++;
+			config_close_entry(&parser);
+			continue;
+		}
+
+		char *ident = parser.cur;
+		while (parser.cur < parser.end && is_ident(*parser.cur)) {
+			parser.cur++;
+		}
+
+		size_t length = parser.cur - ident;
+		if (length == 0) {
+			config_error(&parser, "Unexpected character");
+			skip_line(&parser);
+			continue;
+		}
+
+		if (parser.entry == NULL && length == 5 && memcmp(ident, "entry", 5) == 0) {
+			config_parse_entry_header(&parser);
+			continue;
+		}
+
+		config_parse_assignment(&parser, config_lookup_key(ident, length));
+	}
+
+	if (parser.entry != NULL) {
+		config_error(&parser, "Missing '}' at end of file");
+		config_close_entry(&parser);
+	}
+
+	// DEFAULT_ENTRY takes either an entry name or its index
+	if (parser.default_name != NULL) {
+		bool ok;
+		uint32_t index = config_parse_number(parser.default_name, &ok);
+
+		if (!ok) {
+			size_t length = strlen(parser.default_name);
+			for (index = 0; index < config->entry_count; index++) {
+				if (strlen(config->entries[index].name) == length &&
+					memcmp(config->entries[index].name, parser.default_name, length) == 0) {
+					break;
+				}
+			}
+		}
+
+		if (index < config->entry_count) {
+			config->default_entry = index;
+		} else {
+			config_error(&parser, "DEFAULT_ENTRY does not match any entry");
+		}
+	}
+
+	return parser.errors;
+}
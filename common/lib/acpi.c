@@ -0,0 +1,137 @@
+/*********************************************************************************/
+/* Module Name:  acpi.c                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/acpi.h>
+#include <lib/string.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+static struct {
+	bool initialized;
+	struct acpi_table_entry tables[ACPI_MAX_TABLES];
+	uint32_t count;
+} directory;
+
+bool acpi_checksum_valid(const void *data, uint32_t length)
+{
+	const uint8_t *bytes = data;
+	uint8_t sum = 0;
+
+	for (uint32_t i = 0; i < length; i++) {
+		sum += bytes[i];
+	}
+
+	return sum == 0;
+}
+
+static void acpi_add_table(uint64_t address)
+{
+	struct acpi_sdt_header *table = (struct acpi_sdt_header *)(uintptr_t)address;
+
+	if (table == NULL) {
+		return;
+	}
+
+	if (table->length < sizeof(struct acpi_sdt_header) || !acpi_checksum_valid(table, table->length)) {
+		debug("ACPI: skipping '%.4s' at 0x%llx, bad checksum\r\n", table->signature, address);
+		return;
+	}
+
+	if (directory.count >= ACPI_MAX_TABLES) {
+		debug("ACPI: more than %u tables, ignoring '%.4s'\r\n", ACPI_MAX_TABLES, table->signature);
+		return;
+	}
+
+	struct acpi_table_entry *entry = &directory.tables[directory.count++];
+	memcpy(entry->signature, table->signature, 4);
+	entry->length = table->length;
+	entry->address = address;
+}
+
+int acpi_init(void *rsdp_ptr)
+{
+	struct acpi_rsdp *rsdp = rsdp_ptr;
+	struct acpi_sdt_header *root = NULL;
+	uint32_t entry_size = sizeof(uint32_t);
+
+	if (directory.initialized) {
+		return 0;
+	}
+
+	if (rsdp == NULL || !acpi_checksum_valid(rsdp, 20)) {
+		debug("ACPI: RSDP is missing or corrupt\r\n");
+		return -1;
+	}
+
+	// prefer the XSDT, the RSDT only holds 32-bit pointers
+	if (rsdp->revision >= 2 && rsdp->xsdt_address != 0 && acpi_checksum_valid(rsdp, rsdp->length)) {
+		root = (struct acpi_sdt_header *)(uintptr_t)rsdp->xsdt_address;
+		entry_size = sizeof(uint64_t);
+		if (!acpi_checksum_valid(root, root->length)) {
+			debug("ACPI: XSDT checksum is bad, trying the RSDT\r\n");
+			root = NULL;
+			entry_size = sizeof(uint32_t);
+		}
+	}
+
+	if (root == NULL && rsdp->rsdt_address != 0) {
+		root = (struct acpi_sdt_header *)(uintptr_t)rsdp->rsdt_address;
+		if (!acpi_checksum_valid(root, root->length)) {
+			debug("ACPI: RSDT checksum is bad\r\n");
+			return -1;
+		}
+	}
+
+	if (root == NULL) {
+		return -1;
+	}
+
+	uint32_t count = (root->length - sizeof(struct acpi_sdt_header)) / entry_size;
+	uint8_t *entries = (uint8_t *)root + sizeof(struct acpi_sdt_header);
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t addr = 0;
+		memcpy(&addr, entries + (i * entry_size), entry_size);
+		acpi_add_table(addr);
+	}
+
+	directory.initialized = true;
+	debug("ACPI: %u tables in the %.4s\r\n", directory.count, root->signature);
+	return 0;
+}
+
+void *acpi_find_table(const char *signature)
+{
+	for (uint32_t i = 0; i < directory.count; i++) {
+		if (!memcmp(directory.tables[i].signature, signature, 4)) {
+			return (void *)(uintptr_t)directory.tables[i].address;
+		}
+	}
+
+	return NULL;
+}
+
+const struct acpi_table_entry *acpi_get_directory(uint32_t *count)
+{
+	*count = directory.count;
+	return directory.tables;
+}
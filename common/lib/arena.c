@@ -0,0 +1,158 @@
+/*********************************************************************************/
+/* Module Name:  arena.c                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/arena.h>
+#include <lib/memstat.h>
+#include <firmware/memory.h>
+#include <print.h>
+#include <axboot.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define ARENA_HEADER_SIZE ROUND_UP(sizeof(struct arena_chunk), ARENA_ALIGNMENT)
+
+struct arena g_loader_arena = ARENA_INIT("loader", FwMemoryLoader, MemStatTransient);
+struct arena g_handoff_arena = ARENA_INIT("handoff", FwMemoryReclaimable, MemStatBootInfo);
+
+static struct arena_chunk *arena_new_chunk(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	uint64_t chunk_size = ROUND_UP(size + ARENA_HEADER_SIZE, FW_PAGE_SIZE);
+
+	if (chunk_size < ARENA_CHUNK_SIZE) {
+		chunk_size = ARENA_CHUNK_SIZE;
+	}
+
+	chunk = fw_allocpages(chunk_size / FW_PAGE_SIZE, arena->type);
+	if (chunk == NULL) {
+		debug("ERROR: Couldn't grow the %s arena by %llu bytes\r\n", arena->name, chunk_size);
+		return NULL;
+	}
+
+	chunk->next = arena->head;
+	chunk->size = chunk_size;
+	chunk->used = ARENA_HEADER_SIZE;
+
+	arena->head = chunk;
+	arena->chunk_count++;
+	memstat_alloc(arena->category, chunk_size);
+	return chunk;
+}
+
+static void arena_free_chunk(struct arena *arena)
+{
+	struct arena_chunk *chunk = arena->head;
+
+	arena->head = chunk->next;
+	arena->chunk_count--;
+	memstat_free(arena->category, chunk->size);
+	fw_freepages(chunk, chunk->size / FW_PAGE_SIZE);
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = arena->head;
+	void *p;
+
+	size = ROUND_UP(size, ARENA_ALIGNMENT);
+	if (size == 0) {
+		size = ARENA_ALIGNMENT;
+	}
+
+	// whatever is left in the current chunk is abandoned
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		chunk = arena_new_chunk(arena, size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+	}
+
+	p = (uint8_t *)chunk + chunk->used;
+	chunk->used += size;
+
+	arena->used += size;
+	if (arena->used > arena->high_water) {
+		arena->high_water = arena->used;
+	}
+
+	return p;
+}
+
+bool arena_reserve(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = arena->head;
+
+	size = ROUND_UP(size, ARENA_ALIGNMENT);
+	if (chunk != NULL && chunk->size - chunk->used >= size) {
+		return true;
+	}
+
+	return arena_new_chunk(arena, size) != NULL;
+}
+
+bool arena_owns(struct arena *arena, void *p)
+{
+	for (struct arena_chunk *chunk = arena->head; chunk != NULL; chunk = chunk->next) {
+		if ((uint8_t *)p >= (uint8_t *)chunk && (uint8_t *)p < (uint8_t *)chunk + chunk->size) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+struct arena_mark arena_mark(struct arena *arena)
+{
+	struct arena_mark mark = {
+		.chunk = arena->head,
+		.chunk_used = arena->head ? arena->head->used : 0,
+		.used = arena->used,
+	};
+
+	return mark;
+}
+
+void arena_reset(struct arena *arena, struct arena_mark mark)
+{
+	while (arena->head != NULL && arena->head != mark.chunk) {
+		arena_free_chunk(arena);
+	}
+
+	if (arena->head != NULL) {
+		arena->head->used = mark.chunk_used;
+	}
+	arena->used = mark.used;
+}
+
+void arena_release(struct arena *arena)
+{
+	while (arena->head != NULL) {
+		arena_free_chunk(arena);
+	}
+
+	arena->used = 0;
+}
+
+void arena_dump(struct arena *arena)
+{
+	debug("%s arena: %llu bytes in use, high water %llu bytes, %llu chunk(s)\r\n",
+		  arena->name, arena->used, arena->high_water, arena->chunk_count);
+}
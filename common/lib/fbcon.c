@@ -0,0 +1,295 @@
+/*********************************************************************************/
+/* Module Name:  fbcon.c                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/fbcon.h>
+#include <lib/memstat.h>
+#include <firmware/fb.h>
+#include <firmware/memory.h>
+#include <print.h>
+#include <axboot.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+static struct {
+	bool tried;
+	bool active;
+
+	uint32_t *fb;
+	uint32_t fb_stride; // in pixels
+	uint32_t width;
+	uint32_t height;
+
+	uint32_t *shadow; // width * height, no padding
+	uint32_t *glyphs; // FBCON_GLYPH_COUNT glyphs of glyph_width * glyph_height pixels
+	uint32_t glyph_width;
+	uint32_t glyph_height;
+
+	uint32_t columns;
+	uint32_t rows;
+	uint32_t column;
+	uint32_t row;
+
+	// in pixels, x1/y1 exclusive
+	bool dirty;
+	uint32_t dirty_x0;
+	uint32_t dirty_y0;
+	uint32_t dirty_x1;
+	uint32_t dirty_y1;
+} con;
+
+static void *fbcon_alloc(size_t size)
+{
+	void *p = fw_allocpages(ROUND_UP(size, FW_PAGE_SIZE) / FW_PAGE_SIZE, FwMemoryReclaimable);
+	if (p != NULL) {
+		memstat_alloc(MemStatTransient, ROUND_UP(size, FW_PAGE_SIZE));
+	}
+	return p;
+}
+
+static void fbcon_mark_dirty(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+	if (!con.dirty) {
+		con.dirty = true;
+		con.dirty_x0 = x0;
+		con.dirty_y0 = y0;
+		con.dirty_x1 = x1;
+		con.dirty_y1 = y1;
+		return;
+	}
+
+	con.dirty_x0 = (x0 < con.dirty_x0) ? x0 : con.dirty_x0;
+	con.dirty_y0 = (y0 < con.dirty_y0) ? y0 : con.dirty_y0;
+	con.dirty_x1 = (x1 > con.dirty_x1) ? x1 : con.dirty_x1;
+	con.dirty_y1 = (y1 > con.dirty_y1) ? y1 : con.dirty_y1;
+}
+
+static void fbcon_fill(uint32_t *dest, size_t count, uint32_t color)
+{
+	for (size_t i = 0; i < count; i++) {
+		dest[i] = color;
+	}
+}
+
+// Builds the glyph cache; characters the firmware can't draw stay blank
+static int fbcon_build_glyphs(void)
+{
+	uint16_t rows[FW_GLYPH_MAX_HEIGHT];
+	uint32_t width;
+	uint32_t height;
+
+	// the cell size comes from a glyph every font has
+	if (fw_get_glyph('M', rows, &width, &height) != 0 || width == 0 || height == 0) {
+		return -1;
+	}
+
+	con.glyph_width = width;
+	con.glyph_height = height;
+	con.glyphs = fbcon_alloc((size_t)FBCON_GLYPH_COUNT * width * height * sizeof(uint32_t));
+	if (con.glyphs == NULL) {
+		return -1;
+	}
+
+	for (uint32_t ch = FBCON_FIRST_GLYPH; ch <= FBCON_LAST_GLYPH; ch++) {
+		uint32_t *glyph = con.glyphs + (ch - FBCON_FIRST_GLYPH) * con.glyph_width * con.glyph_height;
+
+		fbcon_fill(glyph, con.glyph_width * con.glyph_height, FBCON_BACKGROUND);
+		if (fw_get_glyph(ch, rows, &width, &height) != 0) {
+			continue;
+		}
+
+		for (uint32_t y = 0; y < height && y < con.glyph_height; y++) {
+			for (uint32_t x = 0; x < width && x < con.glyph_width; x++) {
+				if (rows[y] & (0x8000 >> x)) {
+					glyph[y * con.glyph_width + x] = FBCON_FOREGROUND;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int fbcon_init(void)
+{
+	void *address = NULL;
+	uint16_t bpp = 0;
+	uint8_t format = 0;
+
+	if (con.tried) {
+		return con.active ? 0 : -1;
+	}
+	con.tried = true;
+
+	if (fw_initialize_fb() != 0) {
+		return -1;
+	}
+
+	fw_get_framebuffer(&address, &con.width, &con.height, &bpp, &format);
+	if (address == NULL || bpp != 32) {
+		debug("fbcon: unsupported framebuffer, staying on the firmware console\r\n");
+		return -1;
+	}
+	con.fb = address;
+	con.fb_stride = fw_get_fb_pitch() / sizeof(uint32_t);
+	if (con.fb_stride < con.width) {
+		con.fb_stride = con.width;
+	}
+
+	if (fbcon_build_glyphs() != 0) {
+		debug("fbcon: no usable font, staying on the firmware console\r\n");
+		return -1;
+	}
+
+	con.shadow = fbcon_alloc((size_t)con.width * con.height * sizeof(uint32_t));
+	if (con.shadow == NULL) {
+		return -1;
+	}
+
+	con.columns = con.width / con.glyph_width;
+	con.rows = con.height / con.glyph_height;
+	con.active = true;
+
+	debug("fbcon: %ux%u, %ux%u glyphs, %ux%u cells\r\n",
+		  con.width, con.height, con.glyph_width, con.glyph_height, con.columns, con.rows);
+
+	fbcon_clear();
+	fbcon_flush();
+	return 0;
+}
+
+bool fbcon_active(void)
+{
+	return con.active;
+}
+
+void fbcon_release(void)
+{
+	// the buffers are reclaimable, the kernel gets them back
+	con.active = false;
+}
+
+void fbcon_clear(void)
+{
+	if (!con.active) {
+		return;
+	}
+
+	fbcon_fill(con.shadow, (size_t)con.width * con.height, FBCON_BACKGROUND);
+	fbcon_mark_dirty(0, 0, con.width, con.height);
+	con.column = 0;
+	con.row = 0;
+}
+
+void fbcon_set_cursor(uint32_t column, uint32_t row)
+{
+	if (!con.active) {
+		return;
+	}
+
+	con.column = (column < con.columns) ? column : con.columns - 1;
+	con.row = (row < con.rows) ? row : con.rows - 1;
+}
+
+static void fbcon_scroll(void)
+{
+	size_t line = (size_t)con.width * con.glyph_height;
+	size_t kept = (size_t)con.width * con.glyph_height * (con.rows - 1);
+
+	// moving up, so a forward copy never overwrites what it still needs
+	for (size_t i = 0; i < kept; i++) {
+		con.shadow[i] = con.shadow[i + line];
+	}
+	fbcon_fill(con.shadow + kept, line, FBCON_BACKGROUND);
+
+	fbcon_mark_dirty(0, 0, con.width, con.rows * con.glyph_height);
+}
+
+static void fbcon_newline(void)
+{
+	con.column = 0;
+	if (con.row + 1 < con.rows) {
+		con.row++;
+	} else {
+		fbcon_scroll();
+	}
+}
+
+static void fbcon_put_glyph(char c)
+{
+	uint32_t index = ((uint8_t)c >= FBCON_FIRST_GLYPH && (uint8_t)c <= FBCON_LAST_GLYPH) ? (uint8_t)c - FBCON_FIRST_GLYPH : '?' - FBCON_FIRST_GLYPH;
+	uint32_t *glyph = con.glyphs + index * con.glyph_width * con.glyph_height;
+	uint32_t x = con.column * con.glyph_width;
+	uint32_t y = con.row * con.glyph_height;
+
+	for (uint32_t row = 0; row < con.glyph_height; row++) {
+		uint32_t *dest = con.shadow + (size_t)(y + row) * con.width + x;
+		uint32_t *src = glyph + row * con.glyph_width;
+
+		for (uint32_t col = 0; col < con.glyph_width; col++) {
+			dest[col] = src[col];
+		}
+	}
+
+	fbcon_mark_dirty(x, y, x + con.glyph_width, y + con.glyph_height);
+}
+
+void fbcon_write(const char *text, size_t len)
+{
+	if (!con.active) {
+		return;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		switch (text[i]) {
+			case '\r':
+				con.column = 0;
+				break;
+			case '\n':
+				fbcon_newline();
+				break;
+			default:
+				if (con.column >= con.columns) {
+					fbcon_newline();
+				}
+				fbcon_put_glyph(text[i]);
+				con.column++;
+				break;
+		}
+	}
+}
+
+void fbcon_flush(void)
+{
+	if (!con.active || !con.dirty) {
+		return;
+	}
+
+	for (uint32_t y = con.dirty_y0; y < con.dirty_y1; y++) {
+		uint32_t *src = con.shadow + (size_t)y * con.width;
+		uint32_t *dest = con.fb + (size_t)y * con.fb_stride;
+
+		for (uint32_t x = con.dirty_x0; x < con.dirty_x1; x++) {
+			dest[x] = src[x];
+		}
+	}
+
+	con.dirty = false;
+}
@@ -0,0 +1,115 @@
+/*********************************************************************************/
+/* Module Name:  history.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/history.h>
+#include <lib/crc32.h>
+#include <lib/string.h>
+#include <firmware/var.h>
+#include <arch/cpu/cpu.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HISTORY_VAR_NAME "AxBootHistory"
+
+static struct history history;
+static bool history_loaded = false;
+
+static void history_load(void)
+{
+	if (history_loaded) {
+		return;
+	}
+	history_loaded = true;
+
+	if (fw_var_get(HISTORY_VAR_NAME, &history, sizeof(history)) != sizeof(history) ||
+		history.magic != HISTORY_MAGIC ||
+		history.version != HISTORY_VERSION ||
+		history.count > HISTORY_SIZE ||
+		history.head >= HISTORY_SIZE ||
+		crc32(history.records, sizeof(history.records)) != history.checksum) {
+		memset(&history, 0, sizeof(history));
+		history.magic = HISTORY_MAGIC;
+		history.version = HISTORY_VERSION;
+	}
+}
+
+uint32_t history_get_count(void)
+{
+	history_load();
+	return history.count;
+}
+
+const struct history_record *history_get(uint32_t index)
+{
+	history_load();
+	if (index >= history.count) {
+		return NULL;
+	}
+
+	return &history.records[(history.head + HISTORY_SIZE - history.count + index) % HISTORY_SIZE];
+}
+
+// Boot time without the menu, which depends on the user rather than the machine
+static uint32_t history_boot_us(const struct history_record *record)
+{
+	return (record->total_us > record->menu_us) ? record->total_us - record->menu_us : 0;
+}
+
+static bool history_is_due(const struct history_record *record)
+{
+	const struct history_record *last;
+	uint32_t boot_us;
+	uint32_t last_us;
+	uint32_t delta;
+
+	if (history.count == 0) {
+		return true;
+	}
+
+	// the TSC's low bits stand in for a boot counter, which would need a write of its own
+	if ((rdtsc() >> 8) % HISTORY_SAMPLE_INTERVAL == 0) {
+		return true;
+	}
+
+	last = history_get(history.count - 1);
+	boot_us = history_boot_us(record);
+	last_us = history_boot_us(last);
+	delta = (boot_us > last_us) ? boot_us - last_us : last_us - boot_us;
+	return (uint64_t)delta * 100 > (uint64_t)last_us * HISTORY_DELTA_PERCENT;
+}
+
+void history_record(const struct history_record *record)
+{
+	history_load();
+	if (!history_is_due(record)) {
+		return;
+	}
+
+	history.records[history.head] = *record;
+	history.head = (history.head + 1) % HISTORY_SIZE;
+	if (history.count < HISTORY_SIZE) {
+		history.count++;
+	}
+	history.checksum = crc32(history.records, sizeof(history.records));
+
+	debug("Saving boot history (%u boot(s))\r\n", history.count);
+	fw_var_set(HISTORY_VAR_NAME, &history, sizeof(history));
+}
@@ -0,0 +1,221 @@
+/*********************************************************************************/
+/* Module Name:  logring.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/logring.h>
+#include <lib/fbcon.h>
+#include <lib/memstat.h>
+#include <lib/string.h>
+#include <lib/trace.h>
+#include <firmware/memory.h>
+#include <debug/serial.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static struct log_ring ring = {
+	.sinks = LOG_SINKS_ALL,
+};
+
+static void ring_read(uint64_t pos, void *dest, size_t len)
+{
+	char *out = dest;
+	for (size_t i = 0; i < len; i++) {
+		out[i] = ring.buffer[(pos + i) % ring.size];
+	}
+}
+
+static void ring_write(uint64_t pos, const void *src, size_t len)
+{
+	const char *in = src;
+	for (size_t i = 0; i < len; i++) {
+		ring.buffer[(pos + i) % ring.size] = in[i];
+	}
+}
+
+// trace records go out framed, for axtrace to pick out of the stream
+static void serial_send_trace(const char *data, size_t len)
+{
+	struct log_record record = {
+		.length = len,
+		.level = LogLevelTrace,
+	};
+
+	serial_send(TRACE_FRAME_SYNC);
+	serial_write_raw(&record, sizeof(struct log_record));
+	serial_write_raw(data, len);
+}
+
+// the serial port gets debug output, the console what's meant for the user
+static void sink_emit(int sink, int level, const char *text, size_t len)
+{
+	switch (sink) {
+		case LogSinkSerial:
+			if (level == LogLevelDebug) {
+				serial_write(text, len);
+			} else if (level == LogLevelTrace) {
+				serial_send_trace(text, len);
+			}
+			break;
+		case LogSinkConsole:
+			if (level == LogLevelInfo) {
+				if (fbcon_active()) {
+					fbcon_write(text, len);
+				} else {
+					printstr(text);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void drain_sink(int sink, size_t budget)
+{
+	char text[LOG_RECORD_MAX + 1];
+	struct log_record record;
+	uint64_t head = ring.head;
+	size_t drained = 0;
+
+	// a target that was turned off has missed whatever got dropped since
+	if (ring.cursor[sink] < ring.tail) {
+		ring.cursor[sink] = ring.tail;
+	}
+
+	while (ring.cursor[sink] < head && (budget == 0 || drained < budget)) {
+		ring_read(ring.cursor[sink], &record, sizeof(struct log_record));
+		ring_read(ring.cursor[sink] + sizeof(struct log_record), text, record.length);
+		text[record.length] = '\0';
+
+		sink_emit(sink, record.level, text, record.length);
+
+		ring.cursor[sink] += sizeof(struct log_record) + record.length;
+		drained += sizeof(struct log_record) + record.length;
+	}
+
+	// one blit for everything drained instead of one per record
+	if (sink == LogSinkConsole) {
+		fbcon_flush();
+	}
+}
+
+int logring_init(void)
+{
+	char *buffer;
+
+	if (ring.buffer != NULL) {
+		return 0;
+	}
+
+	buffer = fw_allocpages(LOG_RING_SIZE / FW_PAGE_SIZE, FwMemoryReclaimable);
+	if (buffer == NULL) {
+		debug("ERROR: Couldn't allocate the log ring, logging synchronously\r\n");
+		return -1;
+	}
+	memstat_alloc(MemStatBootInfo, LOG_RING_SIZE);
+
+	ring.size = LOG_RING_SIZE;
+	ring.buffer = buffer;
+	return 0;
+}
+
+void logring_write(int level, const char *str)
+{
+	logring_write_record(level, str, strlen(str));
+}
+
+void logring_write_record(int level, const void *data, size_t len)
+{
+	struct log_record record;
+	uint64_t needed;
+
+	if (ring.buffer == NULL) {
+		char text[LOG_RECORD_MAX + 1];
+
+		if (len > LOG_RECORD_MAX) {
+			len = LOG_RECORD_MAX;
+		}
+		memcpy(text, (void *)data, len);
+		text[len] = '\0';
+
+		for (int sink = 0; sink < LogSinkCount; sink++) {
+			if (ring.sinks & LOG_SINK_MASK(sink)) {
+				sink_emit(sink, level, text, len);
+			}
+		}
+		return;
+	}
+
+	if (len > LOG_RECORD_MAX) {
+		len = LOG_RECORD_MAX;
+	}
+	needed = sizeof(struct log_record) + len;
+
+	// make room by dropping the oldest records, but never before every
+	// target has seen them
+	while (ring.head + needed - ring.tail > ring.size) {
+		for (int sink = 0; sink < LogSinkCount; sink++) {
+			if ((ring.sinks & LOG_SINK_MASK(sink)) && ring.cursor[sink] <= ring.tail) {
+				drain_sink(sink, 0);
+			}
+		}
+
+		ring_read(ring.tail, &record, sizeof(struct log_record));
+		ring.tail += sizeof(struct log_record) + record.length;
+	}
+
+	record.length = len;
+	record.level = level;
+	record.reserved = 0;
+	ring_write(ring.head, &record, sizeof(struct log_record));
+	ring_write(ring.head + sizeof(struct log_record), data, len);
+
+	// publish the record only once it's complete
+	__asm__ volatile("" ::: "memory");
+	ring.head += needed;
+}
+
+void logring_drain(int sinks, size_t budget)
+{
+	if (ring.buffer == NULL) {
+		return;
+	}
+
+	for (int sink = 0; sink < LogSinkCount; sink++) {
+		if ((sinks & ring.sinks) & LOG_SINK_MASK(sink)) {
+			drain_sink(sink, budget);
+		}
+	}
+}
+
+void logring_set_sinks(int sinks)
+{
+	ring.sinks = sinks;
+}
+
+int logring_get_sinks(void)
+{
+	return ring.sinks;
+}
+
+const struct log_ring *logring_get(void)
+{
+	return &ring;
+}
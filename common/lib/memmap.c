@@ -18,8 +18,11 @@
 /*********************************************************************************/
 
 #include <firmware/memmap.h>
+#include <lib/arena.h>
+#include <lib/numa.h>
 #include <lib/string.h>
 #include <print.h>
+#include <axboot.h>
 
 #include <stdint.h>
 #include <stddef.h>
@@ -28,10 +31,182 @@ void memmap_dump(struct memory_map_info *memmap)
 {
 	debug("Dumping memory map:\r\n");
 	for (size_t i = 0; i < memmap->entry_count; i++) {
-		debug("Entry %u: base=0x%llx length=%llu type=%s\r\n", i, memmap->entries[i].base, memmap->entries[i].length, memmap_type_to_str(memmap->entries[i].type));
+		debug("Entry %u: base=0x%llx length=%llu type=%s%s node=%d\r\n", i, memmap->entries[i].base, memmap->entries[i].length, memmap_type_to_str(memmap->entries[i].type),
+			  (memmap->entries[i].flags & MEMMAP_FLAG_MIRRORED) ? " (mirrored)" : "", (int)memmap->entries[i].proximity);
 	}
 }
 
+// Sorts the map by base address, drops empty entries and merges adjacent or
+// overlapping entries of the same type, flags and proximity domain, all in place.
+void memmap_normalize(struct memory_map_info *memmap)
+{
+	struct memory_map_entry *entries = memmap->entries;
+	uint64_t count = 0;
+
+	if (memmap->entry_count == 0) {
+		return;
+	}
+
+	// firmware maps are almost always sorted already, which makes
+	// insertion sort close to a single pass
+	for (uint64_t i = 1; i < memmap->entry_count; i++) {
+		struct memory_map_entry entry = entries[i];
+		uint64_t j = i;
+
+		while (j > 0 && entries[j - 1].base > entry.base) {
+			entries[j] = entries[j - 1];
+			j--;
+		}
+		entries[j] = entry;
+	}
+
+	for (uint64_t i = 0; i < memmap->entry_count; i++) {
+		struct memory_map_entry *entry = &entries[i];
+
+		if (entry->length == 0) {
+			continue;
+		}
+
+		if (count > 0) {
+			struct memory_map_entry *prev = &entries[count - 1];
+			uint64_t prev_end = prev->base + prev->length;
+
+			if (prev->type == entry->type && prev->flags == entry->flags &&
+				prev->proximity == entry->proximity && prev_end >= entry->base) {
+				if (entry->base + entry->length > prev_end) {
+					prev->length = entry->base + entry->length - prev->base;
+				}
+				continue;
+			}
+		}
+
+		entries[count++] = *entry;
+	}
+
+	memmap->entry_count = count;
+}
+
+// Where the piece of memory starting at address ends, and which domain it's in
+static uint64_t memmap_numa_piece(uint64_t address, uint64_t end, const struct numa_range *ranges, uint32_t range_count, uint32_t *proximity)
+{
+	*proximity = MEMMAP_NO_PROXIMITY;
+
+	for (uint32_t i = 0; i < range_count; i++) {
+		uint64_t range_end = ranges[i].base + ranges[i].length;
+
+		if (address >= ranges[i].base && address < range_end) {
+			*proximity = ranges[i].proximity;
+			return (range_end < end) ? range_end : end;
+		}
+
+		// not covered, runs up to the next range that starts inside
+		if (ranges[i].base > address && ranges[i].base < end) {
+			end = ranges[i].base;
+		}
+	}
+
+	return end;
+}
+
+// Cuts one entry into its per-domain pieces and stores them in out, if
+// given. Returns the number of pieces either way.
+static uint64_t memmap_split_entry(struct memory_map_entry *entry, const struct numa_range *ranges, uint32_t range_count, struct memory_map_entry *out)
+{
+	uint64_t address = entry->base;
+	uint64_t end = entry->base + entry->length;
+	uint64_t count = 0;
+
+	while (address < end) {
+		uint32_t proximity;
+		uint64_t piece_end = memmap_numa_piece(address, end, ranges, range_count, &proximity);
+
+		if (out != NULL) {
+			out[count].base = address;
+			out[count].length = piece_end - address;
+			out[count].type = entry->type;
+			out[count].flags = entry->flags;
+			out[count].proximity = proximity;
+		}
+		count++;
+
+		address = piece_end;
+	}
+
+	return count;
+}
+
+void memmap_split_numa(struct memory_map_info *memmap, const struct numa_range *ranges, uint32_t range_count)
+{
+	struct memory_map_entry *entries;
+	uint64_t count = 0;
+
+	if (range_count == 0 || memmap->entry_count == 0) {
+		return;
+	}
+
+	// count the pieces first, firmware maps may overlap so there's no
+	// safe upper bound to size the new map by
+	for (uint64_t i = 0; i < memmap->entry_count; i++) {
+		count += memmap_split_entry(&memmap->entries[i], ranges, range_count, NULL);
+	}
+
+	// straight from the loader arena whatever the size, so room reserved
+	// before the map was taken covers it and the firmware isn't called
+	entries = arena_alloc(&g_loader_arena, count * sizeof(struct memory_map_entry));
+	if (entries == NULL) {
+		debug("ERROR: Couldn't allocate the NUMA-split memory map\r\n");
+		return;
+	}
+
+	count = 0;
+	for (uint64_t i = 0; i < memmap->entry_count; i++) {
+		count += memmap_split_entry(&memmap->entries[i], ranges, range_count, &entries[count]);
+	}
+
+	free(memmap->entries);
+	memmap->entries = entries;
+	memmap->entry_count = count;
+}
+
+bool memmap_find_preferred(struct memory_map_info *memmap, uint32_t proximity, uint64_t *base, uint64_t *length)
+{
+	// mirrored and local, mirrored, local
+	static const struct {
+		bool mirrored;
+		bool local;
+	} tiers[] = { { true, true }, { true, false }, { false, true } };
+
+	for (size_t tier = 0; tier < ARRAY_LENGTH(tiers); tier++) {
+		struct memory_map_entry *best = NULL;
+
+		if (tiers[tier].local && proximity == MEMMAP_NO_PROXIMITY) {
+			continue;
+		}
+
+		for (uint64_t i = 0; i < memmap->entry_count; i++) {
+			struct memory_map_entry *entry = &memmap->entries[i];
+
+			if (entry->type != MemoryMapUsable ||
+				(tiers[tier].mirrored && !(entry->flags & MEMMAP_FLAG_MIRRORED)) ||
+				(tiers[tier].local && entry->proximity != proximity)) {
+				continue;
+			}
+
+			if (best == NULL || entry->length > best->length) {
+				best = entry;
+			}
+		}
+
+		if (best != NULL) {
+			*base = best->base;
+			*length = best->length;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 char *memmap_type_to_str(uint16_t type)
 {
 	switch (type) {
@@ -49,6 +224,10 @@ char *memmap_type_to_str(uint16_t type)
 			return "MMIO";
 		case MemoryMapUnusable:
 			return "Unusable";
+		case MemoryMapPersistent:
+			return "Persistent";
+		case MemoryMapSpecificPurpose:
+			return "Specific Purpose";
         default:
 			return "Unknown";
 	}
@@ -0,0 +1,110 @@
+/*********************************************************************************/
+/* Module Name:  memstat.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/memstat.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static struct memstat_category categories[MemStatCount] = {0};
+
+static uint64_t current = 0;
+static uint64_t peak = 0;
+static uint64_t fw_calls = 0;
+
+static const char *category_names[MemStatCount] = {
+	"page tables",
+	"kernel",
+	"modules",
+	"boot info",
+	"stack",
+	"transient",
+};
+
+void memstat_alloc(int category, uint64_t bytes)
+{
+	struct memstat_category *cat;
+
+	if (category < 0 || category >= MemStatCount) {
+		return;
+	}
+	cat = &categories[category];
+
+	cat->count++;
+	cat->bytes += bytes;
+	cat->current += bytes;
+	if (cat->current > cat->peak) {
+		cat->peak = cat->current;
+	}
+
+	current += bytes;
+	if (current > peak) {
+		peak = current;
+	}
+}
+
+void memstat_free(int category, uint64_t bytes)
+{
+	struct memstat_category *cat;
+
+	if (category < 0 || category >= MemStatCount) {
+		return;
+	}
+	cat = &categories[category];
+
+	bytes = (bytes > cat->current) ? cat->current : bytes;
+	cat->current -= bytes;
+	current -= bytes;
+}
+
+void memstat_fw_call(void)
+{
+	fw_calls++;
+}
+
+const struct memstat_category *memstat_get(int category)
+{
+	if (category < 0 || category >= MemStatCount) {
+		return NULL;
+	}
+
+	return &categories[category];
+}
+
+uint64_t memstat_get_peak(void)
+{
+	return peak;
+}
+
+uint64_t memstat_get_fw_calls(void)
+{
+	return fw_calls;
+}
+
+void memstat_dump(void)
+{
+	debug("Memory usage:\r\n");
+	for (int i = 0; i < MemStatCount; i++) {
+		debug("- %s: %llu allocations, %llu KiB total, %llu KiB in use, %llu KiB peak\r\n",
+			  category_names[i], categories[i].count, categories[i].bytes / 1024,
+			  categories[i].current / 1024, categories[i].peak / 1024);
+	}
+	debug("- peak: %llu KiB, %llu firmware calls\r\n", peak / 1024, fw_calls);
+}
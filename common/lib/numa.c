@@ -0,0 +1,228 @@
+/*********************************************************************************/
+/* Module Name:  numa.c                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/numa.h>
+#include <lib/acpi.h>
+#include <arch/cpu/cpu.h>
+#include <firmware/hwmgmnt.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+struct acpi_srat {
+	struct acpi_sdt_header header;
+	uint32_t reserved1;
+	uint64_t reserved2;
+} __attribute__((packed));
+
+enum {
+	SratCpuAffinity = 0,
+	SratMemoryAffinity = 1,
+	SratX2apicAffinity = 2,
+};
+
+struct srat_cpu_affinity {
+	uint8_t type;
+	uint8_t length;
+	uint8_t proximity_low;
+	uint8_t apic_id;
+	uint32_t flags;
+	uint8_t sapic_eid;
+	uint8_t proximity_high[3];
+	uint32_t clock_domain;
+} __attribute__((packed));
+
+struct srat_memory_affinity {
+	uint8_t type;
+	uint8_t length;
+	uint32_t proximity;
+	uint16_t reserved1;
+	uint64_t base;
+	uint64_t length_bytes;
+	uint32_t reserved2;
+	uint32_t flags;
+	uint64_t reserved3;
+} __attribute__((packed));
+
+struct srat_x2apic_affinity {
+	uint8_t type;
+	uint8_t length;
+	uint16_t reserved1;
+	uint32_t proximity;
+	uint32_t x2apic_id;
+	uint32_t flags;
+	uint32_t clock_domain;
+	uint32_t reserved2;
+} __attribute__((packed));
+
+#define SRAT_ENABLED (1 << 0)
+
+struct acpi_slit {
+	struct acpi_sdt_header header;
+	uint64_t localities;
+	uint8_t distances[];
+} __attribute__((packed));
+
+static struct {
+	bool initialized;
+	struct acpi_srat *srat;
+	struct acpi_slit *slit;
+	struct numa_range ranges[NUMA_MAX_RANGES];
+	uint32_t range_count;
+	uint32_t bsp_proximity;
+} numa;
+
+// SRAT entries start with a type and a length byte
+static uint8_t *srat_next(uint8_t *entry)
+{
+	uint8_t *end = (uint8_t *)numa.srat + numa.srat->header.length;
+
+	entry = (entry == NULL) ? (uint8_t *)numa.srat + sizeof(struct acpi_srat) : entry + entry[1];
+	if (entry + 2 > end || entry[1] < 2 || entry + entry[1] > end) {
+		return NULL;
+	}
+
+	return entry;
+}
+
+uint32_t numa_get_cpu_proximity(uint32_t apic_id)
+{
+	if (numa.srat == NULL) {
+		return NUMA_NO_PROXIMITY;
+	}
+
+	for (uint8_t *entry = srat_next(NULL); entry != NULL; entry = srat_next(entry)) {
+		if (entry[0] == SratCpuAffinity && entry[1] >= sizeof(struct srat_cpu_affinity)) {
+			struct srat_cpu_affinity *cpu = (struct srat_cpu_affinity *)entry;
+			if ((cpu->flags & SRAT_ENABLED) && cpu->apic_id == apic_id) {
+				return cpu->proximity_low | ((uint32_t)cpu->proximity_high[0] << 8) |
+					   ((uint32_t)cpu->proximity_high[1] << 16) | ((uint32_t)cpu->proximity_high[2] << 24);
+			}
+		} else if (entry[0] == SratX2apicAffinity && entry[1] >= sizeof(struct srat_x2apic_affinity)) {
+			struct srat_x2apic_affinity *cpu = (struct srat_x2apic_affinity *)entry;
+			if ((cpu->flags & SRAT_ENABLED) && cpu->x2apic_id == apic_id) {
+				return cpu->proximity;
+			}
+		}
+	}
+
+	return NUMA_NO_PROXIMITY;
+}
+
+static uint32_t numa_bsp_apic_id(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	// leaf 0xb has the full x2APIC ID, leaf 1 only the low 8 bits
+	cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0xb) {
+		cpuid(0xb, 0, &eax, &ebx, &ecx, &edx);
+		if (ebx != 0) {
+			return edx;
+		}
+	}
+
+	cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+	return ebx >> 24;
+}
+
+int numa_init(void)
+{
+	if (numa.initialized) {
+		return numa.range_count ? 0 : -1;
+	}
+	numa.initialized = true;
+	numa.bsp_proximity = NUMA_NO_PROXIMITY;
+
+	numa.srat = fw_get_acpi_table("SRAT");
+	if (numa.srat == NULL || numa.srat->header.length < sizeof(struct acpi_srat)) {
+		numa.srat = NULL;
+		return -1;
+	}
+
+	for (uint8_t *entry = srat_next(NULL); entry != NULL; entry = srat_next(entry)) {
+		if (entry[0] != SratMemoryAffinity || entry[1] < sizeof(struct srat_memory_affinity)) {
+			continue;
+		}
+
+		struct srat_memory_affinity *memory = (struct srat_memory_affinity *)entry;
+		if (!(memory->flags & SRAT_ENABLED) || memory->length_bytes == 0) {
+			continue;
+		}
+
+		if (numa.range_count >= NUMA_MAX_RANGES) {
+			debug("NUMA: more than %u memory ranges, ignoring the rest\r\n", NUMA_MAX_RANGES);
+			break;
+		}
+
+		struct numa_range *range = &numa.ranges[numa.range_count++];
+		range->base = memory->base;
+		range->length = memory->length_bytes;
+		range->proximity = memory->proximity;
+	}
+
+	numa.bsp_proximity = numa_get_cpu_proximity(numa_bsp_apic_id());
+
+	numa.slit = fw_get_acpi_table("SLIT");
+	if (numa.slit != NULL &&
+		(numa.slit->header.length < sizeof(struct acpi_slit) ||
+		 numa.slit->localities * numa.slit->localities > numa.slit->header.length - sizeof(struct acpi_slit))) {
+		debug("NUMA: SLIT is truncated, ignoring it\r\n");
+		numa.slit = NULL;
+	}
+
+	debug("NUMA: %u memory ranges, BSP in domain %u\r\n", numa.range_count, numa.bsp_proximity);
+
+	return numa.range_count ? 0 : -1;
+}
+
+const struct numa_range *numa_get_ranges(uint32_t *count)
+{
+	*count = numa.range_count;
+	return numa.ranges;
+}
+
+uint32_t numa_get_proximity(uint64_t address)
+{
+	for (uint32_t i = 0; i < numa.range_count; i++) {
+		if (address >= numa.ranges[i].base && address - numa.ranges[i].base < numa.ranges[i].length) {
+			return numa.ranges[i].proximity;
+		}
+	}
+
+	return NUMA_NO_PROXIMITY;
+}
+
+uint32_t numa_get_bsp_proximity(void)
+{
+	return numa.bsp_proximity;
+}
+
+const uint8_t *numa_get_distances(uint64_t *localities)
+{
+	if (numa.slit == NULL) {
+		*localities = 0;
+		return NULL;
+	}
+
+	*localities = numa.slit->localities;
+	return numa.slit->distances;
+}
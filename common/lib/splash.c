@@ -0,0 +1,244 @@
+/*********************************************************************************/
+/* Module Name:  splash.c                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/splash.h>
+#include <lib/string.h>
+#include <lib/timestamp.h>
+#include <arch/cpu/cpu.h>
+#include <firmware/fb.h>
+#include <firmware/file.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// QOI, see https://qoiformat.org/qoi-specification.pdf
+//
+
+#define QOI_MAGIC 0x66696f71 // "qoif"
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK 0xc0
+
+// refuses anything that couldn't be on a screen anyway
+#define SPLASH_MAX_DIMENSION 8192
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Decodes straight into BGRX in a single pass; transparent pixels are
+// blended against black since Blt() ignores alpha
+static int qoi_decode(const uint8_t *data, size_t size, uint32_t *pixels, uint32_t count)
+{
+	uint8_t index[64][4] = {0};
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	size_t pos = QOI_HEADER_SIZE;
+	size_t end = size - QOI_PADDING_SIZE;
+	uint32_t run = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (run > 0) {
+			run--;
+		} else {
+			if (pos >= end) {
+				return -1;
+			}
+
+			uint8_t op = data[pos++];
+			if (op == QOI_OP_RGB) {
+				if (pos + 3 > end) {
+					return -1;
+				}
+				r = data[pos];
+				g = data[pos + 1];
+				b = data[pos + 2];
+				pos += 3;
+			} else if (op == QOI_OP_RGBA) {
+				if (pos + 4 > end) {
+					return -1;
+				}
+				r = data[pos];
+				g = data[pos + 1];
+				b = data[pos + 2];
+				a = data[pos + 3];
+				pos += 4;
+			} else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+				r = index[op][0];
+				g = index[op][1];
+				b = index[op][2];
+				a = index[op][3];
+			} else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+				r += ((op >> 4) & 0x03) - 2;
+				g += ((op >> 2) & 0x03) - 2;
+				b += (op & 0x03) - 2;
+			} else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+				if (pos >= end) {
+					return -1;
+				}
+				uint8_t second = data[pos++];
+				int8_t dg = (op & 0x3f) - 32;
+				r += dg - 8 + ((second >> 4) & 0x0f);
+				g += dg;
+				b += dg - 8 + (second & 0x0f);
+			} else {
+				run = op & 0x3f;
+			}
+
+			uint8_t *slot = index[(r * 3 + g * 5 + b * 7 + a * 11) % 64];
+			slot[0] = r;
+			slot[1] = g;
+			slot[2] = b;
+			slot[3] = a;
+		}
+
+		if (a == 255) {
+			pixels[i] = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+		} else {
+			pixels[i] = ((uint32_t)(r * a / 255) << 16) | ((uint32_t)(g * a / 255) << 8) | (b * a / 255);
+		}
+	}
+
+	return 0;
+}
+
+void splash_show(const char *path)
+{
+	FILE *file;
+	uint8_t *data;
+	uint32_t *pixels;
+	bool decoded = false;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fb_width;
+	uint32_t fb_height;
+	uint16_t bpp;
+	uint8_t format;
+	void *fb;
+	int size;
+
+	// the caller has set up the framebuffer already, this can't modeset
+	if (path == NULL || fw_initialize_fb() != 0) {
+		return;
+	}
+	fw_get_framebuffer(&fb, &fb_width, &fb_height, &bpp, &format);
+
+	uint64_t start = rdtsc();
+
+	file = fw_file_open(NULL, path);
+	if (file == NULL) {
+		debug("splash: couldn't open %s\r\n", path);
+		return;
+	}
+
+	size = fw_file_size(file);
+	if (size < (int)sizeof(struct splash_raw_header) ||
+		(data = malloc(size)) == NULL) {
+		fw_file_close(file);
+		return;
+	}
+
+	if (fw_file_read(file, size, data) != 0) {
+		debug("splash: couldn't read %s\r\n", path);
+		fw_file_close(file);
+		free(data);
+		return;
+	}
+	fw_file_close(file);
+
+	uint64_t loaded = rdtsc();
+
+	if (*(uint32_t *)data == SPLASH_RAW_MAGIC) {
+		struct splash_raw_header *header = (struct splash_raw_header *)data;
+
+		width = header->width;
+		height = header->height;
+		if (width > SPLASH_MAX_DIMENSION || height > SPLASH_MAX_DIMENSION ||
+			sizeof(struct splash_raw_header) + (uint64_t)width * height * 4 > (uint64_t)size) {
+			debug("splash: %s is truncated\r\n", path);
+			free(data);
+			return;
+		}
+
+		// already in Blt() layout, nothing to decode
+		pixels = (uint32_t *)(data + sizeof(struct splash_raw_header));
+	} else if (*(uint32_t *)data == QOI_MAGIC && size >= QOI_HEADER_SIZE + QOI_PADDING_SIZE) {
+		width = read_be32(data + 4);
+		height = read_be32(data + 8);
+		if (width == 0 || height == 0 || width > SPLASH_MAX_DIMENSION || height > SPLASH_MAX_DIMENSION) {
+			debug("splash: %s has a bad size\r\n", path);
+			free(data);
+			return;
+		}
+
+		pixels = malloc((size_t)width * height * sizeof(uint32_t));
+		if (pixels == NULL) {
+			free(data);
+			return;
+		}
+		decoded = true;
+
+		if (qoi_decode(data, size, pixels, width * height) != 0) {
+			debug("splash: %s is corrupt\r\n", path);
+			free(pixels);
+			free(data);
+			return;
+		}
+	} else {
+		debug("splash: %s is neither QOI nor a raw splash\r\n", path);
+		free(data);
+		return;
+	}
+
+	uint64_t ready = rdtsc();
+
+	if (width > fb_width || height > fb_height) {
+		debug("splash: %ux%u doesn't fit on a %ux%u screen\r\n", width, height, fb_width, fb_height);
+	} else {
+		fw_fb_blt(pixels, (fb_width - width) / 2, (fb_height - height) / 2, width, height);
+	}
+
+	uint64_t done = rdtsc();
+
+	// the TSC is calibrated once at the handoff, until then only cycles are known
+	uint64_t frequency = timestamp_get_frequency();
+	if (frequency != 0) {
+		debug("splash: %ux%u %s, read %llu us, decode %llu us, present %llu us\r\n",
+			  width, height, decoded ? "QOI" : "raw", (loaded - start) * 1000000 / frequency,
+			  (ready - loaded) * 1000000 / frequency, (done - ready) * 1000000 / frequency);
+	} else {
+		debug("splash: %ux%u %s, read %llu, decode %llu, present %llu TSC cycles\r\n",
+			  width, height, decoded ? "QOI" : "raw", loaded - start, ready - loaded, done - ready);
+	}
+
+	if (decoded) {
+		free(pixels);
+	}
+	free(data);
+}
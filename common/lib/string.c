@@ -18,14 +18,35 @@
 /*********************************************************************************/
 
 #include <lib/string.h>
+#include <lib/arena.h>
+#include <lib/memstat.h>
 #include <firmware/memory.h>
 
 #include <stdint.h>
 #include <stddef.h>
 
+// larger buffers go straight to the firmware so they can be freed
+#define MALLOC_ARENA_MAX (ARENA_CHUNK_SIZE / 4)
+
+// firmware-backed buffers remember their size for accounting
+#define MALLOC_HEADER_SIZE 16
+
 void *malloc(size_t size)
 {
-	return fw_allocmem(size);
+	uint8_t *p;
+
+	if (size <= MALLOC_ARENA_MAX) {
+		return arena_alloc(&g_loader_arena, size);
+	}
+
+	p = fw_allocmem(size + MALLOC_HEADER_SIZE);
+	if (p == NULL) {
+		return NULL;
+	}
+
+	*(uint64_t *)p = size;
+	memstat_alloc(MemStatTransient, size);
+	return p + MALLOC_HEADER_SIZE;
 }
 
 int mallocpage(size_t np, void *base)
@@ -35,7 +56,16 @@ int mallocpage(size_t np, void *base)
 
 void free(void *p)
 {
-	fw_free(p);
+	uint8_t *base;
+
+	// arena memory is only given back by arena_reset() or at handoff
+	if (p == NULL || arena_owns(&g_loader_arena, p)) {
+		return;
+	}
+
+	base = (uint8_t *)p - MALLOC_HEADER_SIZE;
+	memstat_free(MemStatTransient, *(uint64_t *)base);
+	fw_free(base);
 }
 
 size_t mbstowcs(wchar_t *dest, const char **src, size_t len)
@@ -73,9 +103,9 @@ size_t strlen(const char *str)
 		return 0;
 	}
 
-	do {
+	while (str[count] != '\0') {
 		count++;
-	} while (str[count] != '\0');
+	}
 
 	return count;
 }
@@ -0,0 +1,337 @@
+/*********************************************************************************/
+/* Module Name:  timestamp.c                                                     */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/timestamp.h>
+#include <lib/acpi.h>
+#include <firmware/console.h>
+#include <firmware/hwmgmnt.h>
+#include <arch/cpu/cpu.h>
+#include <print.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// last resort calibration window, only used without CPUID or a reference timer
+#define TIMESTAMP_CALIBRATION_US 1000
+
+// a reference measurement shorter than this is topped up by spinning
+#define TIMESTAMP_MIN_WINDOW_US 10000
+
+// No real TSC runs slower than this; polls further apart than half the
+// reference timer's wrap-around at this speed restart the measurement, as
+// the timer may have wrapped more than once
+#define TIMESTAMP_MIN_TSC_HZ 1000000000ULL
+
+// nor faster than this; a reference timer that hasn't covered the minimum
+// window in that many ticks is broken
+#define TIMESTAMP_MAX_TSC_HZ 10000000000ULL
+
+#define PM_TIMER_FREQUENCY 3579545
+
+#define HPET_CAPABILITIES 0x00
+#define HPET_CONFIG 0x10
+#define HPET_COUNTER 0xf0
+#define HPET_CAP_COUNT_64 (1 << 13)
+#define HPET_CONFIG_ENABLE (1 << 0)
+#define HPET_MAX_PERIOD_FS 100000000
+
+static uint64_t timestamps[TimestampCount] = {0};
+static uint64_t tsc_frequency = 0;
+static int tsc_source = TimestampSourceUnknown;
+
+//
+// Without CPUID leaf 0x15 the TSC is measured against a reference timer over
+// the whole time the loader spends in the menu and reading files, so a
+// precise frequency usually costs no waiting at all.
+//
+
+static struct {
+	int source;
+	uint64_t frequency;
+	uint64_t mask;
+	bool port_io;
+	uint16_t port;
+	volatile void *mmio;
+	bool wide; // 64-bit MMIO reads
+
+	bool running;
+	uint64_t max_gap; // TSC ticks
+	uint64_t tsc_start;
+	uint64_t tsc_last;
+	uint64_t ref_last;
+	uint64_t ref_elapsed;
+	uint64_t window_ns;
+} calibration;
+
+static uint64_t reference_read(void)
+{
+	if (calibration.port_io) {
+		return inl(calibration.port) & calibration.mask;
+	}
+	if (calibration.wide) {
+		return *(volatile uint64_t *)calibration.mmio;
+	}
+	return *(volatile uint32_t *)calibration.mmio & calibration.mask;
+}
+
+// Only a running HPET is used; turning it on is the kernel's business
+static bool reference_hpet(void)
+{
+	struct acpi_hpet *hpet = fw_get_acpi_table("HPET");
+	volatile uint8_t *regs;
+	uint64_t capabilities, period;
+
+	if (hpet == NULL || hpet->header.length < sizeof(struct acpi_hpet) ||
+		hpet->base_address.address_space != ACPI_GAS_SYSTEM_MEMORY || hpet->base_address.address == 0) {
+		return false;
+	}
+
+	regs = (volatile uint8_t *)hpet->base_address.address;
+	capabilities = *(volatile uint64_t *)(regs + HPET_CAPABILITIES);
+	period = capabilities >> 32;
+	if (period == 0 || period > HPET_MAX_PERIOD_FS ||
+		!(*(volatile uint64_t *)(regs + HPET_CONFIG) & HPET_CONFIG_ENABLE)) {
+		return false;
+	}
+
+	calibration.source = TimestampSourceHpet;
+	calibration.frequency = 1000000000000000ULL / period;
+	calibration.wide = (capabilities & HPET_CAP_COUNT_64) != 0;
+	calibration.mask = calibration.wide ? UINT64_MAX : UINT32_MAX;
+	calibration.mmio = regs + HPET_COUNTER;
+	return true;
+}
+
+static bool reference_pm_timer(void)
+{
+	struct acpi_fadt *fadt = fw_get_acpi_table("FACP");
+
+	if (fadt == NULL || fadt->header.length < offsetof(struct acpi_fadt, reserved3)) {
+		return false;
+	}
+
+	calibration.mask = (fadt->flags & ACPI_FADT_TMR_VAL_EXT) ? UINT32_MAX : 0xffffff;
+	if (fadt->header.length >= sizeof(struct acpi_fadt) && fadt->x_pm_tmr_blk.address != 0) {
+		if (fadt->x_pm_tmr_blk.address_space == ACPI_GAS_SYSTEM_IO) {
+			calibration.port_io = true;
+			calibration.port = (uint16_t)fadt->x_pm_tmr_blk.address;
+		} else if (fadt->x_pm_tmr_blk.address_space == ACPI_GAS_SYSTEM_MEMORY) {
+			calibration.mmio = (volatile void *)fadt->x_pm_tmr_blk.address;
+		} else {
+			return false;
+		}
+	} else if (fadt->pm_tmr_blk != 0 && fadt->pm_tmr_len == 4) {
+		calibration.port_io = true;
+		calibration.port = (uint16_t)fadt->pm_tmr_blk;
+	} else {
+		return false;
+	}
+
+	calibration.source = TimestampSourcePmTimer;
+	calibration.frequency = PM_TIMER_FREQUENCY;
+	return true;
+}
+
+static void calibration_restart(uint64_t tsc, uint64_t ref)
+{
+	calibration.tsc_start = tsc;
+	calibration.tsc_last = tsc;
+	calibration.ref_last = ref;
+	calibration.ref_elapsed = 0;
+}
+
+static bool timestamp_from_cpuid(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t max_leaf;
+
+	cpuid(0, 0, &max_leaf, &ebx, &ecx, &edx);
+	if (max_leaf < 0x15) {
+		return false;
+	}
+
+	// leaf 0x15 gives the TSC/crystal ratio and, on most parts, the crystal clock
+	cpuid(0x15, 0, &eax, &ebx, &ecx, &edx);
+	if (eax == 0 || ebx == 0) {
+		return false;
+	}
+	if (ecx != 0) {
+		tsc_frequency = ((uint64_t)ecx * ebx) / eax;
+		tsc_source = TimestampSourceCpuid15;
+		return true;
+	}
+
+	// no crystal clock, but the TSC runs at the base frequency from leaf 0x16
+	if (max_leaf >= 0x16) {
+		uint32_t base_mhz;
+		cpuid(0x16, 0, &base_mhz, &ebx, &ecx, &edx);
+		if (base_mhz != 0) {
+			tsc_frequency = (uint64_t)base_mhz * 1000000;
+			tsc_source = TimestampSourceCpuid16;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void timestamp_record(int id)
+{
+	if (id < 0 || id >= TimestampCount) {
+		return;
+	}
+
+	timestamps[id] = rdtsc();
+	timestamp_calibration_poll();
+}
+
+uint64_t timestamp_get(int id)
+{
+	if (id < 0 || id >= TimestampCount) {
+		return 0;
+	}
+
+	return timestamps[id];
+}
+
+void timestamp_calibration_start(void)
+{
+	if (tsc_frequency != 0 || calibration.running || timestamp_from_cpuid()) {
+		return;
+	}
+
+	if (!reference_hpet() && !reference_pm_timer()) {
+		return;
+	}
+
+	uint64_t half_wrap_s = (calibration.mask / 2) / calibration.frequency;
+	if (half_wrap_s >= UINT64_MAX / TIMESTAMP_MIN_TSC_HZ) {
+		calibration.max_gap = UINT64_MAX;
+	} else if (half_wrap_s == 0) {
+		calibration.max_gap = ((calibration.mask / 2) * TIMESTAMP_MIN_TSC_HZ) / calibration.frequency;
+	} else {
+		calibration.max_gap = half_wrap_s * TIMESTAMP_MIN_TSC_HZ;
+	}
+	calibration.running = true;
+	calibration_restart(rdtsc(), reference_read());
+}
+
+void timestamp_calibration_poll(void)
+{
+	uint64_t tsc, ref;
+
+	if (!calibration.running) {
+		return;
+	}
+
+	tsc = rdtsc();
+	ref = reference_read();
+	if (tsc - calibration.tsc_last > calibration.max_gap) {
+		calibration_restart(tsc, ref);
+		return;
+	}
+
+	calibration.ref_elapsed += (ref - calibration.ref_last) & calibration.mask;
+	calibration.tsc_last = tsc;
+	calibration.ref_last = ref;
+}
+
+void timestamp_calibrate(void)
+{
+	uint64_t min_ticks = (calibration.frequency * TIMESTAMP_MIN_WINDOW_US) / 1000000;
+	uint64_t start;
+
+	if (tsc_frequency != 0 || timestamp_from_cpuid()) {
+		return;
+	}
+
+	if (calibration.running) {
+		uint64_t spin_limit = (TIMESTAMP_MAX_TSC_HZ / 1000000) * TIMESTAMP_MIN_WINDOW_US;
+		uint64_t spin_start = rdtsc();
+
+		timestamp_calibration_poll();
+		while (calibration.ref_elapsed < min_ticks && rdtsc() - spin_start < spin_limit) {
+			cpu_pause();
+			timestamp_calibration_poll();
+		}
+		calibration.running = false;
+	}
+
+	if (calibration.source != TimestampSourceUnknown && calibration.ref_elapsed >= min_ticks) {
+		// split up like timestamp_to_ns(), a long window would overflow
+		uint64_t tsc_elapsed = calibration.tsc_last - calibration.tsc_start;
+		uint64_t ref_elapsed = calibration.ref_elapsed;
+		tsc_frequency = (tsc_elapsed / ref_elapsed) * calibration.frequency +
+						((tsc_elapsed % ref_elapsed) * calibration.frequency) / ref_elapsed;
+		tsc_source = calibration.source;
+		calibration.window_ns = (ref_elapsed / calibration.frequency) * 1000000000ULL +
+								((ref_elapsed % calibration.frequency) * 1000000000ULL) / calibration.frequency;
+		return;
+	}
+
+	// otherwise measure it against the firmware's timer
+	if (calibration.source != TimestampSourceUnknown) {
+		debug("The %s doesn't count, calibrating against the firmware\r\n",
+			  calibration.source == TimestampSourceHpet ? "HPET" : "PM timer");
+	}
+	start = rdtsc();
+	fw_stall(TIMESTAMP_CALIBRATION_US);
+	tsc_frequency = (rdtsc() - start) * (1000000 / TIMESTAMP_CALIBRATION_US);
+	tsc_source = TimestampSourceFirmware;
+	calibration.window_ns = TIMESTAMP_CALIBRATION_US * 1000;
+}
+
+uint64_t timestamp_get_frequency(void)
+{
+	return tsc_frequency;
+}
+
+int timestamp_get_source(void)
+{
+	return tsc_source;
+}
+
+uint64_t timestamp_get_calibration_ns(void)
+{
+	return calibration.window_ns;
+}
+
+bool timestamp_tsc_invariant(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x80000007) {
+		return false;
+	}
+
+	cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+	return (edx & (1 << 8)) != 0;
+}
+
+uint64_t timestamp_to_ns(uint64_t tsc)
+{
+	if (tsc_frequency == 0 || tsc == 0) {
+		return 0;
+	}
+
+	// split up so large TSC values don't overflow
+	return (tsc / tsc_frequency) * 1000000000ULL + ((tsc % tsc_frequency) * 1000000000ULL) / tsc_frequency;
+}
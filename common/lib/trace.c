@@ -0,0 +1,107 @@
+/*********************************************************************************/
+/* Module Name:  trace.c                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/trace.h>
+#include <lib/logring.h>
+#include <lib/string.h>
+#include <arch/cpu/cpu.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#ifdef AXBOOT_TRACE
+
+// sorts before every call site, so IDs are offsets from here
+__attribute__((section(TRACE_SECTION_START), used))
+const char trace_section_start[] = TRACE_MAGIC;
+
+static size_t trace_put(uint8_t *record, size_t size, const void *data, size_t len)
+{
+	if (size + len > TRACE_RECORD_MAX) {
+		return size;
+	}
+
+	memcpy(record + size, (void *)data, len);
+	return size + len;
+}
+
+void trace_write(const char *site, ...)
+{
+	uint8_t record[TRACE_RECORD_MAX];
+	struct trace_header header;
+	struct trace_spec spec;
+	const char *fmt = site + strlen(site) + 1;
+	size_t size = 0;
+	va_list args;
+
+	header.id = (uint32_t)(site - trace_section_start);
+	header.tsc = rdtsc();
+	size = trace_put(record, size, &header, sizeof(struct trace_header));
+
+	va_start(args, site);
+	while ((fmt = trace_next_spec(fmt, &spec)) != NULL) {
+		uint64_t value;
+
+		for (int i = 0; i < spec.stars; i++) {
+			value = (uint64_t)va_arg(args, int);
+			size = trace_put(record, size, &value, sizeof(uint64_t));
+		}
+
+		switch (spec.type) {
+			case TraceArgString: {
+				const char *str = va_arg(args, const char *);
+				uint16_t len = 0;
+
+				if (str == NULL) {
+					str = "(null)";
+				}
+				// %.4s and friends are used on strings that aren't terminated
+				while (str[len] != '\0' && len < TRACE_STRING_MAX &&
+					   (spec.precision < 0 || len < spec.precision)) {
+					len++;
+				}
+
+				size = trace_put(record, size, &len, sizeof(uint16_t));
+				size = trace_put(record, size, str, len);
+				continue;
+			}
+			case TraceArgPointer:
+				value = (uint64_t)(uintptr_t)va_arg(args, void *);
+				break;
+			case TraceArgLong:
+				value = (uint64_t)va_arg(args, unsigned long long);
+				break;
+			case TraceArgDouble: {
+				double d = va_arg(args, double);
+				memcpy(&value, &d, sizeof(uint64_t));
+				break;
+			}
+			default:
+				value = (uint64_t)va_arg(args, unsigned int);
+				break;
+		}
+		size = trace_put(record, size, &value, sizeof(uint64_t));
+	}
+	va_end(args);
+
+	logring_write_record(LogLevelTrace, record, size);
+}
+
+#endif
@@ -18,7 +18,6 @@
 /*********************************************************************************/
 
 #include <arch/mm/paging.h>
-#include <firmware/file.h>
 #include <loader/elf.h>
 #include <lib/string.h>
 #include <print.h>
@@ -71,6 +70,134 @@ int elf_validate_header(Elf32_Ehdr *header)
 	return 0;
 }
 
+static int elf_walk_notes(void *notes, uint64_t size, const char *owner, elf_note_callback callback, void *ctx)
+{
+	uint32_t owner_size = strlen(owner) + 1;
+	uint64_t offset = 0;
+	int count = 0;
+
+	while (offset + sizeof(Elf64_Nhdr) <= size) {
+		Elf64_Nhdr *note = (Elf64_Nhdr *)((uint8_t *)notes + offset);
+		uint64_t name_offset = offset + sizeof(Elf64_Nhdr);
+		uint64_t desc_offset = name_offset + ROUND_UP((uint64_t)note->n_namesz, 4);
+		uint64_t next_offset = desc_offset + ROUND_UP((uint64_t)note->n_descsz, 4);
+
+		if (next_offset > size) {
+			debug("ERROR: Truncated ELF note!\r\n");
+			break;
+		}
+
+		if (note->n_namesz == owner_size &&
+			memcmp((uint8_t *)notes + name_offset, owner, owner_size) == 0) {
+			callback(note->n_type, (uint8_t *)notes + desc_offset, note->n_descsz, ctx);
+			count++;
+		}
+
+		offset = next_offset;
+	}
+
+	return count;
+}
+
+// true if [offset, offset + length) lies within a file of the given size
+static bool elf_in_file(uint64_t offset, uint64_t length, size_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+// Every program or section header has to lie in the file
+static bool elf_table_in_file(uint64_t offset, uint16_t count, uint16_t entsize, size_t min_entsize, size_t size)
+{
+	if (count == 0) {
+		return true;
+	}
+
+	return entsize >= min_entsize && elf_in_file(offset, (uint64_t)count * entsize, size);
+}
+
+int elf_parse_notes(void *kernel, size_t size, const char *owner, elf_note_callback callback, void *ctx)
+{
+	Elf32_Ehdr *header32 = (Elf32_Ehdr *)kernel;
+	Elf64_Ehdr *header64 = (Elf64_Ehdr *)kernel;
+	bool found_segment = false;
+	int count = 0;
+
+	if (size < sizeof(Elf32_Ehdr) || elf_validate_header(header32) != 0) {
+		return -1;
+	}
+
+	// notes are looked up through PT_NOTE segments first, and through
+	// SHT_NOTE sections if the kernel was linked without a PT_NOTE segment
+	if (header32->e_ident[EI_CLASS] == ELFCLASS32) {
+		if (!elf_table_in_file(header32->e_phoff, header32->e_phnum, header32->e_phentsize, sizeof(Elf32_Phdr), size) ||
+			(header32->e_shoff != 0 &&
+			 !elf_table_in_file(header32->e_shoff, header32->e_shnum, header32->e_shentsize, sizeof(Elf32_Shdr), size))) {
+			debug("ERROR: ELF headers lie outside the file!\r\n");
+			return -1;
+		}
+
+		for (uint16_t i = 0; i < header32->e_phnum; i++) {
+			Elf32_Phdr *phdr32 = (Elf32_Phdr *)((uint8_t *)kernel + header32->e_phoff + (i * header32->e_phentsize));
+			if (phdr32->p_type == PT_NOTE) {
+				if (!elf_in_file(phdr32->p_offset, phdr32->p_filesz, size)) {
+					debug("ERROR: ELF note segment lies outside the file!\r\n");
+					return -1;
+				}
+				found_segment = true;
+				count += elf_walk_notes((uint8_t *)kernel + phdr32->p_offset, phdr32->p_filesz, owner, callback, ctx);
+			}
+		}
+
+		if (!found_segment && header32->e_shoff != 0) {
+			for (uint16_t i = 0; i < header32->e_shnum; i++) {
+				Elf32_Shdr *shdr32 = (Elf32_Shdr *)((uint8_t *)kernel + header32->e_shoff + (i * header32->e_shentsize));
+				if (shdr32->sh_type == SHT_NOTE) {
+					if (!elf_in_file(shdr32->sh_offset, shdr32->sh_size, size)) {
+						debug("ERROR: ELF note section lies outside the file!\r\n");
+						return -1;
+					}
+					count += elf_walk_notes((uint8_t *)kernel + shdr32->sh_offset, shdr32->sh_size, owner, callback, ctx);
+				}
+			}
+		}
+	} else {
+		if (size < sizeof(Elf64_Ehdr) ||
+			!elf_table_in_file(header64->e_phoff, header64->e_phnum, header64->e_phentsize, sizeof(Elf64_Phdr), size) ||
+			(header64->e_shoff != 0 &&
+			 !elf_table_in_file(header64->e_shoff, header64->e_shnum, header64->e_shentsize, sizeof(Elf64_Shdr), size))) {
+			debug("ERROR: ELF headers lie outside the file!\r\n");
+			return -1;
+		}
+
+		for (uint16_t i = 0; i < header64->e_phnum; i++) {
+			Elf64_Phdr *phdr64 = (Elf64_Phdr *)((uint8_t *)kernel + header64->e_phoff + (i * header64->e_phentsize));
+			if (phdr64->p_type == PT_NOTE) {
+				if (!elf_in_file(phdr64->p_offset, phdr64->p_filesz, size)) {
+					debug("ERROR: ELF note segment lies outside the file!\r\n");
+					return -1;
+				}
+				found_segment = true;
+				count += elf_walk_notes((uint8_t *)kernel + phdr64->p_offset, phdr64->p_filesz, owner, callback, ctx);
+			}
+		}
+
+		if (!found_segment && header64->e_shoff != 0) {
+			for (uint16_t i = 0; i < header64->e_shnum; i++) {
+				Elf64_Shdr *shdr64 = (Elf64_Shdr *)((uint8_t *)kernel + header64->e_shoff + (i * header64->e_shentsize));
+				if (shdr64->sh_type == SHT_NOTE) {
+					if (!elf_in_file(shdr64->sh_offset, shdr64->sh_size, size)) {
+						debug("ERROR: ELF note section lies outside the file!\r\n");
+						return -1;
+					}
+					count += elf_walk_notes((uint8_t *)kernel + shdr64->sh_offset, shdr64->sh_size, owner, callback, ctx);
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
 bool elf_load(void *kernel, void **entryp)
 {
 	Elf32_Ehdr *header32 = (Elf32_Ehdr *)kernel;
@@ -126,7 +253,6 @@ bool elf_load(void *kernel, void **entryp)
 			if (phdr64->p_type == PT_LOAD) {
 				void *file_segment = (void *)((uintptr_t)kernel + phdr64->p_offset);
 				void *memory_segment = (void *)(uintptr_t)phdr64->p_paddr;
-				EFI_PHYSICAL_ADDRESS base;
 
 				if (phdr64->p_memsz == 0) {
 					continue;
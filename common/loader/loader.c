@@ -17,45 +17,208 @@
 /* SOFTWARE.                                                                     */
 /*********************************************************************************/
 
+#include <config/config.h>
+#include <lib/memstat.h>
 #include <lib/string.h>
+#include <lib/timestamp.h>
 #include <loader/loader.h>
 #include <protocol/abp.h>
-#include <firmware/firmware.h>
 #include <firmware/file.h>
+#include <firmware/memory.h>
+#include <firmware/memmap.h>
+#include <lib/numa.h>
 #include <print.h>
+#include <axboot.h>
 
-void loader_load(int protocol, const char *filepath)
+// files are read in chunks so staging can be interleaved with other work
+#define LOADER_CHUNK_SIZE (1024 * 1024)
+
+static struct config_entry *staged_entry = NULL;
+static struct loader_file staged_kernel;
+static struct loader_file staged_modules[CONFIG_MAX_MODULES];
+static int stage_status = 0;
+
+static int loader_file_open(struct loader_file *lf, const char *path, int category)
 {
-	uint64_t filesize;
-	FILE *file;
-	void *filebuf;
-	void *kernel_entry;
-
-	file = fw_file_open(NULL, filepath);
-	if (file == NULL) {
-		log("ERROR: Couldn't open file '%s'.\r\n", filepath);
+	memset(lf, 0, sizeof(struct loader_file));
+	lf->path = path;
+	lf->category = category;
+
+	lf->file = fw_file_open(NULL, path);
+	if (lf->file == NULL) {
+		log("ERROR: Couldn't open file '%s'.\r\n", path);
+		return -1;
+	}
+
+	lf->size = fw_file_size(lf->file);
+	if (lf->size == 0) {
+		log("ERROR: Couldn't read '%s'.\r\n", path);
+		fw_file_close(lf->file);
+		lf->file = NULL;
+		return -1;
+	}
+
+	// read straight into pages, reported as bootloader-reclaimable so the
+	// kernel doesn't hand them out before it's done with its modules
+	lf->buffer = fw_allocpages(ROUND_UP(lf->size, FW_PAGE_SIZE) / FW_PAGE_SIZE, FwMemoryReclaimable);
+	if (lf->buffer == NULL) {
+		log("ERROR: Couldn't allocate memory for '%s'.\r\n", path);
+		fw_file_close(lf->file);
+		lf->file = NULL;
+		return -1;
+	}
+	memstat_alloc(category, ROUND_UP(lf->size, FW_PAGE_SIZE));
+
+	return 0;
+}
+
+// Returns 1 once the whole file is in memory, 0 if there's more to read
+static int loader_file_step(struct loader_file *lf)
+{
+	uint64_t chunk = lf->size - lf->loaded;
+
+	if (lf->file == NULL) {
+		return 1;
+	}
+
+	if (chunk > LOADER_CHUNK_SIZE) {
+		chunk = LOADER_CHUNK_SIZE;
+	}
+
+	if (fw_file_read(lf->file, chunk, (uint8_t *)lf->buffer + lf->loaded) != 0) {
+		log("ERROR: Couldn't read '%s'.\r\n", lf->path);
+		return -1;
+	}
+
+	lf->loaded += chunk;
+	timestamp_calibration_poll();
+	if (lf->loaded < lf->size) {
+		return 0;
+	}
+
+	fw_file_close(lf->file);
+	lf->file = NULL;
+	return 1;
+}
+
+static void loader_file_drop(struct loader_file *lf)
+{
+	if (lf->file != NULL) {
+		fw_file_close(lf->file);
+	}
+
+	if (lf->buffer != NULL) {
+		memstat_free(lf->category, ROUND_UP(lf->size, FW_PAGE_SIZE));
+		fw_freepages(lf->buffer, ROUND_UP(lf->size, FW_PAGE_SIZE) / FW_PAGE_SIZE);
+	}
+
+	memset(lf, 0, sizeof(struct loader_file));
+}
+
+void loader_init_placement(void)
+{
+	struct memory_map_info memmap = {0};
+	uint32_t proximity = NUMA_NO_PROXIMITY;
+	uint64_t base, length;
+
+	fw_get_memory_map(&memmap);
+	if (memmap.entries == NULL) {
 		return;
 	}
 
-	// allocate memory for file
-	filesize = fw_file_size(file);
-	if (filesize == 0) {
-		log("ERROR: Couldn't read '%s'.\r\n", filepath);
+	if (numa_init() == 0) {
+		uint32_t range_count;
+		const struct numa_range *ranges = numa_get_ranges(&range_count);
+		memmap_split_numa(&memmap, ranges, range_count);
+		proximity = numa_get_bsp_proximity();
+	}
+
+	if (memmap_find_preferred(&memmap, proximity, &base, &length)) {
+		debug("Placing loader allocations at 0x%llx-0x%llx\r\n", base, base + length);
+		fw_set_preferred_memory(base, length);
+	}
+
+	free(memmap.entries);
+}
+
+int loader_stage_begin(struct config_entry *entry)
+{
+	loader_stage_drop();
+
+	staged_entry = entry;
+	stage_status = loader_file_open(&staged_kernel, entry->image_path, MemStatKernel);
+
+	for (uint32_t i = 0; i < entry->module_count && stage_status == 0; i++) {
+		stage_status = loader_file_open(&staged_modules[i], entry->module_paths[i], MemStatModules);
+	}
+
+	return stage_status;
+}
+
+int loader_stage_step(void)
+{
+	if (staged_entry == NULL) {
+		return -1;
+	}
+
+	if (stage_status != 0) {
+		return stage_status;
+	}
+
+	// read one chunk of the first file that isn't complete yet
+	stage_status = loader_file_step(&staged_kernel);
+	if (stage_status != 1) {
+		return stage_status;
+	}
+
+	for (uint32_t i = 0; i < staged_entry->module_count; i++) {
+		stage_status = loader_file_step(&staged_modules[i]);
+		if (stage_status != 1) {
+			return stage_status;
+		}
+	}
+
+	return stage_status;
+}
+
+void loader_stage_drop(void)
+{
+	if (staged_entry == NULL) {
 		return;
 	}
 
-	filebuf = malloc(filesize);
+	loader_file_drop(&staged_kernel);
+	for (uint32_t i = 0; i < staged_entry->module_count; i++) {
+		loader_file_drop(&staged_modules[i]);
+	}
+
+	staged_entry = NULL;
+	stage_status = 0;
+}
+
+void loader_load(struct config_entry *entry)
+{
+	int status;
 
-	if (fw_file_read(file, filesize, filebuf) != 0) {
-		log("ERROR: Couldn't read '%s'.\r\n", filepath);
+	// reuse whatever was already staged for this entry
+	if (staged_entry != entry && loader_stage_begin(entry) != 0) {
+		loader_stage_drop();
 		return;
 	}
 
-	fw_file_close(file);
+	do {
+		status = loader_stage_step();
+	} while (status == 0);
+
+	if (status < 0) {
+		loader_stage_drop();
+		return;
+	}
+	timestamp_record(TimestampKernelLoaded);
 
-	switch (protocol) {
+	switch (entry->protocol) {
 		case ProtocolAbp:
-			abp_load(filebuf, filesize);
+			abp_load(staged_kernel.buffer, staged_kernel.size, staged_modules, entry->module_count);
 			break;
 		default:
 			log("ERROR: Invalid protocol specified!\r\n");
@@ -63,4 +226,4 @@ void loader_load(int protocol, const char *filepath)
 	}
 
 	log("ERROR: Kernel returned!\r\n");
-}
\ No newline at end of file
+}
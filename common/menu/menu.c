@@ -17,11 +17,156 @@
 /* SOFTWARE.                                                                     */
 /*********************************************************************************/
 
+#include <menu/menu.h>
+#include <config/config.h>
+#include <firmware/console.h>
+#include <loader/loader.h>
+#include <lib/history.h>
+#include <lib/logring.h>
+#include <print.h>
+
 #include <stdint.h>
 #include <stdbool.h>
 
-void menu_main(void)
+#define MENU_TICK_MS 100
+
+// log bytes sent to the serial port per idle iteration
+#define MENU_LOG_BUDGET 512
+
+static void menu_draw(uint32_t selected)
+{
+	uint32_t entry_count = config_get_entry_count();
+
+	fw_console_clear();
+	log("AxBoot\r\n\r\n");
+
+	for (uint32_t i = 0; i < entry_count; i++) {
+		log("%s %s\r\n", (i == selected) ? ">" : " ", config_get_entry(i)->name);
+	}
+
+	log("\r\nUse the arrow keys to select an entry, Enter to boot, H for boot history.\r\n");
+}
+
+static void menu_draw_history(void)
+{
+	uint32_t count = history_get_count();
+
+	fw_console_clear();
+	log("Boot history (times in ms, oldest first)\r\n\r\n");
+
+	if (count == 0) {
+		log("No boots have been recorded yet.\r\n");
+	} else {
+		log("  firmware  config    menu    load prepare   total  kernel KiB  modules KiB\r\n");
+		for (uint32_t i = 0; i < count; i++) {
+			const struct history_record *record = history_get(i);
+			log("%10u %7u %7u %7u %7u %7u %11u %12u\r\n",
+				record->firmware_us / 1000, record->config_us / 1000, record->menu_us / 1000,
+				record->load_us / 1000, record->prepare_us / 1000, record->total_us / 1000,
+				record->kernel_size / 1024, record->modules_size / 1024);
+		}
+	}
+
+	log("\r\nPress any key to return.\r\n");
+}
+
+static void menu_draw_countdown(uint32_t seconds)
 {
-	//int entry_count = config_get_entry_count();
-	int selected_entry = 0;
-}
\ No newline at end of file
+	fw_console_set_cursor(0, config_get_entry_count() + 5);
+	if (seconds == 0) {
+		log("                                        ");
+	} else {
+		log("Booting the selected entry in %u second(s)... ", seconds);
+	}
+}
+
+struct config_entry *menu_main(void)
+{
+	uint32_t entry_count = config_get_entry_count();
+	uint32_t selected = config_get_default_index();
+	uint64_t remaining_ms = (uint64_t)config_get_timeout() * 1000;
+	bool countdown;
+	bool showing_history = false;
+	int staging;
+	int key;
+
+	// fast path: with no timeout and no key held, boot the default entry
+	// without touching the console at all
+	key = fw_read_key();
+	if (remaining_ms == 0 && key == KEY_NONE) {
+		return config_get_default_entry();
+	}
+
+	// any key held at entry stops the countdown
+	countdown = (key == KEY_NONE);
+
+	fw_console_init();
+	menu_draw(selected);
+	if (countdown) {
+		menu_draw_countdown(remaining_ms / 1000);
+	}
+
+	// read the default entry's files while waiting for the user
+	staging = loader_stage_begin(config_get_default_entry());
+
+	// without a timer the countdown can't expire, so don't wait at all
+	if (fw_timer_start(MENU_TICK_MS) != 0 && countdown) {
+		fw_console_clear();
+		return config_get_default_entry();
+	}
+
+	while (1) {
+		if (staging == 0) {
+			staging = loader_stage_step();
+		}
+		logring_drain(LOG_SINK_MASK(LogSinkSerial), MENU_LOG_BUDGET);
+
+		// only sleep once there's nothing left to stage
+		switch (fw_wait_event(staging != 0, &key)) {
+			case FwEventTimer:
+				if (countdown) {
+					remaining_ms = (remaining_ms > MENU_TICK_MS) ? remaining_ms - MENU_TICK_MS : 0;
+					if (remaining_ms % 1000 == 0) {
+						menu_draw_countdown(remaining_ms / 1000);
+					}
+				}
+				break;
+			case FwEventKey:
+				if (countdown) {
+					countdown = false;
+					menu_draw_countdown(0);
+				}
+
+				if (showing_history) {
+					showing_history = false;
+					menu_draw(selected);
+					key = KEY_NONE;
+				} else if (key == 'h' || key == 'H') {
+					showing_history = true;
+					menu_draw_history();
+				} else if (key == KEY_UP && selected > 0) {
+					selected--;
+					menu_draw(selected);
+				} else if (key == KEY_DOWN && selected + 1 < entry_count) {
+					selected++;
+					menu_draw(selected);
+				}
+				break;
+			default:
+				break;
+		}
+
+		if ((countdown && remaining_ms == 0) || key == KEY_ENTER) {
+			break;
+		}
+	}
+	fw_timer_stop();
+
+	// staged files are only useful if the default entry was picked
+	if (selected != config_get_default_index()) {
+		loader_stage_drop();
+	}
+
+	fw_console_clear();
+	return config_get_entry(selected);
+}
@@ -26,7 +26,7 @@
 #define NANOPRINTF_USE_WRITEBACK_FORMAT_SPECIFIERS 0
 #include <nanoprintf.h>
 
-#include <debug/serial.h>
+#include <lib/logring.h>
 #include <print.h>
 
 #include <stddef.h>
@@ -47,9 +47,12 @@ void log(const char *fmt, ...)
 	npf_vsnprintf(buf, sizeof(buf), fmt, args);
 	va_end(args);
 
-	printstr(buf);
+	// the user is probably waiting for this one
+	logring_write(LogLevelInfo, buf);
+	logring_drain(LOG_SINK_MASK(LogSinkConsole), 0);
 }
 
+#ifndef AXBOOT_TRACE
 void debug(const char *fmt, ...)
 {
 	va_list args;
@@ -59,6 +62,6 @@ void debug(const char *fmt, ...)
 	npf_vsnprintf(buf, sizeof(buf), fmt, args);
 	va_end(args);
 
-	serial_sendstr(buf);
+	logring_write(LogLevelDebug, buf);
 }
-
+#endif
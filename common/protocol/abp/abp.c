@@ -20,12 +20,23 @@
 #include <arch/cpu/cpu.h>
 #include <arch/mm/paging.h>
 #include <protocol/abp.h>
+#include <config/config.h>
 #include <loader/elf.h>
+#include <loader/loader.h>
 #include <firmware/hwmgmnt.h>
 #include <firmware/memmap.h>
 #include <firmware/handoff.h>
 #include <firmware/fb.h>
+#include <lib/acpi.h>
+#include <lib/arena.h>
+#include <lib/fbcon.h>
+#include <lib/history.h>
+#include <lib/logring.h>
+#include <lib/memstat.h>
+#include <lib/numa.h>
+#include <lib/splash.h>
 #include <lib/string.h>
+#include <lib/timestamp.h>
 #include <print.h>
 #include <axboot.h>
 
@@ -33,14 +44,30 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// The kernel's copy of the memory map lives in the handoff arena, one
+// array linked up as a list.
 static void translate_memory_map(struct memory_map_info *memmap, struct abp_memory_map **abp_memmap)
 {
-    struct abp_memory_map *current_entry = *abp_memmap;
-    current_entry = (struct abp_memory_map *)malloc(sizeof(struct abp_memory_map));
+    struct abp_memory_map *entries;
+
+    *abp_memmap = NULL;
+    if (memmap->entry_count == 0) {
+        return;
+    }
+
+    entries = arena_alloc(&g_handoff_arena, memmap->entry_count * sizeof(struct abp_memory_map));
+    if (entries == NULL) {
+        debug("ERROR: Couldn't allocate memory for the kernel's memory map\r\n");
+        return;
+    }
+
+    for (size_t i = 0; i < memmap->entry_count; i++) {
+        struct abp_memory_map *current_entry = &entries[i];
 
-    for (size_t i = 0; i <= memmap->entry_count; i++) {
         current_entry->base = memmap->entries[i].base;
         current_entry->length = memmap->entries[i].length;
+        current_entry->proximity = memmap->entries[i].proximity;
+        current_entry->flags = (memmap->entries[i].flags & MEMMAP_FLAG_MIRRORED) ? ABP_MEMORY_FLAG_MIRRORED : 0;
         
         switch (memmap->entries[i].type) {
             case MemoryMapUnusable:
@@ -62,35 +89,726 @@ static void translate_memory_map(struct memory_map_info *memmap, struct abp_memo
             case MemoryMapMmio:
                 current_entry->type = ABP_MEMORY_MMIO;
                 break;
+            case MemoryMapPersistent:
+                current_entry->type = ABP_MEMORY_PERSISTENT;
+                break;
+            case MemoryMapSpecificPurpose:
+                current_entry->type = ABP_MEMORY_SPECIFIC_PURPOSE;
+                break;
             default:
                 debug("Unknown memory type 0x%x\r\n", memmap->entries[i].type);
                 current_entry->type = ABP_MEMORY_RESERVED;
                 break;
         }
 
-        current_entry->next = (struct abp_memory_map *)malloc(sizeof(struct abp_memory_map));
-        current_entry = current_entry->next;
+        current_entry->next = (i + 1 < memmap->entry_count) ? &entries[i + 1] : NULL;
+    }
+
+    *abp_memmap = entries;
+}
+
+// allocating the reservations may split a descriptor or two
+#define ABP_MEMMAP_SLACK 8
+#define ABP_MEMMAP_TRIES 4
+
+// Nothing may ask the firmware for memory once the map is taken, or the
+// page tables and the kernel's copy of the map land in memory the map
+// calls usable. The NUMA split and the kernel's copy are the only things
+// sized by the map, so room for them is set aside and the map is taken
+// again if that room didn't turn out to be enough.
+static void abp_get_memory_map(struct memory_map_info *memmap)
+{
+    const struct numa_range *ranges = NULL;
+    uint32_t range_count = 0;
+    uint64_t entry_count = 0;
+    uint64_t split_count = 0;
+
+    if (numa_init() == 0) {
+        ranges = numa_get_ranges(&range_count);
+    }
+
+    for (int tries = 0; tries < ABP_MEMMAP_TRIES; tries++) {
+        uint64_t fw_calls;
+
+        free(memmap->entries);
+        memmap->entries = NULL;
+        memmap->entry_count = 0;
+
+        // the firmware's map and the split one both come from the loader arena
+        arena_reserve(&g_loader_arena, (entry_count + split_count + 2 * ABP_MEMMAP_SLACK) * sizeof(struct memory_map_entry));
+        fw_get_memory_map(memmap);
+        fw_calls = memstat_get_fw_calls();
+        entry_count = memmap->entry_count;
+
+        memmap_split_numa(memmap, ranges, range_count);
+        split_count = memmap->entry_count;
+        arena_reserve(&g_handoff_arena, split_count * sizeof(struct abp_memory_map));
+
+        if (memstat_get_fw_calls() == fw_calls) {
+            return;
+        }
+        debug("Memory map changed while it was being taken, retrying\r\n");
+    }
+
+    debug("WARNING: The memory map kept changing, the kernel may see stale usable memory\r\n");
+}
+
+static void abp_fill_tsc(struct abp_tsc_info *tsc)
+{
+    tsc->frequency = timestamp_get_frequency();
+    tsc->calibration_ns = timestamp_get_calibration_ns();
+    tsc->loader_entry = timestamp_get(TimestampLoaderEntry);
+    tsc->flags = timestamp_tsc_invariant() ? ABP_TSC_INVARIANT : 0;
+
+    switch (timestamp_get_source()) {
+        case TimestampSourceCpuid15:
+            tsc->source = ABP_TSC_SOURCE_CPUID_15H;
+            break;
+        case TimestampSourceCpuid16:
+            tsc->source = ABP_TSC_SOURCE_CPUID_16H;
+            break;
+        case TimestampSourceHpet:
+            tsc->source = ABP_TSC_SOURCE_HPET;
+            break;
+        case TimestampSourcePmTimer:
+            tsc->source = ABP_TSC_SOURCE_PM_TIMER;
+            break;
+        case TimestampSourceFirmware:
+            tsc->source = ABP_TSC_SOURCE_FIRMWARE;
+            break;
+        default:
+            tsc->source = ABP_TSC_SOURCE_UNKNOWN;
+            break;
+    }
+
+    debug("TSC: %llu Hz (source %u, measured for %llu ns)%s\r\n", tsc->frequency, tsc->source,
+          tsc->calibration_ns, (tsc->flags & ABP_TSC_INVARIANT) ? ", invariant" : "");
+}
+
+static void abp_fill_timeline(struct abp_boot_timeline *timeline)
+{
+    struct fw_boot_performance perf;
+    int64_t offset = 0;
+
+    timeline->tsc_frequency = timestamp_get_frequency();
+    timeline->firmware_valid = fw_get_boot_performance(&perf);
+
+    uint64_t loader_entry = timestamp_to_ns(timestamp_get(TimestampLoaderEntry));
+    uint64_t ebs_entry = timestamp_to_ns(timestamp_get(TimestampExitBootServicesEntry));
+    uint64_t ebs_exit = timestamp_to_ns(timestamp_get(TimestampExitBootServicesExit));
+
+    // the firmware's timer usually is the TSC, but if both sides saw
+    // ExitBootServices() use that to line the two clocks up
+    if (perf.exit_boot_services_entry != 0 && ebs_entry != 0) {
+        offset = (int64_t)(perf.exit_boot_services_entry - ebs_entry);
+    }
+
+#define ALIGN_NS(ns) ((ns) != 0 ? (uint64_t)((int64_t)(ns) + offset) : 0)
+
+    timeline->reset_end = perf.reset_end;
+    timeline->os_loader_load_image_start = perf.os_loader_load_image_start;
+    timeline->os_loader_start_image_start = perf.os_loader_start_image_start != 0 ? perf.os_loader_start_image_start : ALIGN_NS(loader_entry);
+    timeline->exit_boot_services_entry = perf.exit_boot_services_entry != 0 ? perf.exit_boot_services_entry : ALIGN_NS(ebs_entry);
+    timeline->exit_boot_services_exit = perf.exit_boot_services_exit != 0 ? perf.exit_boot_services_exit : ALIGN_NS(ebs_exit);
+
+    timeline->loader_entry = ALIGN_NS(loader_entry);
+    timeline->config_loaded = ALIGN_NS(timestamp_to_ns(timestamp_get(TimestampConfigLoaded)));
+    timeline->menu_done = ALIGN_NS(timestamp_to_ns(timestamp_get(TimestampMenuDone)));
+    timeline->kernel_loaded = ALIGN_NS(timestamp_to_ns(timestamp_get(TimestampKernelLoaded)));
+    timeline->paging_done = ALIGN_NS(timestamp_to_ns(timestamp_get(TimestampPagingDone)));
+    timeline->handoff = ALIGN_NS(timestamp_to_ns(timestamp_get(TimestampHandoff)));
+
+#undef ALIGN_NS
+
+    // let the OS see the loader's part through the FPDT as well
+    if (timeline->firmware_valid) {
+        perf.os_loader_start_image_start = timeline->os_loader_start_image_start;
+        perf.exit_boot_services_entry = timeline->exit_boot_services_entry;
+        perf.exit_boot_services_exit = timeline->exit_boot_services_exit;
+        fw_publish_boot_performance(&perf);
+    }
+
+    debug("Boot timeline (ns): reset_end=%llu load_image=%llu start_image=%llu loader_entry=%llu "
+          "kernel_loaded=%llu ebs_entry=%llu ebs_exit=%llu handoff=%llu\r\n",
+          timeline->reset_end, timeline->os_loader_load_image_start, timeline->os_loader_start_image_start,
+          timeline->loader_entry, timeline->kernel_loaded, timeline->exit_boot_services_entry,
+          timeline->exit_boot_services_exit, timeline->handoff);
+}
+
+static uint32_t abp_elapsed_us(uint64_t start, uint64_t end)
+{
+    if (start == 0 || end == 0 || end < start) {
+        return 0;
+    }
+
+    return timestamp_to_ns(end - start) / 1000;
+}
+
+// Must run before the memory map is taken, the history lives in a firmware
+// variable; prepare_us covers the work up to that point
+static void abp_record_history(struct abp_boot_history *abp_history, size_t kernel_size, struct loader_file *modules, uint32_t module_count)
+{
+    struct history_record record;
+    uint64_t now = rdtsc();
+
+    memset(&record, 0, sizeof(struct history_record));
+    record.firmware_us = timestamp_to_ns(timestamp_get(TimestampLoaderEntry)) / 1000;
+    record.config_us = abp_elapsed_us(timestamp_get(TimestampLoaderEntry), timestamp_get(TimestampConfigLoaded));
+    record.menu_us = abp_elapsed_us(timestamp_get(TimestampConfigLoaded), timestamp_get(TimestampMenuDone));
+    record.load_us = abp_elapsed_us(timestamp_get(TimestampMenuDone), timestamp_get(TimestampKernelLoaded));
+    record.prepare_us = abp_elapsed_us(timestamp_get(TimestampKernelLoaded), now);
+    record.total_us = timestamp_to_ns(now) / 1000;
+    record.kernel_size = kernel_size;
+    for (uint32_t i = 0; i < module_count; i++) {
+        record.modules_size += modules[i].size;
+    }
+
+    history_record(&record);
+
+    abp_history->count = history_get_count();
+    for (uint32_t i = 0; i < abp_history->count && i < ABP_BOOT_HISTORY_MAX; i++) {
+        const struct history_record *entry = history_get(i);
+        struct abp_boot_history_entry *abp_entry = &abp_history->entries[i];
+
+        abp_entry->firmware_us = entry->firmware_us;
+        abp_entry->config_us = entry->config_us;
+        abp_entry->menu_us = entry->menu_us;
+        abp_entry->load_us = entry->load_us;
+        abp_entry->prepare_us = entry->prepare_us;
+        abp_entry->total_us = entry->total_us;
+        abp_entry->kernel_size = entry->kernel_size;
+        abp_entry->modules_size = entry->modules_size;
+    }
+}
+
+static void abp_copy_usage(struct abp_memory_usage *usage, int category)
+{
+    const struct memstat_category *cat = memstat_get(category);
+
+    usage->count = cat->count;
+    usage->bytes = cat->bytes;
+    usage->peak_bytes = cat->peak;
+}
+
+static void abp_fill_memory_stats(struct abp_memory_stats *stats)
+{
+    struct paging_stats paging;
+
+    abp_copy_usage(&stats->page_tables, MemStatPageTables);
+    abp_copy_usage(&stats->kernel, MemStatKernel);
+    abp_copy_usage(&stats->modules, MemStatModules);
+    abp_copy_usage(&stats->boot_info, MemStatBootInfo);
+    abp_copy_usage(&stats->stack, MemStatStack);
+    abp_copy_usage(&stats->transient, MemStatTransient);
+
+    paging_get_stats(&paging);
+    for (int i = 0; i < 4; i++) {
+        stats->page_tables_per_level[i] = paging.tables[i];
+    }
+    stats->identity_map_tables = paging.identity_tables;
+    stats->hhdm_tables = paging.hhdm_tables;
+
+    stats->peak_bytes = memstat_get_peak();
+    stats->firmware_calls = memstat_get_fw_calls();
+}
+
+static char *abp_strdup(const char *str)
+{
+    char *copy = arena_alloc(&g_handoff_arena, strlen(str) + 1);
+
+    if (copy != NULL) {
+        strcpy(copy, str);
+    }
+    return copy;
+}
+
+struct abp_requests {
+    uint64_t hhdm_base;
+    uint64_t stack_size;
+    uint32_t paging;
+
+    bool framebuffer;
+    uint32_t fb_width;
+    uint32_t fb_height;
+
+    bool acpi;
+    bool smbios;
+    bool modules;
+    bool smp;
+    uint64_t smp_stack_size;
+};
+
+#define ABP_DEFAULT_STACK_SIZE (16 * PAGE_SIZE)
+
+static bool abp_copy_request(void *dest, size_t size, void *desc, uint32_t descsz)
+{
+    if (descsz < size) {
+        debug("ERROR: Kernel request is too small (%u < %u bytes)\r\n", descsz, size);
+        return false;
+    }
+
+    memcpy(dest, desc, size);
+    return true;
+}
+
+static void abp_parse_request(uint32_t type, void *desc, uint32_t descsz, void *ctx)
+{
+    struct abp_requests *requests = (struct abp_requests *)ctx;
+
+    switch (type) {
+        case ABP_REQUEST_HHDM: {
+            struct abp_hhdm_request hhdm;
+            if (abp_copy_request(&hhdm, sizeof(hhdm), desc, descsz)) {
+                requests->hhdm_base = ROUND_DOWN(hhdm.base, PAGE_SIZE);
+            }
+            break;
+        }
+        case ABP_REQUEST_STACK: {
+            struct abp_stack_request stack;
+            if (abp_copy_request(&stack, sizeof(stack), desc, descsz)) {
+                requests->stack_size = ROUND_UP(stack.size, PAGE_SIZE);
+            }
+            break;
+        }
+        case ABP_REQUEST_FRAMEBUFFER: {
+            struct abp_framebuffer_request fb;
+            if (abp_copy_request(&fb, sizeof(fb), desc, descsz)) {
+                requests->framebuffer = true;
+                requests->fb_width = fb.width;
+                requests->fb_height = fb.height;
+            }
+            break;
+        }
+        case ABP_REQUEST_SMP: {
+            struct abp_smp_request smp = {0};
+            // kernels built before stack_size only pass the flags
+            memcpy(&smp, desc, (descsz < sizeof(smp)) ? descsz : sizeof(smp));
+            requests->smp = true;
+            requests->smp_stack_size = ROUND_UP(smp.stack_size, PAGE_SIZE);
+            break;
+        }
+        case ABP_REQUEST_MODULES:
+            requests->modules = true;
+            break;
+        case ABP_REQUEST_PAGING: {
+            struct abp_paging_request paging;
+            if (abp_copy_request(&paging, sizeof(paging), desc, descsz)) {
+                requests->paging = paging.flags;
+            }
+            break;
+        }
+        case ABP_REQUEST_ACPI:
+            requests->acpi = true;
+            break;
+        case ABP_REQUEST_SMBIOS:
+            requests->smbios = true;
+            break;
+        default:
+            debug("Unknown kernel request 0x%x, ignoring\r\n", type);
+            break;
+    }
+}
+
+static void abp_get_requests(void *kernel, size_t kernel_size, struct abp_requests *requests)
+{
+    memset(requests, 0, sizeof(struct abp_requests));
+    requests->stack_size = ABP_DEFAULT_STACK_SIZE;
+
+    if (elf_parse_notes(kernel, kernel_size, ABP_NOTE_NAME, abp_parse_request, requests) > 0) {
+        debug("Kernel requests: hhdm=0x%llx stack=%llu fb=%u (%ux%u) acpi=%u smbios=%u modules=%u smp=%u paging=0x%x\r\n",
+              requests->hhdm_base, requests->stack_size, requests->framebuffer, requests->fb_width, requests->fb_height,
+              requests->acpi, requests->smbios, requests->modules, requests->smp, requests->paging);
+    } else {
+        // the kernel didn't declare anything, so give it everything
+        requests->hhdm_base = HHDM_DEFAULT_BASE;
+        requests->framebuffer = true;
+        requests->acpi = true;
+        requests->smbios = true;
+        requests->modules = true;
+    }
+
+    if (requests->stack_size == 0 || requests->stack_size / PAGE_SIZE > UINT16_MAX) {
+        debug("Invalid kernel stack size %llu, using the default\r\n", requests->stack_size);
+        requests->stack_size = ABP_DEFAULT_STACK_SIZE;
     }
 
-    current_entry->next = NULL;
+    if (requests->paging & ABP_PAGING_LVL5) {
+        debug("5-level paging was requested but is not supported yet, using 4-level paging\r\n");
+    }
 }
 
-void abp_load(void *kernel, size_t kernel_size)
+static void *abp_alloc_array(uint32_t count, size_t size)
+{
+    if (count == 0) {
+        return NULL;
+    }
+
+    return arena_alloc(&g_handoff_arena, count * size);
+}
+
+static void abp_fill_madt(struct abp_acpi_directory *dir, struct acpi_madt *madt)
+{
+    uint8_t *start = (uint8_t *)madt + sizeof(struct acpi_madt);
+    uint8_t *end = (uint8_t *)madt + madt->header.length;
+    uint32_t cpus = 0, ioapics = 0, overrides = 0, nmis = 0;
+
+    dir->madt_flags = madt->flags;
+    dir->lapic_address = madt->lapic_address;
+
+    // count first, so every list is a single allocation
+    for (uint8_t *p = start; p + sizeof(struct acpi_madt_entry) <= end; p += ((struct acpi_madt_entry *)p)->length) {
+        struct acpi_madt_entry *entry = (struct acpi_madt_entry *)p;
+        if (entry->length < sizeof(struct acpi_madt_entry) || p + entry->length > end) {
+            debug("MADT entry at 0x%llx is malformed, stopping\r\n", p);
+            end = p;
+            break;
+        }
+
+        switch (entry->type) {
+            case AcpiMadtLapic:
+            case AcpiMadtX2apic:
+                cpus++;
+                break;
+            case AcpiMadtIoapic:
+                ioapics++;
+                break;
+            case AcpiMadtInterruptOverride:
+                overrides++;
+                break;
+            case AcpiMadtLapicNmi:
+            case AcpiMadtX2apicNmi:
+                nmis++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    dir->cpus = abp_alloc_array(cpus, sizeof(struct abp_cpu));
+    dir->ioapics = abp_alloc_array(ioapics, sizeof(struct abp_ioapic));
+    dir->irq_overrides = abp_alloc_array(overrides, sizeof(struct abp_irq_override));
+    dir->lapic_nmis = abp_alloc_array(nmis, sizeof(struct abp_lapic_nmi));
+
+    for (uint8_t *p = start; p < end; p += ((struct acpi_madt_entry *)p)->length) {
+        struct acpi_madt_entry *entry = (struct acpi_madt_entry *)p;
+
+        if (entry->type == AcpiMadtLapic && entry->length >= sizeof(struct acpi_madt_lapic) && dir->cpus != NULL) {
+            struct acpi_madt_lapic *lapic = (struct acpi_madt_lapic *)entry;
+            // neither enabled nor able to come online, it's just a placeholder
+            if (!(lapic->flags & (ACPI_LAPIC_ENABLED | ACPI_LAPIC_ONLINE_CAPABLE))) {
+                continue;
+            }
+            struct abp_cpu *cpu = &dir->cpus[dir->cpu_count++];
+            cpu->apic_id = lapic->apic_id;
+            cpu->acpi_uid = lapic->acpi_uid;
+            cpu->flags = lapic->flags & (ABP_CPU_ENABLED | ABP_CPU_ONLINE_CAPABLE);
+            cpu->proximity = numa_get_cpu_proximity(cpu->apic_id);
+        } else if (entry->type == AcpiMadtX2apic && entry->length >= sizeof(struct acpi_madt_x2apic) && dir->cpus != NULL) {
+            struct acpi_madt_x2apic *x2apic = (struct acpi_madt_x2apic *)entry;
+            if (!(x2apic->flags & (ACPI_LAPIC_ENABLED | ACPI_LAPIC_ONLINE_CAPABLE))) {
+                continue;
+            }
+            struct abp_cpu *cpu = &dir->cpus[dir->cpu_count++];
+            cpu->apic_id = x2apic->x2apic_id;
+            cpu->acpi_uid = x2apic->acpi_uid;
+            cpu->flags = (x2apic->flags & (ABP_CPU_ENABLED | ABP_CPU_ONLINE_CAPABLE)) | ABP_CPU_X2APIC;
+            cpu->proximity = numa_get_cpu_proximity(cpu->apic_id);
+        } else if (entry->type == AcpiMadtIoapic && entry->length >= sizeof(struct acpi_madt_ioapic) && dir->ioapics != NULL) {
+            struct acpi_madt_ioapic *ioapic = (struct acpi_madt_ioapic *)entry;
+            struct abp_ioapic *out = &dir->ioapics[dir->ioapic_count++];
+            out->id = ioapic->id;
+            out->gsi_base = ioapic->gsi_base;
+            out->address = ioapic->address;
+        } else if (entry->type == AcpiMadtInterruptOverride && entry->length >= sizeof(struct acpi_madt_override) && dir->irq_overrides != NULL) {
+            struct acpi_madt_override *override = (struct acpi_madt_override *)entry;
+            struct abp_irq_override *out = &dir->irq_overrides[dir->irq_override_count++];
+            out->bus = override->bus;
+            out->source = override->source;
+            out->flags = override->flags;
+            out->gsi = override->gsi;
+        } else if (entry->type == AcpiMadtLapicNmi && entry->length >= sizeof(struct acpi_madt_lapic_nmi) && dir->lapic_nmis != NULL) {
+            struct acpi_madt_lapic_nmi *nmi = (struct acpi_madt_lapic_nmi *)entry;
+            struct abp_lapic_nmi *out = &dir->lapic_nmis[dir->lapic_nmi_count++];
+            out->acpi_uid = (nmi->acpi_uid == 0xff) ? 0xffffffff : nmi->acpi_uid;
+            out->flags = nmi->flags;
+            out->lint = nmi->lint;
+        } else if (entry->type == AcpiMadtX2apicNmi && entry->length >= sizeof(struct acpi_madt_x2apic_nmi) && dir->lapic_nmis != NULL) {
+            struct acpi_madt_x2apic_nmi *nmi = (struct acpi_madt_x2apic_nmi *)entry;
+            struct abp_lapic_nmi *out = &dir->lapic_nmis[dir->lapic_nmi_count++];
+            out->acpi_uid = nmi->acpi_uid;
+            out->flags = nmi->flags;
+            out->lint = nmi->lint;
+        } else if (entry->type == AcpiMadtLapicAddressOverride && entry->length >= sizeof(struct acpi_madt_lapic_address)) {
+            dir->lapic_address = ((struct acpi_madt_lapic_address *)entry)->address;
+        }
+    }
+
+    debug("MADT: %u CPUs, %u I/O APICs, %u overrides, %u NMIs, LAPIC at 0x%llx\r\n",
+          dir->cpu_count, dir->ioapic_count, dir->irq_override_count, dir->lapic_nmi_count, dir->lapic_address);
+}
+
+static void abp_fill_mcfg(struct abp_acpi_directory *dir, struct acpi_mcfg *mcfg)
+{
+    uint32_t count = (mcfg->header.length - sizeof(struct acpi_mcfg)) / sizeof(struct acpi_mcfg_segment);
+
+    dir->pci_segments = abp_alloc_array(count, sizeof(struct abp_pci_segment));
+    if (dir->pci_segments == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        dir->pci_segments[i].base = mcfg->segments[i].base;
+        dir->pci_segments[i].segment = mcfg->segments[i].segment;
+        dir->pci_segments[i].bus_start = mcfg->segments[i].bus_start;
+        dir->pci_segments[i].bus_end = mcfg->segments[i].bus_end;
+    }
+    dir->pci_segment_count = count;
+}
+
+static void abp_fill_acpi_directory(struct abp_acpi_directory *dir, void *rsdp)
+{
+    const struct acpi_table_entry *tables;
+    uint32_t count;
+
+    if (acpi_init(rsdp) != 0) {
+        return;
+    }
+
+    tables = acpi_get_directory(&count);
+    dir->tables = abp_alloc_array(count, sizeof(struct abp_acpi_table));
+    if (dir->tables != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(dir->tables[i].signature, (void *)tables[i].signature, 4);
+            dir->tables[i].length = tables[i].length;
+            dir->tables[i].address = tables[i].address;
+        }
+        dir->table_count = count;
+    }
+
+    struct acpi_madt *madt = acpi_find_table("APIC");
+    if (madt != NULL && madt->header.length >= sizeof(struct acpi_madt)) {
+        abp_fill_madt(dir, madt);
+    }
+
+    struct acpi_mcfg *mcfg = acpi_find_table("MCFG");
+    if (mcfg != NULL && mcfg->header.length >= sizeof(struct acpi_mcfg)) {
+        abp_fill_mcfg(dir, mcfg);
+    }
+
+    struct acpi_hpet *hpet = acpi_find_table("HPET");
+    if (hpet != NULL && hpet->header.length >= sizeof(struct acpi_hpet) &&
+        hpet->base_address.address_space == ACPI_GAS_SYSTEM_MEMORY) {
+        dir->hpet_address = hpet->base_address.address;
+    }
+}
+
+static void abp_fill_numa(struct abp_numa_info *info)
+{
+    const uint8_t *distances;
+
+    info->bsp_proximity = numa_get_bsp_proximity();
+
+    distances = numa_get_distances(&info->locality_count);
+    if (distances == NULL || info->locality_count == 0) {
+        info->locality_count = 0;
+        return;
+    }
+
+    // the SLIT sits in ACPI reclaimable memory, give the kernel its own copy
+    info->distances = arena_alloc(&g_handoff_arena, info->locality_count * info->locality_count);
+    if (info->distances == NULL) {
+        info->locality_count = 0;
+        return;
+    }
+    memcpy(info->distances, (void *)distances, info->locality_count * info->locality_count);
+}
+
+static void abp_fill_firmware_tables(struct abp_firmware_tables *tables, const struct abp_requests *requests)
+{
+    if (requests->acpi) {
+        tables->acpi_rsdp = fw_get_acpi_rsdp();
+        tables->acpi10_rsdp = fw_get_config_table(FwTableAcpi10);
+    }
+
+    if (requests->smbios) {
+        tables->smbios_entry_point = fw_get_smbios_entry_point();
+        tables->smbios2_entry_point = fw_get_config_table(FwTableSmbios);
+        tables->smbios3_entry_point = fw_get_config_table(FwTableSmbios3);
+    }
+
+    tables->dtb = fw_get_config_table(FwTableDtb);
+    tables->esrt = fw_get_config_table(FwTableEsrt);
+    tables->memory_attributes = fw_get_config_table(FwTableMemoryAttributes);
+    tables->rng_seed = fw_get_config_table(FwTableRngSeed);
+}
+
+// the firmware layer reports 1 for RGBA and 2 for BGRA
+static uint8_t abp_pixel_format(uint8_t format)
+{
+    return (format == 1) ? AbpFramebufferRgba : AbpFramebufferBgra;
+}
+
+static void abp_fill_video_modes(struct abp_video_modes *video_modes)
+{
+    uint32_t count;
+    uint32_t current;
+    const struct fw_video_mode *modes = fw_get_fb_modes(&count, &current);
+
+    video_modes->modes = arena_alloc(&g_handoff_arena, count * sizeof(struct abp_video_mode));
+    if (video_modes->modes == NULL) {
+        debug("ERROR: Failed to allocate the video mode list\r\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        video_modes->modes[i].width = modes[i].width;
+        video_modes->modes[i].height = modes[i].height;
+        video_modes->modes[i].pitch = modes[i].pitch;
+        video_modes->modes[i].bpp = modes[i].bpp;
+        video_modes->modes[i].pixel_format = abp_pixel_format(modes[i].pixel_format);
+    }
+    video_modes->count = count;
+    video_modes->current = current;
+}
+
+static void abp_fill_modules(struct abp_boot_info *boot_info, struct loader_file *modules, uint32_t module_count)
+{
+    size_t array_size = module_count * sizeof(struct abp_module);
+    size_t strings_size = 0;
+    char *strings;
+
+    for (uint32_t i = 0; i < module_count; i++) {
+        strings_size += strlen(modules[i].path) + 1;
+    }
+
+    // module descriptors and their paths share one allocation
+    boot_info->modules = arena_alloc(&g_handoff_arena, array_size + strings_size);
+    if (boot_info->modules == NULL) {
+        debug("ERROR: Couldn't allocate memory for module descriptors\r\n");
+        return;
+    }
+
+    strings = (char *)boot_info->modules + array_size;
+    for (uint32_t i = 0; i < module_count; i++) {
+        struct abp_module *module = &boot_info->modules[i];
+
+        module->base = modules[i].buffer;
+        module->size = modules[i].size;
+        module->path = strcpy(strings, modules[i].path);
+        strings += strlen(modules[i].path) + 1;
+    }
+
+    boot_info->module_count = module_count;
+}
+
+void abp_load(void *kernel, size_t kernel_size, struct loader_file *modules, uint32_t module_count)
 {
     bool higher_half = false;
     void *kernel_entry;
+    struct abp_requests requests;
+    struct abp_boot_info boot_info = {0};
+    uint32_t page_sizes = 0;
+
+    // find out what the kernel actually wants before doing any work
+    abp_get_requests(kernel, kernel_size, &requests);
+
+    // set up the framebuffer first, a modeset may change the memory map
+    if (requests.framebuffer && fw_initialize_fb() != 0) {
+        debug("No valid framebuffer was found!\r\n");
+        requests.framebuffer = false;
+    }
+
+    if (requests.framebuffer) {
+        // a VIDEO_MODE policy in the config wins over the kernel's wishes
+        if (requests.fb_width != 0 && requests.fb_height != 0 && config_get_video_mode() == ConfigVideoFirmware) {
+            // the framebuffer console was laid out for the old mode
+            fbcon_release();
+            fw_set_fb_resolution(requests.fb_width, requests.fb_height);
+        }
+
+        // only entries that keep a framebuffer get a splash, in the final mode
+        splash_show(config_get_splash_path());
+
+        fw_get_framebuffer(&boot_info.framebuffer.addr, &boot_info.framebuffer.width, &boot_info.framebuffer.height, &boot_info.framebuffer.bpp, &boot_info.framebuffer.pixel_format);
+        boot_info.framebuffer.pixel_format = abp_pixel_format(boot_info.framebuffer.pixel_format);
+        boot_info.framebuffer.pitch = fw_get_fb_pitch();
+    }
+
+    // AP mailboxes and stacks have to be allocated before the memory map is taken
+    if (requests.smp && abp_smp_prepare(&boot_info.smp, requests.smp_stack_size) != 0) {
+        debug("SMP: leaving the APs for the kernel to start\r\n");
+    }
+
+    // everything that goes into the handoff arena is built before the
+    // memory map is taken, only the kernel's copy of the map comes later
+    boot_info.bootloader_name = abp_strdup(BOOTLOADER_NAME_STR);
+    boot_info.bootloader_version = abp_strdup(BOOTLOADER_VERSION_STR);
+    boot_info.protocol_version = abp_strdup(AXBOOT_PROTOCOL_VERSION_STR);
+
+    // CPU proximity domains end up in the ACPI directory; keep page
+    // tables and the stack local
+    if (numa_init() == 0) {
+        paging_set_preferred_proximity(numa_get_bsp_proximity());
+    }
+    abp_fill_numa(&boot_info.numa);
+
+    // get ACPI and SMBIOS info
+    if (requests.acpi) {
+        boot_info.acpi.rsdp = fw_get_acpi_rsdp();
+        if (boot_info.acpi.rsdp != NULL) {
+            boot_info.acpi.is_valid = 1;
+            abp_fill_acpi_directory(&boot_info.acpi_directory, boot_info.acpi.rsdp);
+        }
+    }
+
+    if (requests.smbios) {
+        boot_info.smbios.entry_point = fw_get_smbios_entry_point();
+        if (boot_info.smbios.entry_point != NULL) {
+            boot_info.smbios.is_valid = 1;
+        }
+    }
+
+    abp_fill_firmware_tables(&boot_info.firmware_tables, &requests);
+
+    if (requests.framebuffer) {
+        abp_fill_video_modes(&boot_info.video_modes);
+    }
+
+    if (requests.modules && module_count > 0) {
+        abp_fill_modules(&boot_info, modules, module_count);
+    }
+
+    // these need firmware services, and writing the history variable may
+    // allocate, so take care of them before the memory map is taken
+    timestamp_calibrate();
+    abp_fill_tsc(&boot_info.tsc);
+    fw_boot_performance_init();
+    abp_record_history(&boot_info.history, kernel_size, modules, module_count);
 
     // acquire memory map and initialize paging
     struct memory_map_info memmap = {0};
-    fw_get_memory_map(&memmap);
+    fw_reserve_exit_map();
+    abp_get_memory_map(&memmap);
+    uint64_t handoff_chunks = g_handoff_arena.chunk_count;
+
     memmap_dump(&memmap);
 
-    if (paging_init(&memmap) != 0) {
+    if (requests.paging & ABP_PAGING_2M) {
+        page_sizes |= PAGING_PAGE_2M;
+    }
+    if (requests.paging & ABP_PAGING_1G) {
+        page_sizes |= PAGING_PAGE_1G;
+    }
+
+    if (paging_init(&memmap, requests.hhdm_base, page_sizes) != 0) {
         log("ERROR: Couldn't set up paging!\r\n");
+        logring_drain(LOG_SINKS_ALL, 0);
         while(1);
     }
+    timestamp_record(TimestampPagingDone);
 
-    struct abp_boot_info boot_info = {0};
+    // set if any mapping below ran out of memory for page tables
+    int map_status = 0;
 
     debug("kernel buffer: 0x%llx\r\n", kernel);
 
@@ -102,74 +820,118 @@ void abp_load(void *kernel, size_t kernel_size)
     // remap kernel to higher half if desired
     debug("kernel size: %u (%u pages)\r\n", kernel_size, (kernel_size + (PAGE_SIZE - 1)) / PAGE_SIZE);
     for (uint64_t i = 0; i < (kernel_size + (PAGE_SIZE - 1)) / PAGE_SIZE; i++) {
-        paging_identity_map((uint64_t)kernel + (i * PAGE_SIZE));
-        paging_map((uint64_t)kernel + (i * PAGE_SIZE), HIGHER_HALF + (i * PAGE_SIZE));
+        map_status |= paging_identity_map((uint64_t)kernel + (i * PAGE_SIZE));
+        map_status |= paging_map((uint64_t)kernel + (i * PAGE_SIZE), HIGHER_HALF + (i * PAGE_SIZE));
     }
 
     kernel_entry += HIGHER_HALF;
 
-    // set up basic boot information
-    boot_info.bootloader_name = paging_allocate((strlen(BOOTLOADER_NAME_STR) + PAGE_SIZE - 1) / PAGE_SIZE);
-    boot_info.bootloader_version = paging_allocate((strlen(BOOTLOADER_VERSION_STR) + PAGE_SIZE - 1) / PAGE_SIZE);
-    boot_info.protocol_version = paging_allocate((strlen(AXBOOT_PROTOCOL_VERSION_STR) + PAGE_SIZE - 1) / PAGE_SIZE);
-    strcpy(boot_info.bootloader_name, BOOTLOADER_NAME_STR);
-    strcpy(boot_info.bootloader_version, BOOTLOADER_VERSION_STR);
-    strcpy(boot_info.protocol_version, AXBOOT_PROTOCOL_VERSION_STR);
+    if (requests.framebuffer) {
+        // identity map the framebuffer
+        uint64_t framebuffer_size = (uint64_t)boot_info.framebuffer.pitch * boot_info.framebuffer.height;
+        debug("Identity mapping the framebuffer...\r\n");
+        map_status |= paging_map_range((uint64_t)boot_info.framebuffer.addr, (uint64_t)boot_info.framebuffer.addr, framebuffer_size);
 
-    // get ACPI and SMBIOS info
-    boot_info.acpi.rsdp = fw_get_acpi_rsdp();
-    if (boot_info.acpi.rsdp != NULL) {
-        boot_info.acpi.is_valid = 1;
+        debug("Framebuffer info:\r\n");
+        debug("- Address: 0x%llx\r\n", boot_info.framebuffer.addr);
+        debug("- Width: %u\r\n", boot_info.framebuffer.width);
+        debug("- Height: %u\r\n", boot_info.framebuffer.height);
+        debug("- Pitch: %u\r\n", boot_info.framebuffer.pitch);
+        debug("- Bits per pixel: %u\r\n", boot_info.framebuffer.bpp);
+        debug("- Pixel Format: %s\r\n", boot_info.framebuffer.pixel_format == AbpFramebufferRgba ? "RGBA" : "BGRA");
     }
 
-    boot_info.smbios.entry_point = fw_get_smbios_entry_point();
-    if (boot_info.smbios.entry_point != NULL) {
-        boot_info.smbios.is_valid = 1;
-    }
+    for (uint32_t i = 0; i < boot_info.module_count; i++) {
+        struct abp_module *module = &boot_info.modules[i];
 
-    // get framebuffer info
-    fw_get_framebuffer(&boot_info.framebuffer.addr, &boot_info.framebuffer.width, &boot_info.framebuffer.height, &boot_info.framebuffer.bpp, &boot_info.framebuffer.pixel_format);
-    if (boot_info.framebuffer.pixel_format == 1) {
-        boot_info.framebuffer.pixel_format = AbpFramebufferRgba;
-    } else if (boot_info.framebuffer.pixel_format == 2) {
-        boot_info.framebuffer.pixel_format = AbpFramebufferBgra;
+        map_status |= paging_map_range((uint64_t)module->base, (uint64_t)module->base, module->size);
+        debug("Module '%s' at 0x%llx (%llu bytes)\r\n", module->path, module->base, module->size);
     }
 
-    // identity map the framebuffer
-    uint64_t framebuffer_size = boot_info.framebuffer.width * boot_info.framebuffer.height * (boot_info.framebuffer.bpp >> 3);
-    debug("Identity mapping the framebuffer...\r\n");
-    for (uint64_t i = 0; i < (framebuffer_size + (PAGE_SIZE - 1)) / PAGE_SIZE; i++) {
-        paging_identity_map((uint64_t)boot_info.framebuffer.addr + (i * PAGE_SIZE));
+    // create a new stack for the kernel
+    uint64_t stack_pages = requests.stack_size / PAGE_SIZE;
+    void *kernel_stack = paging_allocate(stack_pages);
+    if (kernel_stack == NULL) {
+        log("ERROR: Couldn't allocate a %llu page kernel stack!\r\n", stack_pages);
+        logring_drain(LOG_SINKS_ALL, 0);
+        while(1);
     }
+    memstat_alloc(MemStatStack, stack_pages * PAGE_SIZE);
+    memset(kernel_stack, 0, (stack_pages * PAGE_SIZE));
+    debug("Created new stack at 0x%lx (%llu pages)\r\n", kernel_stack, stack_pages);
 
-    debug("Framebuffer info:\r\n");
-    debug("- Address: 0x%llx\r\n", boot_info.framebuffer.addr);
-    debug("- Width: %u\r\n", boot_info.framebuffer.width);
-    debug("- Height: %u\r\n", boot_info.framebuffer.height);
-    debug("- Bits per pixel: %u\r\n", boot_info.framebuffer.bpp);
-    debug("- Pixel Format: %s\r\n", boot_info.framebuffer.pixel_format == AbpFramebufferRgba ? "RGBA" : "BGRA");
-    
-    // create a new 64 KB stack for the kernel
-    void *kernel_stack = paging_allocate(16);
-    memset(kernel_stack, 0, (16 * PAGE_SIZE));
-    debug("Created new stack at 0x%lx\r\n", kernel_stack);
-
-    for (uint64_t i = 0; i < 16; i++) {
-        paging_identity_map((uint64_t)kernel_stack + (i * PAGE_SIZE));
-    }
+    map_status |= paging_map_range((uint64_t)kernel_stack, (uint64_t)kernel_stack, stack_pages * PAGE_SIZE);
+    map_status |= abp_smp_map(&boot_info.smp);
 
     // map boot info
     for (uint64_t i = 0; i < (sizeof(struct abp_boot_info) + PAGE_SIZE - 1) / PAGE_SIZE; i++) {
-        paging_identity_map((uint64_t)&boot_info + (i * PAGE_SIZE));
+        map_status |= paging_identity_map((uint64_t)&boot_info + (i * PAGE_SIZE));
     }
 
     // set memory map
     translate_memory_map(&memmap, &boot_info.memmap);
+    if (g_handoff_arena.chunk_count != handoff_chunks) {
+        debug("ERROR: The handoff arena grew after the memory map was taken\r\n");
+    }
     boot_info.lvl5_paging = 0;
+    boot_info.hhdm_base = requests.hhdm_base;
+
+    // anything in the handoff arena may be referenced by the kernel
+    for (struct arena_chunk *chunk = g_handoff_arena.head; chunk != NULL; chunk = chunk->next) {
+        map_status |= paging_map_range((uint64_t)chunk, (uint64_t)chunk, chunk->size);
+    }
+
+    const struct log_ring *ring = logring_get();
+    if (ring->buffer != NULL) {
+        map_status |= paging_map_range((uint64_t)ring->buffer, (uint64_t)ring->buffer, ring->size);
+    }
+
+    // the kernel would fault on whatever didn't get mapped
+    if (map_status != 0) {
+        log("ERROR: Ran out of memory for the kernel's page tables!\r\n");
+        logring_drain(LOG_SINKS_ALL, 0);
+        while(1);
+    }
+
+    arena_dump(&g_loader_arena);
+    arena_dump(&g_handoff_arena);
 
     debug("Kernel entry is located at 0x%llx\r\n", kernel_entry);
     debug("Preparing for handoff...\r\n");
+
+    // the firmware console is gone after this, the serial port catches up
+    // below; the framebuffer console keeps working and stays attached
+    if (!fbcon_active()) {
+        logring_drain(LOG_SINK_MASK(LogSinkConsole), 0);
+        logring_set_sinks(logring_get_sinks() & ~LOG_SINK_MASK(LogSinkConsole));
+    }
     fw_prepare_handoff();
 
-    abp_handoff(kernel_entry, &boot_info, kernel_stack, 16);
-}
\ No newline at end of file
+    // the firmware let go of the APs, park them on the kernel's page tables
+    abp_smp_start(&boot_info.smp);
+
+    timestamp_record(TimestampHandoff);
+    boot_info.timestamps.loader_entry = timestamp_get(TimestampLoaderEntry);
+    boot_info.timestamps.config_loaded = timestamp_get(TimestampConfigLoaded);
+    boot_info.timestamps.menu_done = timestamp_get(TimestampMenuDone);
+    boot_info.timestamps.kernel_loaded = timestamp_get(TimestampKernelLoaded);
+    boot_info.timestamps.paging_done = timestamp_get(TimestampPagingDone);
+    boot_info.timestamps.handoff = timestamp_get(TimestampHandoff);
+
+    abp_fill_timeline(&boot_info.timeline);
+    abp_fill_memory_stats(&boot_info.memory_stats);
+    memstat_dump();
+    debug("Page tables: %llu PML4, %llu PDPT, %llu PD, %llu PT (%llu identity, %llu HHDM)\r\n",
+          boot_info.memory_stats.page_tables_per_level[0], boot_info.memory_stats.page_tables_per_level[1],
+          boot_info.memory_stats.page_tables_per_level[2], boot_info.memory_stats.page_tables_per_level[3],
+          boot_info.memory_stats.identity_map_tables, boot_info.memory_stats.hhdm_tables);
+
+    // nothing may be logged past this point, or the kernel won't see it
+    logring_drain(LOG_SINKS_ALL, 0);
+    boot_info.log.buffer = ring->buffer;
+    boot_info.log.size = ring->size;
+    boot_info.log.head = ring->head;
+    boot_info.log.tail = ring->tail;
+
+    abp_handoff(kernel_entry, &boot_info, kernel_stack, stack_pages);
+}
@@ -0,0 +1,87 @@
+###################################################################################
+## Module Name:  host.mk                                                         ##
+## Project:      AurixOS                                                         ##
+##                                                                               ##
+## Copyright (c) 2024 Jozef Nagy                                                 ##
+##                                                                               ##
+## This source is subject to the MIT License.                                    ##
+## See License.txt in the root of this repository.                               ##
+## All other rights reserved.                                                    ##
+##                                                                               ##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    ##
+## IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      ##
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   ##
+## AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        ##
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, ##
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE ##
+## SOFTWARE.                                                                     ##
+###################################################################################
+
+# Host-native build of the firmware-independent code, linked against the
+# mock firmware layer in host/mock. Used for unit tests and benchmarking on a
+# dev machine.
+
+HOST_BUILD_DIR := $(BUILD_DIR)/host
+
+# AxBoot's libc-alike symbols are renamed so they don't collide with the
+# host's libc.
+HOST_RENAMES := memcpy memset memcmp strlen strcpy malloc free mallocpage \
+				mbstowcs log _fltused __eqdf2 __ltdf2
+
+HOST_AXBOOT_CFLAGS := $(HOST_CFLAGS) -D__$(ARCH) -D_AXBOOT -DAXBOOT_HOST=1 \
+				-fno-builtin -Ihost/include -Ihost/bench -Ihost/test \
+				$(foreach d, $(HOST_INCLUDE_DIRS), -I$d) \
+				$(foreach s, $(HOST_RENAMES), -D$s=axboot_$s)
+HOST_NATIVE_CFLAGS := $(HOST_CFLAGS) -Ihost/include -Ihost/bench -Ihost/test \
+				$(foreach d, $(HOST_INCLUDE_DIRS), -I$d)
+
+HOST_UNIT_CFILES := common/lib/string.c \
+				common/lib/arena.c \
+				common/lib/memstat.c \
+				common/lib/logring.c \
+				common/lib/fbcon.c \
+				common/lib/memmap.c \
+				common/lib/crc32.c \
+				common/loader/elf/elf.c \
+				common/config/parser.c \
+				common/config/binary.c \
+				common/print.c \
+				arch/$(ARCH)/common/mm/paging.c
+
+HOST_BENCH_CFILES := $(wildcard host/bench/bench_*.c)
+HOST_TEST_CFILES := $(wildcard host/test/test_*.c)
+
+HOST_UNIT_OBJ := $(addprefix $(HOST_BUILD_DIR)/,$(HOST_UNIT_CFILES:.c=.o))
+HOST_BENCH_OBJ := $(addprefix $(HOST_BUILD_DIR)/,$(HOST_BENCH_CFILES:.c=.o))
+HOST_TEST_OBJ := $(addprefix $(HOST_BUILD_DIR)/,$(HOST_TEST_CFILES:.c=.o))
+HOST_AXBOOT_OBJ := $(HOST_UNIT_OBJ) $(HOST_BENCH_OBJ) $(HOST_TEST_OBJ)
+
+HOST_MOCK_OBJ := $(HOST_BUILD_DIR)/host/mock/fw.o
+HOST_BENCH_RUNNER_OBJ := $(HOST_BUILD_DIR)/host/bench/bench.o
+HOST_TEST_RUNNER_OBJ := $(HOST_BUILD_DIR)/host/test/test.o
+HOST_NATIVE_OBJ := $(HOST_MOCK_OBJ) $(HOST_BENCH_RUNNER_OBJ) $(HOST_TEST_RUNNER_OBJ)
+
+HOST_BENCH := $(HOST_BUILD_DIR)/axboot-bench
+HOST_TEST := $(HOST_BUILD_DIR)/axboot-test
+
+$(HOST_BENCH): $(HOST_UNIT_OBJ) $(HOST_BENCH_OBJ) $(HOST_MOCK_OBJ) $(HOST_BENCH_RUNNER_OBJ)
+	@mkdir -p $(@D)
+	@printf "  HOSTLD\t$(notdir $@)\n"
+	@$(HOST_CC) $^ -o $@
+
+$(HOST_TEST): $(HOST_UNIT_OBJ) $(HOST_TEST_OBJ) $(HOST_MOCK_OBJ) $(HOST_TEST_RUNNER_OBJ)
+	@mkdir -p $(@D)
+	@printf "  HOSTLD\t$(notdir $@)\n"
+	@$(HOST_CC) $^ -o $@
+
+$(HOST_AXBOOT_OBJ): $(HOST_BUILD_DIR)/%.o: %.c
+	@mkdir -p $(@D)
+	@printf "  HOSTCC\t$<\n"
+	@$(HOST_CC) $(HOST_AXBOOT_CFLAGS) -MMD -MP -c $< -o $@
+
+$(HOST_NATIVE_OBJ): $(HOST_BUILD_DIR)/%.o: %.c
+	@mkdir -p $(@D)
+	@printf "  HOSTCC\t$<\n"
+	@$(HOST_CC) $(HOST_NATIVE_CFLAGS) -MMD -MP -c $< -o $@
+
+-include $(HOST_AXBOOT_OBJ:.o=.d) $(HOST_NATIVE_OBJ:.o=.d)
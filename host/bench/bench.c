@@ -0,0 +1,170 @@
+/*********************************************************************************/
+/* Module Name:  bench.c                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// Benchmark runner. Usage: axboot-bench [--min-time=<seconds>] [filter]
+//
+
+#include <bench.h>
+#include <host.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct bench *benchmarks = NULL;
+static struct bench **benchmarks_tail = &benchmarks;
+
+void bench_register(struct bench *bench)
+{
+	// keep registration order so related benchmarks stay together
+	*benchmarks_tail = bench;
+	benchmarks_tail = &bench->next;
+}
+
+bool bench_next(struct bench_state *state)
+{
+	if (state->current == 0) {
+		state->start_ns = host_time_ns();
+	}
+
+	if (state->current++ < state->iterations) {
+		return true;
+	}
+
+	state->elapsed_ns += host_time_ns() - state->start_ns;
+	return false;
+}
+
+void bench_pause(struct bench_state *state)
+{
+	state->elapsed_ns += host_time_ns() - state->start_ns;
+}
+
+void bench_resume(struct bench_state *state)
+{
+	state->start_ns = host_time_ns();
+}
+
+void bench_set_bytes(struct bench_state *state, uint64_t bytes)
+{
+	state->bytes_per_iteration = bytes;
+}
+
+void bench_set_counter(struct bench_state *state, const char *name, double value)
+{
+	for (uint32_t i = 0; i < state->counter_count; i++) {
+		if (strcmp(state->counters[i].name, name) == 0) {
+			state->counters[i].value = value;
+			return;
+		}
+	}
+
+	if (state->counter_count < BENCH_MAX_COUNTERS) {
+		state->counters[state->counter_count].name = name;
+		state->counters[state->counter_count].value = value;
+		state->counter_count++;
+	}
+}
+
+static void format_time(char *buf, size_t size, double ns)
+{
+	if (ns >= 1e9) {
+		snprintf(buf, size, "%.2f s", ns / 1e9);
+	} else if (ns >= 1e6) {
+		snprintf(buf, size, "%.2f ms", ns / 1e6);
+	} else if (ns >= 1e3) {
+		snprintf(buf, size, "%.2f us", ns / 1e3);
+	} else {
+		snprintf(buf, size, "%.1f ns", ns);
+	}
+}
+
+static void run_bench(struct bench *bench, double min_time)
+{
+	struct bench_state state;
+	uint64_t iterations = 1;
+	char name[96];
+	char time[32];
+	double per_iteration;
+
+	while (1) {
+		memset(&state, 0, sizeof(state));
+		state.arg = bench->arg;
+		state.iterations = iterations;
+
+		bench->fn(&state);
+
+		if (state.elapsed_ns >= min_time * 1e9 || iterations >= (1ull << 40)) {
+			break;
+		}
+
+		// aim a bit past the minimum time on the next run
+		if (state.elapsed_ns < 1000) {
+			iterations *= 100;
+		} else {
+			uint64_t next = (uint64_t)(iterations * (min_time * 1e9 * 1.4) / state.elapsed_ns);
+			iterations = (next > iterations * 100) ? iterations * 100 : (next > iterations ? next : iterations * 2);
+		}
+	}
+
+	per_iteration = (double)state.elapsed_ns / state.iterations;
+	snprintf(name, sizeof(name), "%s/%llu", bench->name, (unsigned long long)bench->arg);
+	format_time(time, sizeof(time), per_iteration);
+	printf("%-44s %12s %12llu", name, time, (unsigned long long)state.iterations);
+
+	if (state.bytes_per_iteration != 0) {
+		printf("  %8.2f MiB/s", (state.bytes_per_iteration / (per_iteration / 1e9)) / (1024.0 * 1024.0));
+	}
+
+	for (uint32_t i = 0; i < state.counter_count; i++) {
+		printf("  %s=%.0f", state.counters[i].name, state.counters[i].value);
+	}
+
+	printf("\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = NULL;
+	double min_time = 0.2;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--min-time=", 11) == 0) {
+			min_time = atof(argv[i] + 11);
+		} else {
+			filter = argv[i];
+		}
+	}
+
+	host_verbose = getenv("AXBOOT_HOST_VERBOSE") != NULL;
+
+	printf("%-44s %12s %12s\n", "Benchmark", "Time", "Iterations");
+	printf("--------------------------------------------------------------------------------\n");
+
+	for (struct bench *bench = benchmarks; bench != NULL; bench = bench->next) {
+		if (filter != NULL && strstr(bench->name, filter) == NULL) {
+			continue;
+		}
+		run_bench(bench, min_time);
+	}
+
+	return 0;
+}
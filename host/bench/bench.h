@@ -0,0 +1,94 @@
+/*********************************************************************************/
+/* Module Name:  bench.h                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _HOST_BENCH_H
+#define _HOST_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// A small Google Benchmark style harness.
+//
+//   static void bench_foo(struct bench_state *state)
+//   {
+//       while (bench_next(state)) {
+//           foo(state->arg);
+//       }
+//       bench_set_bytes(state, state->arg);
+//   }
+//   BENCHMARK("foo", bench_foo, 4096);
+//
+// Each benchmark is rerun with a growing iteration count until it runs
+// for at least the minimum time, then reported per iteration.
+//
+
+#define BENCH_MAX_COUNTERS 4
+
+struct bench_counter {
+	const char *name;
+	double value;
+};
+
+struct bench_state {
+	uint64_t arg;
+	uint64_t iterations;
+	uint64_t current;
+
+	uint64_t start_ns;
+	uint64_t elapsed_ns;
+	uint64_t bytes_per_iteration;
+
+	struct bench_counter counters[BENCH_MAX_COUNTERS];
+	uint32_t counter_count;
+};
+
+typedef void (*bench_fn)(struct bench_state *state);
+
+struct bench {
+	const char *name;
+	bench_fn fn;
+	uint64_t arg;
+	struct bench *next;
+};
+
+void bench_register(struct bench *bench);
+
+bool bench_next(struct bench_state *state);
+void bench_pause(struct bench_state *state);
+void bench_resume(struct bench_state *state);
+
+// bytes touched per iteration, reported as throughput
+void bench_set_bytes(struct bench_state *state, uint64_t bytes);
+
+// extra per-run values reported next to the timings
+void bench_set_counter(struct bench_state *state, const char *name, double value);
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+
+#define BENCHMARK(name, fn, arg) \
+	static struct bench BENCH_CONCAT(bench_def_, __LINE__) = { (name), (fn), (arg), NULL }; \
+	__attribute__((constructor)) static void BENCH_CONCAT(bench_reg_, __LINE__)(void) \
+	{ \
+		bench_register(&BENCH_CONCAT(bench_def_, __LINE__)); \
+	}
+
+#endif /* _HOST_BENCH_H */
@@ -0,0 +1,52 @@
+/*********************************************************************************/
+/* Module Name:  bench_arena.c                                                   */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/arena.h>
+#include <lib/memstat.h>
+#include <firmware/memory.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// config tokens, memmap arrays and the like: many small allocations
+// followed by a reset
+static void bench_arena_alloc(struct bench_state *state)
+{
+	struct arena arena = ARENA_INIT("bench", FwMemoryLoader, MemStatTransient);
+	struct arena_mark mark;
+
+	// keep the chunk around between iterations
+	arena_reserve(&arena, 2 * ARENA_CHUNK_SIZE);
+	mark = arena_mark(&arena);
+
+	while (bench_next(state)) {
+		for (uint64_t i = 0; i < state->arg; i++) {
+			arena_alloc(&arena, 24 + (i & 63));
+		}
+		arena_reset(&arena, mark);
+	}
+	bench_set_counter(state, "high_water", arena.high_water);
+	bench_set_counter(state, "chunks", arena.chunk_count);
+
+	arena_release(&arena);
+}
+BENCHMARK("arena/alloc_reset", bench_arena_alloc, 64);
+BENCHMARK("arena/alloc_reset", bench_arena_alloc, 4096);
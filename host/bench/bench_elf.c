@@ -0,0 +1,125 @@
+/*********************************************************************************/
+/* Module Name:  bench_elf.c                                                     */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <loader/elf.h>
+#include <lib/string.h>
+#include <axboot.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ELF_SEGMENTS 4
+
+// Builds an ELF64 executable with ELF_SEGMENTS PT_LOAD segments of
+// segment_size bytes each (half file-backed, half bss) and a PT_NOTE
+// segment. Segments are placed at host addresses inside dest.
+static uint8_t *build_elf(uint64_t segment_size, uint8_t *dest, size_t *size)
+{
+	size_t headers = sizeof(Elf64_Ehdr) + (ELF_SEGMENTS + 1) * sizeof(Elf64_Phdr);
+	size_t notes = 64;
+	size_t data_offset = ROUND_UP(headers + notes, 4096);
+	uint8_t *image;
+
+	*size = data_offset + ELF_SEGMENTS * (segment_size / 2);
+	image = host_alloc(4096, *size);
+	memset(image, 0, *size);
+
+	Elf64_Ehdr *ehdr = (Elf64_Ehdr *)image;
+	ehdr->e_ident[EI_MAG0] = ELFMAG0;
+	ehdr->e_ident[EI_MAG1] = ELFMAG1;
+	ehdr->e_ident[EI_MAG2] = ELFMAG2;
+	ehdr->e_ident[EI_MAG3] = ELFMAG3;
+	ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+	ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr->e_type = ET_EXEC;
+	ehdr->e_machine = EM_X86_64;
+	ehdr->e_version = EV_CURRENT;
+	ehdr->e_entry = (uint64_t)dest;
+	ehdr->e_phoff = sizeof(Elf64_Ehdr);
+	ehdr->e_phentsize = sizeof(Elf64_Phdr);
+	ehdr->e_phnum = ELF_SEGMENTS + 1;
+
+	Elf64_Phdr *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+	for (int i = 0; i < ELF_SEGMENTS; i++) {
+		phdrs[i].p_type = PT_LOAD;
+		phdrs[i].p_offset = data_offset + i * (segment_size / 2);
+		phdrs[i].p_paddr = (uint64_t)dest + i * segment_size;
+		phdrs[i].p_vaddr = phdrs[i].p_paddr;
+		phdrs[i].p_filesz = segment_size / 2;
+		phdrs[i].p_memsz = segment_size;
+	}
+
+	// one note: "AxBoot" owner, 8 byte descriptor
+	Elf64_Nhdr *note = (Elf64_Nhdr *)(image + headers);
+	note->n_namesz = 7;
+	note->n_descsz = 8;
+	note->n_type = 0x100;
+	memcpy(image + headers + sizeof(Elf64_Nhdr), "AxBoot", 7);
+
+	phdrs[ELF_SEGMENTS].p_type = PT_NOTE;
+	phdrs[ELF_SEGMENTS].p_offset = headers;
+	phdrs[ELF_SEGMENTS].p_filesz = sizeof(Elf64_Nhdr) + 8 + 8;
+
+	return image;
+}
+
+static void bench_elf_load(struct bench_state *state)
+{
+	uint8_t *dest = host_alloc(4096, ELF_SEGMENTS * state->arg);
+	size_t size;
+	uint8_t *image = build_elf(state->arg, dest, &size);
+	void *entry;
+
+	while (bench_next(state)) {
+		elf_load(image, &entry);
+	}
+	bench_set_bytes(state, ELF_SEGMENTS * state->arg);
+
+	host_free(image);
+	host_free(dest);
+}
+BENCHMARK("elf/load", bench_elf_load, 64 * 1024);
+BENCHMARK("elf/load", bench_elf_load, 4 * 1024 * 1024);
+
+static void count_note(uint32_t type, void *desc, uint32_t descsz, void *ctx)
+{
+	(void)type;
+	(void)desc;
+	(void)descsz;
+	(*(int *)ctx)++;
+}
+
+static void bench_elf_notes(struct bench_state *state)
+{
+	uint8_t *dest = host_alloc(4096, ELF_SEGMENTS * 4096);
+	size_t size;
+	uint8_t *image = build_elf(4096, dest, &size);
+	int count = 0;
+
+	while (bench_next(state)) {
+		elf_parse_notes(image, size, "AxBoot", count_note, &count);
+	}
+	bench_set_counter(state, "notes", (double)count / state->iterations);
+
+	host_free(image);
+	host_free(dest);
+}
+BENCHMARK("elf/parse_notes", bench_elf_notes, 0);
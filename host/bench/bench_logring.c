@@ -0,0 +1,70 @@
+/*********************************************************************************/
+/* Module Name:  bench_logring.c                                                 */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/logring.h>
+#include <print.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// what a debug() call costs the loader now that it only appends to the ring
+static void bench_logring_debug(struct bench_state *state)
+{
+	char line[256];
+
+	for (uint64_t i = 0; i < state->arg && i < sizeof(line) - 3; i++) {
+		line[i] = 'a' + (i % 26);
+	}
+	line[state->arg] = '\r';
+	line[state->arg + 1] = '\n';
+	line[state->arg + 2] = '\0';
+
+	logring_init();
+
+	while (bench_next(state)) {
+		debug("%s", line);
+
+		// drain the way the menu does, outside the measured path
+		bench_pause(state);
+		logring_drain(LOG_SINKS_ALL, 0);
+		bench_resume(state);
+	}
+	bench_set_bytes(state, state->arg);
+}
+BENCHMARK("logring/debug", bench_logring_debug, 32);
+BENCHMARK("logring/debug", bench_logring_debug, 200);
+
+// draining many small records into the serial port
+static void bench_logring_drain(struct bench_state *state)
+{
+	logring_init();
+
+	while (bench_next(state)) {
+		bench_pause(state);
+		for (uint64_t i = 0; i < state->arg; i++) {
+			logring_write(LogLevelDebug, "Entry 12: base=0x100000 length=4096 type=usable\r\n");
+		}
+		bench_resume(state);
+
+		logring_drain(LOG_SINKS_ALL, 0);
+	}
+}
+BENCHMARK("logring/drain", bench_logring_drain, 64);
@@ -0,0 +1,121 @@
+/*********************************************************************************/
+/* Module Name:  bench_memmap.c                                                  */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <firmware/memmap.h>
+#include <lib/numa.h>
+#include <lib/string.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A fragmented firmware-style map: runs of same-typed neighbours that
+// should merge, holes, and every 16th pair swapped out of order.
+static void build_fragmented_map(struct memory_map_entry *entries, uint64_t count)
+{
+	uint64_t base = 0;
+
+	for (uint64_t i = 0; i < count; i++) {
+		entries[i].base = base;
+		entries[i].length = ((i % 7) + 1) * 0x1000;
+		entries[i].type = (i % 5 == 0) ? MemoryMapReserved : MemoryMapUsable;
+		entries[i].flags = 0;
+		entries[i].proximity = MEMMAP_NO_PROXIMITY;
+
+		base += entries[i].length;
+		if (i % 11 == 0) {
+			base += 0x10000;
+		}
+	}
+
+	for (uint64_t i = 0; i + 1 < count; i += 16) {
+		struct memory_map_entry tmp = entries[i];
+		entries[i] = entries[i + 1];
+		entries[i + 1] = tmp;
+	}
+}
+
+static void bench_memmap_normalize(struct bench_state *state)
+{
+	size_t size = state->arg * sizeof(struct memory_map_entry);
+	struct memory_map_entry *source = host_alloc(64, size);
+	struct memory_map_info memmap;
+
+	memmap.entries = host_alloc(64, size);
+	build_fragmented_map(source, state->arg);
+
+	while (bench_next(state)) {
+		bench_pause(state);
+		memcpy(memmap.entries, source, size);
+		memmap.entry_count = state->arg;
+		bench_resume(state);
+
+		memmap_normalize(&memmap);
+	}
+	bench_set_counter(state, "entries_out", memmap.entry_count);
+
+	host_free(source);
+	host_free(memmap.entries);
+}
+BENCHMARK("memmap/normalize", bench_memmap_normalize, 64);
+BENCHMARK("memmap/normalize", bench_memmap_normalize, 512);
+BENCHMARK("memmap/normalize", bench_memmap_normalize, 4096);
+
+// Two nodes splitting the fragmented map in the middle, like a dual-socket box
+static void bench_memmap_split_numa(struct bench_state *state)
+{
+	size_t size = state->arg * sizeof(struct memory_map_entry);
+	struct memory_map_entry *source = host_alloc(64, size);
+	struct memory_map_info memmap;
+	struct numa_range ranges[2];
+
+	build_fragmented_map(source, state->arg);
+	memmap.entries = source;
+	memmap.entry_count = state->arg;
+	memmap_normalize(&memmap);
+
+	uint64_t normalized = memmap.entry_count;
+	uint64_t end = source[normalized - 1].base + source[normalized - 1].length;
+	ranges[0].base = 0;
+	ranges[0].length = end / 2;
+	ranges[0].proximity = 0;
+	ranges[1].base = end / 2;
+	ranges[1].length = end - end / 2;
+	ranges[1].proximity = 1;
+
+	while (bench_next(state)) {
+		bench_pause(state);
+		memmap.entries = malloc(normalized * sizeof(struct memory_map_entry));
+		memcpy(memmap.entries, source, normalized * sizeof(struct memory_map_entry));
+		memmap.entry_count = normalized;
+		bench_resume(state);
+
+		memmap_split_numa(&memmap, ranges, 2);
+
+		bench_pause(state);
+		free(memmap.entries);
+		bench_resume(state);
+	}
+	bench_set_counter(state, "entries_out", memmap.entry_count);
+
+	host_free(source);
+}
+BENCHMARK("memmap/split_numa", bench_memmap_split_numa, 64);
+BENCHMARK("memmap/split_numa", bench_memmap_split_numa, 4096);
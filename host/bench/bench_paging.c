@@ -0,0 +1,115 @@
+/*********************************************************************************/
+/* Module Name:  bench_paging.c                                                  */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <arch/mm/paging.h>
+#include <firmware/memmap.h>
+#include <lib/string.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARENA_SIZE (256ull * 1024 * 1024)
+
+//
+// Page tables are built in a host arena standing in for usable memory.
+// paging_init() allocates from the first usable entry after entry 0, so
+// the arena goes second; everything else in the map is only mapped,
+// never touched.
+//
+
+static uint8_t *arena = NULL;
+
+static void setup_arena(struct memory_map_info *memmap, struct memory_map_entry *entries, uint64_t mapped_size)
+{
+	if (arena == NULL) {
+		arena = host_alloc(PAGE_SIZE_1G, ARENA_SIZE);
+	}
+
+	entries[0].base = 0;
+	entries[0].length = PAGE_SIZE;
+	entries[0].type = MemoryMapReserved;
+	entries[0].flags = 0;
+	entries[0].proximity = MEMMAP_NO_PROXIMITY;
+
+	entries[1].base = (uint64_t)arena;
+	entries[1].length = ARENA_SIZE;
+	entries[1].type = MemoryMapUsable;
+	entries[1].flags = 0;
+	entries[1].proximity = MEMMAP_NO_PROXIMITY;
+
+	// the range that's actually being mapped, well away from the arena
+	entries[2].base = 0x100000000ull;
+	entries[2].length = mapped_size;
+	entries[2].type = MemoryMapAcpiNVS;
+	entries[2].flags = 0;
+	entries[2].proximity = MEMMAP_NO_PROXIMITY;
+
+	memmap->entries = entries;
+	memmap->entry_count = 3;
+}
+
+static void bench_paging_init(struct bench_state *state, uint32_t page_sizes)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+
+	setup_arena(&memmap, entries, state->arg * 1024 * 1024);
+
+	while (bench_next(state)) {
+		paging_init(&memmap, HHDM_DEFAULT_BASE, page_sizes);
+	}
+	bench_set_bytes(state, state->arg * 1024 * 1024);
+}
+
+static void bench_paging_init_4k(struct bench_state *state)
+{
+	bench_paging_init(state, 0);
+}
+BENCHMARK("paging/init_4k_mib", bench_paging_init_4k, 16);
+BENCHMARK("paging/init_4k_mib", bench_paging_init_4k, 256);
+
+static void bench_paging_init_2m(struct bench_state *state)
+{
+	bench_paging_init(state, PAGING_PAGE_2M);
+}
+BENCHMARK("paging/init_2m_mib", bench_paging_init_2m, 256);
+BENCHMARK("paging/init_2m_mib", bench_paging_init_2m, 4096);
+
+static void bench_paging_map(struct bench_state *state)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+
+	setup_arena(&memmap, entries, 0);
+
+	while (bench_next(state)) {
+		bench_pause(state);
+		paging_init(&memmap, 0, 0);
+		bench_resume(state);
+
+		for (uint64_t i = 0; i < state->arg; i++) {
+			paging_map(0x100000000ull + (i * PAGE_SIZE), HHDM_DEFAULT_BASE + (i * PAGE_SIZE));
+		}
+	}
+	bench_set_counter(state, "pages", state->arg);
+}
+BENCHMARK("paging/map_4k_pages", bench_paging_map, 512);
+BENCHMARK("paging/map_4k_pages", bench_paging_map, 65536);
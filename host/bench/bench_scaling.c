@@ -0,0 +1,280 @@
+/*********************************************************************************/
+/* Module Name:  bench_scaling.c                                                 */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <arch/mm/paging.h>
+#include <firmware/memmap.h>
+#include <lib/string.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Scaling benchmarks for large machines: synthetic firmware memory maps are
+// translated and normalized like fw_get_memory_map() does, then handed to
+// paging_init() as AxBoot would for the kernel.
+//
+// Page tables are built in a host arena placed at entry 1 of the map, which
+// is where paging_init() starts allocating from. The synthetic ranges are
+// only ever described in page tables, never touched. With 4 KiB pages the
+// tables grow by 8 KiB (identity + HHDM) per 2 MiB of described memory, so
+// 4 KiB profiles are kept small enough to fit the arena; pt_pages shows how
+// they extrapolate.
+//
+
+#define GIB (1024ull * 1024 * 1024)
+#define MIB (1024ull * 1024)
+
+#define ARENA_SIZE (1024ull * MIB)
+
+#define MAX_DESCRIPTORS 16384
+
+typedef uint64_t (*profile_fn)(struct memory_map_entry *descs, uint64_t arg);
+
+static uint8_t *arena = NULL;
+
+static struct memory_map_entry *descs = NULL;
+static struct memory_map_entry *entries = NULL;
+
+static uint64_t add_desc(struct memory_map_entry *descs, uint64_t n, uint64_t base, uint64_t length, uint16_t type)
+{
+	descs[n].base = base;
+	descs[n].length = length;
+	descs[n].type = type;
+	descs[n].flags = 0;
+	descs[n].proximity = MEMMAP_NO_PROXIMITY;
+	return n + 1;
+}
+
+// The first 4 GiB of a typical x86 machine: legacy area, low RAM, ACPI
+// tables and runtime services below the PCI hole, 32-bit MMIO above it.
+static uint64_t add_low_memory(struct memory_map_entry *descs, uint64_t n)
+{
+	n = add_desc(descs, n, 0, 0x9f000, MemoryMapUsable);
+	n = add_desc(descs, n, 0x9f000, 0x61000, MemoryMapReserved);
+	n = add_desc(descs, n, 0x100000, 0x7f700000, MemoryMapUsable);
+	n = add_desc(descs, n, 0x7f800000, 0x400000, MemoryMapAcpiNVS);
+	n = add_desc(descs, n, 0x7fc00000, 0x200000, MemoryMapAcpiReclaimable);
+	n = add_desc(descs, n, 0x7fe00000, 0x200000, MemoryMapReserved);
+	n = add_desc(descs, n, 0xc0000000, 0x10000000, MemoryMapMmio);
+	n = add_desc(descs, n, 0xfec00000, 0x1400000, MemoryMapMmio);
+	return n;
+}
+
+// arg small fragments above 4 GiB, as left behind by boot services drivers
+// allocating and freeing pool memory; a few are empty and a few are out of
+// order, like real firmware maps.
+static uint64_t profile_fragments(struct memory_map_entry *descs, uint64_t arg)
+{
+	uint64_t n = add_low_memory(descs, 0);
+	uint64_t base = 4 * GIB;
+
+	for (uint64_t i = 0; i < arg && n < MAX_DESCRIPTORS; i++) {
+		uint64_t length = (((i * 7) % 16) + 1) * PAGE_SIZE;
+		uint16_t type = MemoryMapUsable;
+
+		if (i % 3 == 0) {
+			type = MemoryMapReserved;
+		} else if (i % 7 == 0) {
+			type = MemoryMapAcpiNVS;
+		} else if (i % 32 == 0) {
+			length = 0;
+		}
+
+		n = add_desc(descs, n, base, length, type);
+		base += length;
+	}
+
+	for (uint64_t i = 8; i + 1 < n; i += 64) {
+		struct memory_map_entry tmp = descs[i];
+		descs[i] = descs[i + 1];
+		descs[i + 1] = tmp;
+	}
+
+	return n;
+}
+
+// arg GiB of RAM above 4 GiB in 256 GiB per-node descriptors.
+static uint64_t profile_huge(struct memory_map_entry *descs, uint64_t arg)
+{
+	uint64_t n = add_low_memory(descs, 0);
+	uint64_t base = 4 * GIB;
+	uint64_t remaining = arg * GIB;
+
+	while (remaining > 0 && n < MAX_DESCRIPTORS) {
+		uint64_t length = remaining < 256 * GIB ? remaining : 256 * GIB;
+
+		n = add_desc(descs, n, base, length, MemoryMapUsable);
+		base += length;
+		remaining -= length;
+	}
+
+	return n;
+}
+
+// 1 TiB of RAM broken up by arg 64-bit MMIO windows of 16 MiB each. The
+// windows are 2 MiB but not 1 GiB aligned, so the RAM around each of them
+// can't be mapped with 1 GiB pages.
+static uint64_t profile_mmio_holes(struct memory_map_entry *descs, uint64_t arg)
+{
+	uint64_t n = add_low_memory(descs, 0);
+	uint64_t base = 4 * GIB;
+	uint64_t stride = (1024 * GIB) / (arg + 1);
+
+	stride &= ~(PAGE_SIZE_2M - 1);
+
+	for (uint64_t i = 0; i <= arg && n + 1 < MAX_DESCRIPTORS; i++) {
+		uint64_t length = stride - 16 * MIB;
+
+		n = add_desc(descs, n, base, length, MemoryMapUsable);
+		if (i < arg) {
+			n = add_desc(descs, n, base + length, 16 * MIB, MemoryMapMmio);
+		}
+		base += stride;
+	}
+
+	return n;
+}
+
+// 512 GiB of RAM followed by arg GiB of persistent memory in 128 GiB
+// regions, each with a 2 MiB label area in front of it. Persistent memory
+// is reported as usable for now.
+static uint64_t profile_pmem(struct memory_map_entry *descs, uint64_t arg)
+{
+	uint64_t n = add_low_memory(descs, 0);
+	uint64_t base = 4 * GIB;
+	uint64_t remaining = arg * GIB;
+
+	n = add_desc(descs, n, base, 512 * GIB, MemoryMapUsable);
+	base += 512 * GIB;
+
+	while (remaining > 0 && n + 1 < MAX_DESCRIPTORS) {
+		uint64_t length = remaining < 128 * GIB ? remaining : 128 * GIB;
+
+		n = add_desc(descs, n, base, PAGE_SIZE_2M, MemoryMapReserved);
+		n = add_desc(descs, n, base + PAGE_SIZE_2M, length, MemoryMapUsable);
+		base += PAGE_SIZE_2M + length;
+		remaining -= length;
+	}
+
+	return n;
+}
+
+// The translation loop of fw_get_memory_map(), minus the EFI type switch.
+static void translate(struct memory_map_info *memmap, struct memory_map_entry *descs, uint64_t count)
+{
+	memmap->entry_count = 0;
+	for (uint64_t i = 0; i < count; i++) {
+		if (descs[i].length == 0) {
+			continue;
+		}
+		memmap->entries[memmap->entry_count++] = descs[i];
+	}
+
+	memmap_normalize(memmap);
+}
+
+static void bench_scaling(struct bench_state *state, profile_fn profile, uint32_t page_sizes)
+{
+	struct memory_map_info memmap;
+	uint64_t count;
+	uint64_t normalized = 0;
+	uint64_t table_pages = 0;
+
+	if (arena == NULL) {
+		arena = host_alloc(PAGE_SIZE_1G, ARENA_SIZE);
+		descs = host_alloc(64, MAX_DESCRIPTORS * sizeof(struct memory_map_entry));
+		entries = host_alloc(64, (MAX_DESCRIPTORS + 2) * sizeof(struct memory_map_entry));
+	}
+
+	count = profile(descs, state->arg);
+	memmap.entries = entries + 2;
+
+	while (bench_next(state)) {
+		translate(&memmap, descs, count);
+		normalized = memmap.entry_count;
+
+		// prepend the page table arena; see above
+		memmap.entries = entries;
+		memmap.entry_count += 2;
+		entries[0].base = 0;
+		entries[0].length = PAGE_SIZE;
+		entries[0].type = MemoryMapReserved;
+		entries[0].flags = 0;
+		entries[0].proximity = MEMMAP_NO_PROXIMITY;
+		entries[1].base = (uint64_t)arena;
+		entries[1].length = ARENA_SIZE;
+		entries[1].type = MemoryMapUsable;
+		entries[1].flags = 0;
+		entries[1].proximity = MEMMAP_NO_PROXIMITY;
+
+		paging_init(&memmap, HHDM_DEFAULT_BASE, page_sizes);
+		table_pages = paging_get_table_pages();
+
+		memmap.entries = entries + 2;
+	}
+
+	bench_set_counter(state, "entries_in", count);
+	bench_set_counter(state, "entries_out", normalized);
+	bench_set_counter(state, "pt_pages", table_pages);
+	bench_set_counter(state, "peak_kib", ((table_pages * PAGE_SIZE) + (normalized * sizeof(struct memory_map_entry))) / 1024);
+}
+
+#define SCALING_BENCHMARK(profile, suffix, page_sizes) \
+	static void bench_##profile##_##suffix(struct bench_state *state) \
+	{ \
+		bench_scaling(state, profile_##profile, page_sizes); \
+	}
+
+SCALING_BENCHMARK(fragments, 4k, 0)
+BENCHMARK("scaling/fragments_4k", bench_fragments_4k, 256);
+BENCHMARK("scaling/fragments_4k", bench_fragments_4k, 4096);
+
+SCALING_BENCHMARK(fragments, 2m, PAGING_PAGE_2M)
+BENCHMARK("scaling/fragments_2m", bench_fragments_2m, 256);
+BENCHMARK("scaling/fragments_2m", bench_fragments_2m, 4096);
+
+SCALING_BENCHMARK(huge, 4k, 0)
+BENCHMARK("scaling/huge_4k_gib", bench_huge_4k, 16);
+BENCHMARK("scaling/huge_4k_gib", bench_huge_4k, 64);
+
+SCALING_BENCHMARK(huge, 2m, PAGING_PAGE_2M)
+BENCHMARK("scaling/huge_2m_gib", bench_huge_2m, 1024);
+BENCHMARK("scaling/huge_2m_gib", bench_huge_2m, 6144);
+
+SCALING_BENCHMARK(huge, 1g, PAGING_PAGE_1G)
+BENCHMARK("scaling/huge_1g_gib", bench_huge_1g, 1024);
+BENCHMARK("scaling/huge_1g_gib", bench_huge_1g, 6144);
+
+SCALING_BENCHMARK(mmio_holes, 2m, PAGING_PAGE_2M)
+BENCHMARK("scaling/mmio_holes_2m", bench_mmio_holes_2m, 64);
+BENCHMARK("scaling/mmio_holes_2m", bench_mmio_holes_2m, 1024);
+
+SCALING_BENCHMARK(mmio_holes, 1g, PAGING_PAGE_1G)
+BENCHMARK("scaling/mmio_holes_1g", bench_mmio_holes_1g, 64);
+BENCHMARK("scaling/mmio_holes_1g", bench_mmio_holes_1g, 1024);
+
+SCALING_BENCHMARK(pmem, 2m, PAGING_PAGE_2M)
+BENCHMARK("scaling/pmem_2m_gib", bench_pmem_2m, 1536);
+BENCHMARK("scaling/pmem_2m_gib", bench_pmem_2m, 5632);
+
+SCALING_BENCHMARK(pmem, 1g, PAGING_PAGE_1G)
+BENCHMARK("scaling/pmem_1g_gib", bench_pmem_1g, 1536);
+BENCHMARK("scaling/pmem_1g_gib", bench_pmem_1g, 5632);
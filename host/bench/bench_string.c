@@ -0,0 +1,96 @@
+/*********************************************************************************/
+/* Module Name:  bench_string.c                                                  */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/string.h>
+#include <bench.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static void bench_memcpy(struct bench_state *state)
+{
+	uint8_t *src = host_alloc(64, state->arg);
+	uint8_t *dest = host_alloc(64, state->arg);
+
+	memset(src, 0xa5, state->arg);
+	while (bench_next(state)) {
+		memcpy(dest, src, state->arg);
+	}
+	bench_set_bytes(state, state->arg);
+
+	host_free(src);
+	host_free(dest);
+}
+BENCHMARK("string/memcpy", bench_memcpy, 64);
+BENCHMARK("string/memcpy", bench_memcpy, 4096);
+BENCHMARK("string/memcpy", bench_memcpy, 1024 * 1024);
+
+static void bench_memset(struct bench_state *state)
+{
+	uint8_t *dest = host_alloc(64, state->arg);
+
+	while (bench_next(state)) {
+		memset(dest, 0, state->arg);
+	}
+	bench_set_bytes(state, state->arg);
+
+	host_free(dest);
+}
+BENCHMARK("string/memset", bench_memset, 64);
+BENCHMARK("string/memset", bench_memset, 4096);
+BENCHMARK("string/memset", bench_memset, 1024 * 1024);
+
+static void bench_memcmp(struct bench_state *state)
+{
+	uint8_t *a = host_alloc(64, state->arg);
+	uint8_t *b = host_alloc(64, state->arg);
+	volatile int result;
+
+	memset(a, 0x5a, state->arg);
+	memset(b, 0x5a, state->arg);
+	while (bench_next(state)) {
+		result = memcmp(a, b, state->arg);
+	}
+	(void)result;
+	bench_set_bytes(state, state->arg);
+
+	host_free(a);
+	host_free(b);
+}
+BENCHMARK("string/memcmp", bench_memcmp, 16);
+BENCHMARK("string/memcmp", bench_memcmp, 4096);
+
+static void bench_strlen(struct bench_state *state)
+{
+	char *str = host_alloc(64, state->arg + 1);
+	volatile size_t result;
+
+	memset(str, 'a', state->arg);
+	str[state->arg] = '\0';
+	while (bench_next(state)) {
+		result = strlen(str);
+	}
+	(void)result;
+	bench_set_bytes(state, state->arg);
+
+	host_free(str);
+}
+BENCHMARK("string/strlen", bench_strlen, 16);
+BENCHMARK("string/strlen", bench_strlen, 256);
@@ -0,0 +1,272 @@
+/*********************************************************************************/
+/* Module Name:  fw.c                                                            */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// Mock firmware layer for host builds. Implements the fw_* interfaces from
+// include/firmware/ on top of libc and POSIX, plus the output sinks used
+// by print.c.
+//
+
+#include <debug/serial.h>
+#include <firmware/fb.h>
+#include <firmware/memory.h>
+#include <firmware/file.h>
+#include <host.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+bool host_verbose = false;
+
+struct host_file {
+	int fd;
+};
+
+void *host_alloc(size_t alignment, size_t size)
+{
+	void *p = NULL;
+
+	if (posix_memalign(&p, alignment, size) != 0) {
+		return NULL;
+	}
+
+	return p;
+}
+
+void host_free(void *p)
+{
+	free(p);
+}
+
+uint64_t host_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+///
+// firmware/memory.h
+///
+
+void *fw_allocmem(size_t size)
+{
+	return malloc(size);
+}
+
+int fw_allocpage(size_t np, void *base)
+{
+	void *p = host_alloc(4096, np * 4096);
+
+	if (p == NULL) {
+		return 1;
+	}
+
+	*(uint64_t *)base = (uint64_t)p;
+	return 0;
+}
+
+void fw_free(void *p)
+{
+	free(p);
+}
+
+void *fw_allocpages(size_t np, int type)
+{
+	(void)type;
+	return host_alloc(FW_PAGE_SIZE, np * FW_PAGE_SIZE);
+}
+
+void fw_freepages(void *base, size_t np)
+{
+	(void)np;
+	free(base);
+}
+
+///
+// firmware/file.h
+//
+// Paths are resolved against $AXBOOT_HOST_ROOT (or the current directory)
+// with backslashes turned into slashes.
+///
+
+FILE *fw_file_open(FILE *directory, const char *path)
+{
+	const char *root = getenv("AXBOOT_HOST_ROOT");
+	char host_path[4096];
+	struct host_file *file;
+	size_t len;
+	int fd;
+
+	(void)directory;
+
+	if (root == NULL) {
+		root = ".";
+	}
+
+	len = strlen(root);
+	if (len + strlen(path) + 1 > sizeof(host_path)) {
+		return NULL;
+	}
+
+	memcpy(host_path, root, len);
+	for (const char *c = path; *c != '\0'; c++) {
+		host_path[len++] = (*c == '\\') ? '/' : *c;
+	}
+	host_path[len] = '\0';
+
+	fd = open(host_path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	file = malloc(sizeof(struct host_file));
+	if (file == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	file->fd = fd;
+	return file;
+}
+
+int fw_file_close(FILE *file)
+{
+	if (file == NULL) {
+		return -1;
+	}
+
+	close(file->fd);
+	free(file);
+	return 0;
+}
+
+int fw_file_read(FILE *file, uint64_t size, void *buffer)
+{
+	uint8_t *p = buffer;
+
+	if (file == NULL || buffer == NULL) {
+		return -1;
+	}
+
+	while (size > 0) {
+		ssize_t n = read(file->fd, p, size);
+		if (n <= 0) {
+			return -1;
+		}
+		p += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+int fw_file_write(FILE *file, uint64_t size, void *buffer)
+{
+	(void)file;
+	(void)size;
+	(void)buffer;
+	return -1;
+}
+
+int fw_file_size(FILE *file)
+{
+	struct stat st;
+
+	if (file == NULL || fstat(file->fd, &st) != 0) {
+		return 0;
+	}
+
+	return (int)st.st_size;
+}
+
+///
+// No framebuffer on the host, the console sink falls back to printstr()
+///
+
+int fw_initialize_fb(void)
+{
+	return 1;
+}
+
+void fw_get_framebuffer(void **address, uint32_t *width, uint32_t *height, uint16_t *bpp, uint8_t *pixelformat)
+{
+	*address = NULL;
+	*width = 0;
+	*height = 0;
+	*bpp = 0;
+	*pixelformat = 0;
+}
+
+uint32_t fw_get_fb_pitch(void)
+{
+	return 0;
+}
+
+int fw_get_glyph(uint32_t ch, uint16_t rows[FW_GLYPH_MAX_HEIGHT], uint32_t *width, uint32_t *height)
+{
+	(void)ch;
+	(void)rows;
+	*width = 0;
+	*height = 0;
+	return 1;
+}
+
+///
+// Output sinks used by print.c
+///
+
+static void host_write(const char *s)
+{
+	if (host_verbose) {
+		write(STDERR_FILENO, s, strlen(s));
+	}
+}
+
+void printstr(const char *str)
+{
+	host_write(str);
+}
+
+void serial_send(char c)
+{
+	serial_write_raw(&c, 1);
+}
+
+void serial_write(const char *s, size_t len)
+{
+	serial_write_raw(s, len);
+}
+
+void serial_write_raw(const void *data, size_t len)
+{
+	if (host_verbose) {
+		write(STDERR_FILENO, data, len);
+	}
+}
+
+void serial_sendstr(char *s)
+{
+	host_write(s);
+}
@@ -0,0 +1,84 @@
+/*********************************************************************************/
+/* Module Name:  test.c                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// Unit test runner. Usage: axboot-test [filter]
+// Exits non-zero if any test failed.
+//
+
+#include <test.h>
+#include <host.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct test *tests = NULL;
+static struct test **tests_tail = &tests;
+
+static uint32_t current_failures = 0;
+
+void test_register(struct test *test)
+{
+	*tests_tail = test;
+	tests_tail = &test->next;
+}
+
+void test_fail(const char *file, int line, const char *expr)
+{
+	printf("  %s:%d: CHECK(%s) failed\n", file, line, expr);
+	current_failures++;
+}
+
+void test_fail_eq(const char *file, int line, const char *a, const char *b, uint64_t va, uint64_t vb)
+{
+	printf("  %s:%d: CHECK_EQ(%s, %s) failed: 0x%llx != 0x%llx\n", file, line, a, b,
+		   (unsigned long long)va, (unsigned long long)vb);
+	current_failures++;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = (argc > 1) ? argv[1] : NULL;
+	uint32_t run = 0;
+	uint32_t failed = 0;
+
+	host_verbose = getenv("AXBOOT_HOST_VERBOSE") != NULL;
+
+	for (struct test *test = tests; test != NULL; test = test->next) {
+		if (filter != NULL && strstr(test->name, filter) == NULL) {
+			continue;
+		}
+
+		current_failures = 0;
+		test->fn();
+		run++;
+
+		if (current_failures != 0) {
+			printf("[FAIL] %s\n", test->name);
+			failed++;
+		} else {
+			printf("[ OK ] %s\n", test->name);
+		}
+		fflush(stdout);
+	}
+
+	printf("%u tests, %u failed\n", run, failed);
+	return (failed != 0) ? 1 : 0;
+}
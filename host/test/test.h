@@ -0,0 +1,80 @@
+/*********************************************************************************/
+/* Module Name:  test.h                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _HOST_TEST_H
+#define _HOST_TEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// Unit test harness, registered the same way as the benchmarks.
+//
+//   static void test_foo(void)
+//   {
+//       CHECK(foo_init() == 0);
+//       CHECK_EQ(foo(2), 4);
+//   }
+//   TEST("foo/basic", test_foo);
+//
+// A failed check is reported with its location and fails the test, but the
+// test keeps running so one run shows every broken assertion.
+//
+
+typedef void (*test_fn)(void);
+
+struct test {
+	const char *name;
+	test_fn fn;
+	struct test *next;
+};
+
+void test_register(struct test *test);
+
+void test_fail(const char *file, int line, const char *expr);
+void test_fail_eq(const char *file, int line, const char *a, const char *b, uint64_t va, uint64_t vb);
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			test_fail(__FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+#define CHECK_EQ(a, b) \
+	do { \
+		uint64_t check_a_ = (uint64_t)(a); \
+		uint64_t check_b_ = (uint64_t)(b); \
+		if (check_a_ != check_b_) { \
+			test_fail_eq(__FILE__, __LINE__, #a, #b, check_a_, check_b_); \
+		} \
+	} while (0)
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+
+#define TEST(name, fn) \
+	static struct test TEST_CONCAT(test_def_, __LINE__) = { (name), (fn), NULL }; \
+	__attribute__((constructor)) static void TEST_CONCAT(test_reg_, __LINE__)(void) \
+	{ \
+		test_register(&TEST_CONCAT(test_def_, __LINE__)); \
+	}
+
+#endif /* _HOST_TEST_H */
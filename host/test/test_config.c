@@ -0,0 +1,146 @@
+/*********************************************************************************/
+/* Module Name:  test_config.c                                                   */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <config/config.h>
+#include <loader/loader.h>
+#include <lib/string.h>
+#include <test.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// config_parse() tokenizes in place and needs buffer[size] for the last NUL
+static int parse(const char *text, char *buffer, size_t buffer_size, struct config *config)
+{
+	size_t size = strlen(text);
+
+	if (size >= buffer_size) {
+		return -1;
+	}
+
+	memcpy(buffer, (void *)text, size + 1);
+	return config_parse(buffer, size, config);
+}
+
+static bool str_eq(const char *a, const char *b)
+{
+	return a != NULL && strlen(a) == strlen(b) && memcmp(a, b, strlen(b)) == 0;
+}
+
+static void test_config_parse(void)
+{
+	static const char text[] =
+		"; global settings\n"
+		"TIMEOUT=3\n"
+		"DEFAULT_ENTRY=\"Second\"\n"
+		"SERIAL_PORT=COM2\n"
+		"SERIAL_BAUD=115200\n"
+		"VIDEO_MODE=1024x768\n"
+		"SPLASH_IMAGE=boot:///axboot/splash.bmp\n"
+		"\n"
+		"entry \"First\" {\n"
+		"\tPROTOCOL=aurix\n"
+		"\tIMAGE_PATH=boot:///System/axkrnl\n"
+		"}\n"
+		"entry \"Second\"\n"
+		"{\n"
+		"\tPROTOCOL=linux ; trailing comment\n"
+		"\tIMAGE_PATH=\"/boot/vmlinuz\"\n"
+		"\tMODULE_PATH=/boot/initrd\n"
+		"\tMODULE_PATH=/boot/ucode}\n";
+	static char buffer[1024];
+	struct config config;
+
+	CHECK_EQ(parse(text, buffer, sizeof(buffer), &config), 0);
+
+	CHECK_EQ(config.timeout, 3);
+	CHECK_EQ(config.serial_port, 2);
+	CHECK_EQ(config.serial_baud, 115200);
+	CHECK_EQ(config.video_mode, ConfigVideoFixed);
+	CHECK_EQ(config.video_width, 1024);
+	CHECK_EQ(config.video_height, 768);
+	CHECK(str_eq(config.splash_path, "\\axboot\\splash.bmp"));
+
+	CHECK_EQ(config.entry_count, 2);
+	CHECK_EQ(config.default_entry, 1);
+
+	CHECK(str_eq(config.entries[0].name, "First"));
+	CHECK_EQ(config.entries[0].protocol, ProtocolAbp);
+	CHECK(str_eq(config.entries[0].image_path, "\\System\\axkrnl"));
+	CHECK_EQ(config.entries[0].module_count, 0);
+
+	CHECK(str_eq(config.entries[1].name, "Second"));
+	CHECK_EQ(config.entries[1].protocol, ProtocolLinux);
+	CHECK(str_eq(config.entries[1].image_path, "\\boot\\vmlinuz"));
+	CHECK_EQ(config.entries[1].module_count, 2);
+	CHECK(str_eq(config.entries[1].module_paths[0], "\\boot\\initrd"));
+	CHECK(str_eq(config.entries[1].module_paths[1], "\\boot\\ucode"));
+}
+TEST("config/parse", test_config_parse);
+
+static void test_config_defaults(void)
+{
+	static char buffer[64];
+	struct config config;
+
+	CHECK_EQ(parse("", buffer, sizeof(buffer), &config), 0);
+	CHECK_EQ(config.timeout, CONFIG_DEFAULT_TIMEOUT);
+	CHECK_EQ(config.default_entry, 0);
+	CHECK_EQ(config.serial_port, 0);
+	CHECK_EQ(config.video_mode, ConfigVideoFirmware);
+	CHECK(config.splash_path == NULL);
+	CHECK_EQ(config.entry_count, 0);
+
+	CHECK_EQ(parse("SERIAL_PORT=0x2f8\nVIDEO_MODE=headless", buffer, sizeof(buffer), &config), 0);
+	CHECK_EQ(config.serial_port, 0x2f8);
+	CHECK_EQ(config.video_mode, ConfigVideoHeadless);
+}
+TEST("config/defaults", test_config_defaults);
+
+static void test_config_errors(void)
+{
+	static const char text[] =
+		"TIMEOUT=soon\n"                  // invalid number
+		"SERIAL_PORT=0x10000\n"           // out of range
+		"BOGUS=1\n"                       // unknown key
+		"PROTOCOL=aurix\n"                // entry key outside of an entry
+		"entry \"NoImage\" {\n"
+		"\tPROTOCOL=aurix\n"
+		"}\n"                             // dropped: no IMAGE_PATH
+		"entry \"Good\" {\n"
+		"\tPROTOCOL=abp\n"
+		"\tIMAGE_PATH=C:\\kernel\n"       // unsupported URI
+		"\tIMAGE_PATH=/kernel\n"
+		"}\n"
+		"DEFAULT_ENTRY=Missing\n";        // no such entry
+	static char buffer[512];
+	struct config config;
+
+	CHECK_EQ(parse(text, buffer, sizeof(buffer), &config), 7);
+
+	CHECK_EQ(config.timeout, CONFIG_DEFAULT_TIMEOUT);
+	CHECK_EQ(config.serial_port, 0);
+	CHECK_EQ(config.default_entry, 0);
+
+	CHECK_EQ(config.entry_count, 1);
+	CHECK(str_eq(config.entries[0].name, "Good"));
+	CHECK(str_eq(config.entries[0].image_path, "\\kernel"));
+}
+TEST("config/errors", test_config_errors);
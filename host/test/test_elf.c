@@ -0,0 +1,211 @@
+/*********************************************************************************/
+/* Module Name:  test_elf.c                                                      */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <loader/elf.h>
+#include <lib/string.h>
+#include <axboot.h>
+#include <test.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IMAGE_SIZE 0x2000
+#define DATA_OFFSET 0x1000
+#define SEGMENT_FILESZ 0x100
+#define SEGMENT_MEMSZ 0x300
+
+// An ELF64 executable with one PT_LOAD segment loaded at dest, half of it
+// bss, and a PT_NOTE segment holding an "AxBoot" note and a "GNU" note.
+static uint8_t *build_elf(uint8_t *dest)
+{
+	uint8_t *image = host_alloc(4096, IMAGE_SIZE);
+	size_t notes = sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr);
+	size_t offset = notes;
+
+	memset(image, 0, IMAGE_SIZE);
+
+	Elf64_Ehdr *ehdr = (Elf64_Ehdr *)image;
+	ehdr->e_ident[EI_MAG0] = ELFMAG0;
+	ehdr->e_ident[EI_MAG1] = ELFMAG1;
+	ehdr->e_ident[EI_MAG2] = ELFMAG2;
+	ehdr->e_ident[EI_MAG3] = ELFMAG3;
+	ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+	ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr->e_type = ET_EXEC;
+	ehdr->e_machine = EM_X86_64;
+	ehdr->e_version = EV_CURRENT;
+	ehdr->e_entry = (uint64_t)dest + 0x10;
+	ehdr->e_phoff = sizeof(Elf64_Ehdr);
+	ehdr->e_phentsize = sizeof(Elf64_Phdr);
+	ehdr->e_phnum = 2;
+
+	Elf64_Phdr *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+	phdrs[0].p_type = PT_LOAD;
+	phdrs[0].p_offset = DATA_OFFSET;
+	phdrs[0].p_paddr = (uint64_t)dest;
+	phdrs[0].p_vaddr = phdrs[0].p_paddr;
+	phdrs[0].p_filesz = SEGMENT_FILESZ;
+	phdrs[0].p_memsz = SEGMENT_MEMSZ;
+	for (int i = 0; i < SEGMENT_FILESZ; i++) {
+		image[DATA_OFFSET + i] = i + 1;
+	}
+
+	// "AxBoot" note, type 0x100, 8 byte descriptor
+	Elf64_Nhdr *note = (Elf64_Nhdr *)(image + offset);
+	note->n_namesz = 7;
+	note->n_descsz = 8;
+	note->n_type = 0x100;
+	memcpy(image + offset + sizeof(Elf64_Nhdr), "AxBoot", 7);
+	*(uint64_t *)(image + offset + sizeof(Elf64_Nhdr) + 8) = 0x1122334455667788ull;
+	offset += sizeof(Elf64_Nhdr) + 8 + 8;
+
+	// someone else's note, must be skipped
+	note = (Elf64_Nhdr *)(image + offset);
+	note->n_namesz = 4;
+	note->n_descsz = 4;
+	note->n_type = 0x100;
+	memcpy(image + offset + sizeof(Elf64_Nhdr), "GNU", 4);
+	offset += sizeof(Elf64_Nhdr) + 4 + 4;
+
+	phdrs[1].p_type = PT_NOTE;
+	phdrs[1].p_offset = notes;
+	phdrs[1].p_filesz = offset - notes;
+
+	return image;
+}
+
+static void test_elf_load(void)
+{
+	uint8_t *dest = host_alloc(4096, 4096);
+	uint8_t *image = build_elf(dest);
+	void *entry = NULL;
+
+	memset(dest, 0xee, 4096);
+	CHECK(elf_load(image, &entry));
+	CHECK(entry == dest + 0x10);
+
+	for (int i = 0; i < SEGMENT_FILESZ; i++) {
+		CHECK_EQ(dest[i], (uint8_t)(i + 1));
+	}
+
+	// bss is cleared, nothing past p_memsz is touched
+	for (int i = SEGMENT_FILESZ; i < SEGMENT_MEMSZ; i++) {
+		CHECK_EQ(dest[i], 0);
+	}
+	CHECK_EQ(dest[SEGMENT_MEMSZ], 0xee);
+
+	host_free(image);
+	host_free(dest);
+}
+TEST("elf/load", test_elf_load);
+
+static void test_elf_invalid(void)
+{
+	uint8_t *dest = host_alloc(4096, 4096);
+	uint8_t *image = build_elf(dest);
+	void *entry = NULL;
+
+	image[EI_MAG1] = 'x';
+	CHECK_EQ(elf_validate_header((Elf32_Ehdr *)image), -1);
+	CHECK(!elf_load(image, &entry));
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "AxBoot", NULL, NULL), -1);
+	image[EI_MAG1] = ELFMAG1;
+
+	((Elf64_Ehdr *)image)->e_type = ET_DYN;
+	CHECK_EQ(elf_validate_header((Elf32_Ehdr *)image), -1);
+	((Elf64_Ehdr *)image)->e_type = ET_EXEC;
+
+	CHECK_EQ(elf_validate_header((Elf32_Ehdr *)image), 0);
+	CHECK_EQ(elf_validate_header(NULL), -1);
+
+	host_free(image);
+	host_free(dest);
+}
+TEST("elf/invalid", test_elf_invalid);
+
+struct note_result {
+	int count;
+	uint32_t type;
+	uint32_t descsz;
+	uint64_t desc;
+};
+
+static void record_note(uint32_t type, void *desc, uint32_t descsz, void *ctx)
+{
+	struct note_result *result = ctx;
+
+	result->count++;
+	result->type = type;
+	result->descsz = descsz;
+	memcpy(&result->desc, desc, sizeof(result->desc));
+}
+
+static void test_elf_notes(void)
+{
+	uint8_t *dest = host_alloc(4096, 4096);
+	uint8_t *image = build_elf(dest);
+	struct note_result result = {0};
+
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "AxBoot", record_note, &result), 1);
+	CHECK_EQ(result.count, 1);
+	CHECK_EQ(result.type, 0x100);
+	CHECK_EQ(result.descsz, 8);
+	CHECK_EQ(result.desc, 0x1122334455667788ull);
+
+	memset(&result, 0, sizeof(result));
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "Linux", record_note, &result), 0);
+	CHECK_EQ(result.count, 0);
+
+	host_free(image);
+	host_free(dest);
+}
+TEST("elf/parse_notes", test_elf_notes);
+
+static void test_elf_notes_truncated(void)
+{
+	uint8_t *dest = host_alloc(4096, 4096);
+	uint8_t *image = build_elf(dest);
+	Elf64_Ehdr *ehdr = (Elf64_Ehdr *)image;
+	Elf64_Phdr *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+	struct note_result result = {0};
+
+	// cut off inside the ELF header, then inside the program headers
+	CHECK_EQ(elf_parse_notes(image, sizeof(Elf32_Ehdr) - 1, "AxBoot", record_note, &result), -1);
+	CHECK_EQ(elf_parse_notes(image, ehdr->e_phoff + sizeof(Elf64_Phdr), "AxBoot", record_note, &result), -1);
+
+	// a note segment reaching past the end of the file
+	CHECK_EQ(elf_parse_notes(image, phdrs[1].p_offset + phdrs[1].p_filesz - 1, "AxBoot", record_note, &result), -1);
+	phdrs[1].p_offset = IMAGE_SIZE;
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "AxBoot", record_note, &result), -1);
+	phdrs[1].p_offset = ~0ull - 4;
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "AxBoot", record_note, &result), -1);
+	CHECK_EQ(result.count, 0);
+
+	// section headers past the end
+	phdrs[1].p_type = PT_NULL;
+	ehdr->e_shoff = IMAGE_SIZE - sizeof(Elf64_Shdr);
+	ehdr->e_shentsize = sizeof(Elf64_Shdr);
+	ehdr->e_shnum = 2;
+	CHECK_EQ(elf_parse_notes(image, IMAGE_SIZE, "AxBoot", record_note, &result), -1);
+
+	host_free(image);
+	host_free(dest);
+}
+TEST("elf/parse_notes_truncated", test_elf_notes_truncated);
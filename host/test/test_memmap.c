@@ -0,0 +1,161 @@
+/*********************************************************************************/
+/* Module Name:  test_memmap.c                                                   */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <firmware/memmap.h>
+#include <lib/numa.h>
+#include <lib/string.h>
+#include <axboot.h>
+#include <test.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static void set_entry(struct memory_map_entry *entry, uint64_t base, uint64_t length, uint16_t type)
+{
+	entry->base = base;
+	entry->length = length;
+	entry->type = type;
+	entry->flags = 0;
+	entry->proximity = MEMMAP_NO_PROXIMITY;
+}
+
+static void check_entry(struct memory_map_entry *entry, uint64_t base, uint64_t length, uint16_t type)
+{
+	CHECK_EQ(entry->base, base);
+	CHECK_EQ(entry->length, length);
+	CHECK_EQ(entry->type, type);
+}
+
+static void test_memmap_normalize(void)
+{
+	struct memory_map_entry entries[8];
+	struct memory_map_info memmap = { entries, 8 };
+
+	// out of order, an empty entry, adjacent and overlapping neighbours
+	set_entry(&entries[0], 0x3000, 0x1000, MemoryMapUsable);
+	set_entry(&entries[1], 0x0000, 0x1000, MemoryMapReserved);
+	set_entry(&entries[2], 0x1000, 0x2000, MemoryMapUsable);
+	set_entry(&entries[3], 0x5000, 0x0000, MemoryMapUsable);
+	set_entry(&entries[4], 0x3800, 0x1000, MemoryMapUsable);
+	set_entry(&entries[5], 0x4800, 0x0800, MemoryMapAcpiNVS);
+	set_entry(&entries[6], 0x8000, 0x1000, MemoryMapUsable);
+	set_entry(&entries[7], 0x6000, 0x1000, MemoryMapUsable);
+
+	memmap_normalize(&memmap);
+
+	CHECK_EQ(memmap.entry_count, 5);
+	check_entry(&entries[0], 0x0000, 0x1000, MemoryMapReserved);
+	check_entry(&entries[1], 0x1000, 0x3800, MemoryMapUsable);
+	check_entry(&entries[2], 0x4800, 0x0800, MemoryMapAcpiNVS);
+	// a hole keeps entries apart
+	check_entry(&entries[3], 0x6000, 0x1000, MemoryMapUsable);
+	check_entry(&entries[4], 0x8000, 0x1000, MemoryMapUsable);
+}
+TEST("memmap/normalize", test_memmap_normalize);
+
+static void test_memmap_normalize_attributes(void)
+{
+	struct memory_map_entry entries[4];
+	struct memory_map_info memmap = { entries, 4 };
+
+	// same type, but mirroring and NUMA domains must stay distinct
+	set_entry(&entries[0], 0x0000, 0x1000, MemoryMapUsable);
+	set_entry(&entries[1], 0x1000, 0x1000, MemoryMapUsable);
+	entries[1].flags = MEMMAP_FLAG_MIRRORED;
+	set_entry(&entries[2], 0x2000, 0x1000, MemoryMapUsable);
+	entries[2].flags = MEMMAP_FLAG_MIRRORED;
+	entries[2].proximity = 1;
+	set_entry(&entries[3], 0x3000, 0x1000, MemoryMapUsable);
+	entries[3].flags = MEMMAP_FLAG_MIRRORED;
+	entries[3].proximity = 1;
+
+	memmap_normalize(&memmap);
+
+	CHECK_EQ(memmap.entry_count, 3);
+	check_entry(&entries[0], 0x0000, 0x1000, MemoryMapUsable);
+	CHECK_EQ(entries[0].flags, 0);
+	check_entry(&entries[1], 0x1000, 0x1000, MemoryMapUsable);
+	CHECK_EQ(entries[1].proximity, MEMMAP_NO_PROXIMITY);
+	check_entry(&entries[2], 0x2000, 0x2000, MemoryMapUsable);
+	CHECK_EQ(entries[2].proximity, 1);
+
+	memmap.entry_count = 0;
+	memmap_normalize(&memmap);
+	CHECK_EQ(memmap.entry_count, 0);
+}
+TEST("memmap/normalize_attributes", test_memmap_normalize_attributes);
+
+static void test_memmap_split_numa(void)
+{
+	static const struct numa_range ranges[] = {
+		{ 0x0000, 0x3000, 0 },
+		{ 0x3000, 0x2000, 1 },
+	};
+	struct memory_map_info memmap;
+
+	// the split map replaces the original, which has to come from malloc()
+	memmap.entries = malloc(2 * sizeof(struct memory_map_entry));
+	memmap.entry_count = 2;
+	set_entry(&memmap.entries[0], 0x1000, 0x4000, MemoryMapUsable);
+	set_entry(&memmap.entries[1], 0x5000, 0x1000, MemoryMapReserved);
+
+	memmap_split_numa(&memmap, ranges, ARRAY_LENGTH(ranges));
+
+	CHECK_EQ(memmap.entry_count, 3);
+	check_entry(&memmap.entries[0], 0x1000, 0x2000, MemoryMapUsable);
+	CHECK_EQ(memmap.entries[0].proximity, 0);
+	check_entry(&memmap.entries[1], 0x3000, 0x2000, MemoryMapUsable);
+	CHECK_EQ(memmap.entries[1].proximity, 1);
+	// outside of every range
+	check_entry(&memmap.entries[2], 0x5000, 0x1000, MemoryMapReserved);
+	CHECK_EQ(memmap.entries[2].proximity, MEMMAP_NO_PROXIMITY);
+
+	free(memmap.entries);
+}
+TEST("memmap/split_numa", test_memmap_split_numa);
+
+static void test_memmap_split_numa_overlapping(void)
+{
+	static const struct numa_range ranges[] = {
+		{ 0x0000, 0x1000, 0 },
+		{ 0x1000, 0x1000, 1 },
+		{ 0x2000, 0x1000, 2 },
+	};
+	struct memory_map_info memmap;
+
+	// overlapping entries that each span every range split into more
+	// pieces than there are range boundaries, none may be lost
+	memmap.entries = malloc(4 * sizeof(struct memory_map_entry));
+	memmap.entry_count = 4;
+	for (int i = 0; i < 4; i++) {
+		set_entry(&memmap.entries[i], 0x0000, 0x3000, MemoryMapUsable);
+	}
+
+	memmap_split_numa(&memmap, ranges, ARRAY_LENGTH(ranges));
+
+	CHECK_EQ(memmap.entry_count, 12);
+	for (int i = 0; i < 12; i++) {
+		check_entry(&memmap.entries[i], (i % 3) * 0x1000, 0x1000, MemoryMapUsable);
+		CHECK_EQ(memmap.entries[i].proximity, i % 3);
+	}
+
+	free(memmap.entries);
+}
+TEST("memmap/split_numa_overlapping", test_memmap_split_numa_overlapping);
@@ -0,0 +1,267 @@
+/*********************************************************************************/
+/* Module Name:  test_paging.c                                                   */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <arch/mm/paging.h>
+#include <firmware/memmap.h>
+#include <lib/string.h>
+#include <test.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARENA_SIZE (16ull * 1024 * 1024)
+#define MAPPED_BASE 0x100000000ull
+#define NOT_MAPPED (~0ull)
+
+//
+// Like the paging benchmarks, page tables are built in a host arena that
+// stands in for usable memory. Only the arena is ever written to; the
+// tables are checked by walking them in software.
+//
+
+static uint8_t *arena = NULL;
+
+static void setup_memmap(struct memory_map_info *memmap, struct memory_map_entry *entries, uint64_t mapped_size)
+{
+	if (arena == NULL) {
+		arena = host_alloc(PAGE_SIZE_2M, ARENA_SIZE);
+	}
+
+	entries[0].base = 0;
+	entries[0].length = PAGE_SIZE;
+	entries[0].type = MemoryMapReserved;
+	entries[0].flags = 0;
+	entries[0].proximity = MEMMAP_NO_PROXIMITY;
+
+	entries[1].base = (uint64_t)arena;
+	entries[1].length = ARENA_SIZE;
+	entries[1].type = MemoryMapUsable;
+	entries[1].flags = 0;
+	entries[1].proximity = MEMMAP_NO_PROXIMITY;
+
+	entries[2].base = MAPPED_BASE;
+	entries[2].length = mapped_size;
+	entries[2].type = MemoryMapAcpiNVS;
+	entries[2].flags = 0;
+	entries[2].proximity = MEMMAP_NO_PROXIMITY;
+
+	memmap->entries = entries;
+	memmap->entry_count = 3;
+}
+
+// Physical address virt translates to, NOT_MAPPED if it doesn't
+static uint64_t translate(uint64_t virt)
+{
+	struct page_table *table = (struct page_table *)paging_get_pml4();
+
+	for (int level = 0; level < 4; level++) {
+		int shift = 39 - (level * 9);
+		uint64_t entry = table->entries[(virt >> shift) & 0x1ff];
+
+		if (!(entry & PTE_PRESENT)) {
+			return NOT_MAPPED;
+		}
+
+		if (level == 3 || (level > 0 && (entry & PTE_PAGE_SIZE))) {
+			uint64_t offset_mask = (1ull << shift) - 1;
+			return (entry & PHYS_PAGE_ADDR_MASK & ~offset_mask) | (virt & offset_mask);
+		}
+
+		table = (struct page_table *)(entry & PHYS_PAGE_ADDR_MASK);
+	}
+
+	return NOT_MAPPED;
+}
+
+static bool in_arena(uint64_t address)
+{
+	return address >= (uint64_t)arena && address < (uint64_t)arena + ARENA_SIZE;
+}
+
+static void test_paging_init(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+	struct paging_stats stats;
+
+	setup_memmap(&memmap, entries, 4 * PAGE_SIZE);
+	CHECK_EQ(paging_init(&memmap, HHDM_DEFAULT_BASE, 0), 0);
+
+	// tables come out of the usable entry
+	CHECK(in_arena(paging_get_pml4()));
+
+	CHECK_EQ(translate(MAPPED_BASE), MAPPED_BASE);
+	CHECK_EQ(translate(MAPPED_BASE + 3 * PAGE_SIZE + 0x123), MAPPED_BASE + 3 * PAGE_SIZE + 0x123);
+	CHECK_EQ(translate(MAPPED_BASE + 4 * PAGE_SIZE), NOT_MAPPED);
+	CHECK_EQ(translate(HHDM_DEFAULT_BASE + MAPPED_BASE + 0x10), MAPPED_BASE + 0x10);
+	CHECK_EQ(translate((uint64_t)arena + ARENA_SIZE - 1), (uint64_t)arena + ARENA_SIZE - 1);
+	CHECK_EQ(translate(0), 0);
+
+	paging_get_stats(&stats);
+	CHECK_EQ(stats.tables[0], 1);
+	CHECK_EQ(paging_get_table_pages(), stats.tables[0] + stats.tables[1] + stats.tables[2] + stats.tables[3]);
+	CHECK_EQ(stats.identity_tables + stats.hhdm_tables + 1, paging_get_table_pages());
+}
+TEST("paging/init", test_paging_init);
+
+static void test_paging_init_2m(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+	struct paging_stats stats;
+
+	// 2 MiB pages where aligned, 4 KiB pages for the tail
+	setup_memmap(&memmap, entries, 2 * PAGE_SIZE_2M + PAGE_SIZE);
+	CHECK_EQ(paging_init(&memmap, 0, PAGING_PAGE_2M), 0);
+
+	CHECK_EQ(translate(MAPPED_BASE + PAGE_SIZE_2M + 0x12345), MAPPED_BASE + PAGE_SIZE_2M + 0x12345);
+	CHECK_EQ(translate(MAPPED_BASE + 2 * PAGE_SIZE_2M + 0x10), MAPPED_BASE + 2 * PAGE_SIZE_2M + 0x10);
+	CHECK_EQ(translate(MAPPED_BASE + 2 * PAGE_SIZE_2M + PAGE_SIZE), NOT_MAPPED);
+
+	// pages inside a large page are already mapped, that's not a failure
+	CHECK_EQ(paging_identity_map(MAPPED_BASE + PAGE_SIZE), 0);
+
+	// the arena is 2 MiB aligned; only the first page of memory and the
+	// tail of the mapped range need a page table
+	paging_get_stats(&stats);
+	CHECK_EQ(stats.tables[3], 2);
+}
+TEST("paging/init_2m", test_paging_init_2m);
+
+static void test_paging_map(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+
+	setup_memmap(&memmap, entries, 0);
+	CHECK_EQ(paging_init(&memmap, 0, 0), 0);
+
+	paging_map(MAPPED_BASE + 0x5000, HHDM_DEFAULT_BASE + 0x1000);
+	CHECK_EQ(translate(HHDM_DEFAULT_BASE + 0x1abc), MAPPED_BASE + 0x5abc);
+	CHECK_EQ(translate(HHDM_DEFAULT_BASE), NOT_MAPPED);
+
+	// existing mappings are left alone
+	paging_map(MAPPED_BASE + 0x9000, HHDM_DEFAULT_BASE + 0x1000);
+	CHECK_EQ(translate(HHDM_DEFAULT_BASE + 0x1000), MAPPED_BASE + 0x5000);
+
+	paging_identity_map(MAPPED_BASE + 0x7000);
+	CHECK_EQ(translate(MAPPED_BASE + 0x7000), MAPPED_BASE + 0x7000);
+
+	paging_map_range(MAPPED_BASE + 0x10010, 0xffffffff80000000ull, 2 * PAGE_SIZE);
+	CHECK_EQ(translate(0xffffffff80000000ull), MAPPED_BASE + 0x10000);
+	CHECK_EQ(translate(0xffffffff80002000ull), MAPPED_BASE + 0x12000);
+}
+TEST("paging/map", test_paging_map);
+
+static void test_paging_allocate(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+	uint8_t *a;
+	uint8_t *b;
+
+	setup_memmap(&memmap, entries, 0);
+	CHECK_EQ(paging_init(&memmap, 0, 0), 0);
+
+	a = paging_allocate(4);
+	b = paging_allocate(1);
+	CHECK(a != NULL && b != NULL);
+	CHECK(in_arena((uint64_t)a) && in_arena((uint64_t)b));
+	CHECK(b >= a + 4 * PAGE_SIZE || a >= b + PAGE_SIZE);
+	CHECK((uint64_t)a != paging_get_pml4() && (uint64_t)b != paging_get_pml4());
+
+	// more than there is
+	CHECK(paging_allocate(ARENA_SIZE / PAGE_SIZE + 1) == NULL);
+}
+TEST("paging/allocate", test_paging_allocate);
+
+static void test_paging_out_of_memory(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+
+	// room for the usage counters and the PML4, but not for a PDPT
+	setup_memmap(&memmap, entries, PAGE_SIZE);
+	entries[1].length = 2 * PAGE_SIZE;
+	CHECK(paging_init(&memmap, 0, 0) != 0);
+
+	// once the tables are built, mapping somewhere new can still run out
+	setup_memmap(&memmap, entries, 0);
+	CHECK_EQ(paging_init(&memmap, 0, 0), 0);
+	while (paging_allocate(1) != NULL);
+	CHECK(paging_map(MAPPED_BASE, HHDM_DEFAULT_BASE) != 0);
+	CHECK(paging_map_range(MAPPED_BASE, HHDM_DEFAULT_BASE, PAGE_SIZE) != 0);
+
+	// and already mapped pages don't need anything
+	CHECK_EQ(paging_identity_map((uint64_t)arena), 0);
+}
+TEST("paging/out_of_memory", test_paging_out_of_memory);
+
+static void test_paging_low_memory(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+	uint8_t *page;
+
+	// real firmware reports usable memory from physical 0 up; it's the
+	// first entry, but nothing may be placed in it
+	setup_memmap(&memmap, entries, 0);
+	entries[0].length = 0x100000;
+	entries[0].type = MemoryMapUsable;
+
+	CHECK_EQ(paging_init(&memmap, 0, 0), 0);
+	CHECK(in_arena(paging_get_pml4()));
+	CHECK_EQ(translate(0x1000), 0x1000);
+
+	page = paging_allocate(1);
+	CHECK(page != NULL && in_arena((uint64_t)page));
+}
+TEST("paging/low_memory", test_paging_low_memory);
+
+static void test_paging_allocate_tiers(void)
+{
+	struct memory_map_entry entries[3];
+	struct memory_map_info memmap;
+	uint64_t half = ARENA_SIZE / 2;
+	uint8_t *page;
+
+	// the first half of the arena is remote, a single page is local
+	setup_memmap(&memmap, entries, 0);
+	entries[1].length = half;
+	entries[1].proximity = 0;
+	entries[2].base = (uint64_t)arena + half;
+	entries[2].length = PAGE_SIZE;
+	entries[2].type = MemoryMapUsable;
+	entries[2].proximity = 1;
+
+	// the PML4 takes the local page, every other table has to go back to
+	// the earlier, remote entry
+	paging_set_preferred_proximity(1);
+	CHECK_EQ(paging_init(&memmap, 0, 0), 0);
+	CHECK_EQ(paging_get_pml4(), entries[2].base);
+	CHECK_EQ(translate(entries[1].base), entries[1].base);
+
+	page = paging_allocate(1);
+	CHECK(page != NULL);
+	CHECK((uint64_t)page >= entries[1].base && (uint64_t)page < entries[1].base + half);
+
+	paging_set_preferred_proximity(MEMMAP_NO_PROXIMITY);
+}
+TEST("paging/allocate_tiers", test_paging_allocate_tiers);
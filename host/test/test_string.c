@@ -0,0 +1,104 @@
+/*********************************************************************************/
+/* Module Name:  test_string.c                                                   */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <lib/string.h>
+#include <test.h>
+#include <host.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+static void test_memcpy(void)
+{
+	uint8_t src[64];
+	uint8_t dest[64];
+
+	for (int i = 0; i < 64; i++) {
+		src[i] = i;
+	}
+
+	// unaligned start and odd length, with guard bytes on either side
+	memset(dest, 0xee, sizeof(dest));
+	CHECK(memcpy(dest + 3, src + 1, 37) == dest + 3);
+	CHECK_EQ(dest[2], 0xee);
+	for (int i = 0; i < 37; i++) {
+		CHECK_EQ(dest[3 + i], i + 1);
+	}
+	CHECK_EQ(dest[40], 0xee);
+
+	memcpy(dest, src, 0);
+	CHECK_EQ(dest[0], 0xee);
+}
+TEST("string/memcpy", test_memcpy);
+
+static void test_memset(void)
+{
+	uint8_t buf[32];
+
+	memset(buf, 0, sizeof(buf));
+	CHECK(memset(buf + 1, 0x1a5, 30) == buf + 1);
+	CHECK_EQ(buf[0], 0);
+	for (int i = 1; i < 31; i++) {
+		CHECK_EQ(buf[i], 0xa5);
+	}
+	CHECK_EQ(buf[31], 0);
+}
+TEST("string/memset", test_memset);
+
+static void test_memcmp(void)
+{
+	uint8_t a[16] = { 1, 2, 3, 4, 5 };
+	uint8_t b[16] = { 1, 2, 3, 4, 5 };
+
+	CHECK_EQ(memcmp(a, b, sizeof(a)), 0);
+	CHECK_EQ(memcmp(a, a, sizeof(a)), 0);
+	CHECK_EQ(memcmp(a, b, 0), 0);
+
+	// bytes compare unsigned
+	b[4] = 0x80;
+	CHECK(memcmp(a, b, sizeof(a)) < 0);
+	CHECK(memcmp(b, a, sizeof(a)) > 0);
+	CHECK_EQ(memcmp(a, b, 4), 0);
+}
+TEST("string/memcmp", test_memcmp);
+
+static void test_strlen(void)
+{
+	CHECK_EQ(strlen(""), 0);
+	CHECK_EQ(strlen("a"), 1);
+	CHECK_EQ(strlen("AxBoot"), 6);
+	CHECK_EQ(strlen(NULL), 0);
+}
+TEST("string/strlen", test_strlen);
+
+static void test_strcpy(void)
+{
+	char buf[16];
+
+	memset(buf, 'x', sizeof(buf));
+	CHECK(strcpy(buf, "boot") == buf);
+	CHECK_EQ(memcmp(buf, "boot", 5), 0);
+	CHECK_EQ(buf[5], 'x');
+
+	CHECK(strcpy(buf, "") == buf);
+	CHECK_EQ(buf[0], '\0');
+
+	CHECK(strcpy(NULL, "boot") == NULL);
+}
+TEST("string/strcpy", test_strcpy);
@@ -101,6 +101,37 @@ static inline void write_cr8(uint64_t val)
 					:: "r"(val));
 }
 
+static inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+	__asm__ volatile("cpuid"
+					: "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+					: "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+	uint32_t lo, hi;
+	__asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val)
+{
+	__asm__ volatile("wrmsr" :: "a"((uint32_t)val), "d"((uint32_t)(val >> 32)), "c"(msr) : "memory");
+}
+
+static inline void cpu_pause(void)
+{
+	__asm__ volatile("pause" ::: "memory");
+}
+
 static inline uint8_t inb(uint16_t port)
 {
 	uint8_t ret;
@@ -108,6 +139,13 @@ static inline uint8_t inb(uint16_t port)
 	return ret;
 }
 
+static inline uint32_t inl(uint16_t port)
+{
+	uint32_t ret;
+	__asm__ volatile("inl %w1, %0" : "=a"(ret) : "Nd"(port) : "memory");
+	return ret;
+}
+
 static inline void outb(uint16_t port, uint8_t val)
 {
 	__asm__ volatile("outb %b0, %w1" :: "a"(val), "Nd"(port) : "memory");
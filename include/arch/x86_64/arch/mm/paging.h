@@ -23,27 +23,54 @@
 #include <firmware/memmap.h>
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define PAGE_SIZE 0x1000
+#define PAGE_SIZE_2M 0x200000
+#define PAGE_SIZE_1G 0x40000000
 #define PHYS_PAGE_ADDR_MASK 0x000FFFFFFFFFF000
 
 struct page_table {
 	uint64_t entries[512];
 };
 
+struct paging_stats {
+	uint64_t tables[4];			// page tables by level: PML4, PDPT, PD, PT
+	uint64_t identity_tables;	// allocated while building the identity map
+	uint64_t hhdm_tables;		// allocated while building the HHDM
+};
+
 // pte flags
 #define PTE_PRESENT (1)
 #define PTE_READ_WRITE (1 << 1)
 #define PTE_USER (1 << 2)
+#define PTE_PAGE_SIZE (1 << 7)
+
+// page sizes paging_map_range() may use besides 4 KiB
+#define PAGING_PAGE_2M (1 << 0)
+#define PAGING_PAGE_1G (1 << 1)
 
-int paging_init(struct memory_map_info *memmap);
+#define HHDM_DEFAULT_BASE 0xffff800000000000
 
-void paging_identity_map(uint64_t addr);
-void paging_map(uint64_t phys, uint64_t virt);
+int paging_init(struct memory_map_info *memmap, uint64_t hhdm_base, uint32_t page_sizes);
+
+// These return non-zero if there was no memory left for a page table;
+// pages that are already mapped are left alone
+int paging_identity_map(uint64_t addr);
+int paging_map(uint64_t phys, uint64_t virt);
+int paging_map_range(uint64_t phys, uint64_t virt, uint64_t length);
 void paging_unmap(uint64_t virt);
 
 uint64_t paging_get_pml4(void);
 
+// number of page table pages allocated since paging_init()
+uint64_t paging_get_table_pages(void);
+void paging_get_stats(struct paging_stats *stats);
+
 void *paging_allocate(size_t np);
 
+// Page tables and paging_allocate() prefer memory map entries in this
+// NUMA domain; MEMMAP_NO_PROXIMITY takes the first that fits
+void paging_set_preferred_proximity(uint32_t proximity);
+
 #endif /* _MM_PAGING_H */
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*********************************************************************************/
+/* Module Name:  binary.h                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _CONFIG_BINARY_H
+#define _CONFIG_BINARY_H
+
+#include <config/config.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Precompiled configuration, produced from axboot.cfg by axboot-cfgc.
+//
+// Layout: header, entry table, string pool. All offsets are relative to
+// the start of the image, strings are NUL-terminated, and protocols are
+// stored as resolved enum BootProtocol values.
+//
+
+#define CONFIG_BIN_MAGIC 0x46435841 // "AXCF"
+#define CONFIG_BIN_VERSION 5
+
+// The staleness check also checksums the text config on every boot;
+// otherwise only its size is compared
+#define CONFIG_BIN_VERIFY_SOURCE (1 << 0)
+
+struct config_bin_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t total_size;
+	uint32_t checksum; // CRC32 of everything after the header
+
+	// axboot.cfg this image was compiled from, used to detect stale images
+	uint32_t source_size;
+	uint32_t source_crc;
+	uint32_t flags;
+
+	uint32_t timeout;
+	uint32_t default_entry;
+	uint32_t serial_port;
+	uint32_t serial_baud;
+	uint32_t video_mode;
+	uint32_t video_width;
+	uint32_t video_height;
+	uint32_t splash_path; // 0 for none
+
+	uint32_t entry_count;
+	uint32_t entry_offset;
+	uint32_t strings_offset;
+	uint32_t strings_size;
+} __attribute__((packed));
+
+struct config_bin_entry {
+	uint32_t name;
+	uint32_t protocol;
+	uint32_t image_path;
+	uint32_t module_count;
+	uint32_t module_paths[CONFIG_MAX_MODULES];
+} __attribute__((packed));
+
+int config_load_binary(void *image, size_t size, struct config *config);
+
+#endif /* _CONFIG_BINARY_H */
@@ -20,6 +20,79 @@
 #ifndef _CONFIG_CONFIG_H
 #define _CONFIG_CONFIG_H
 
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONFIG_MAX_ENTRIES 64
+#define CONFIG_MAX_MODULES 8
+
+#define CONFIG_DEFAULT_TIMEOUT 5
+
+enum ConfigKey {
+	ConfigKeyUnknown,
+
+	// global keys
+	ConfigKeyTimeout,
+	ConfigKeyDefaultEntry,
+	ConfigKeySerialPort,
+	ConfigKeySerialBaud,
+	ConfigKeyVideoMode,
+	ConfigKeySplashImage,
+
+	// entry keys
+	ConfigKeyProtocol,
+	ConfigKeyImagePath,
+	ConfigKeyModulePath,
+};
+
+// how the GOP mode is picked
+enum ConfigVideo {
+	ConfigVideoFirmware, // keep the firmware's mode, or what the kernel asks for
+	ConfigVideoNative,   // the display's preferred mode from EDID
+	ConfigVideoFixed,    // video_width x video_height
+	ConfigVideoSmallest,
+	ConfigVideoHeadless, // no framebuffer at all
+};
+
+struct config_entry {
+	char *name;
+	int protocol;
+	char *image_path;
+	char *module_paths[CONFIG_MAX_MODULES];
+	uint32_t module_count;
+};
+
+struct config {
+	uint32_t timeout;
+	uint32_t default_entry;
+
+	// 0 picks them up from the ACPI SPCR or the firmware
+	uint32_t serial_port; // 1-4 for COM1-4, or an I/O port
+	uint32_t serial_baud;
+
+	uint32_t video_mode; // a ConfigVideo* value
+	uint32_t video_width;
+	uint32_t video_height;
+
+	char *splash_path; // NULL for no splash
+
+	struct config_entry entries[CONFIG_MAX_ENTRIES];
+	uint32_t entry_count;
+};
+
 void config_init(void);
 
-#endif /* _CONFIG_CONFIG_H */
\ No newline at end of file
+int config_parse(char *buffer, size_t size, struct config *config);
+
+uint32_t config_get_timeout(void);
+uint32_t config_get_serial_port(void);
+uint32_t config_get_serial_baud(void);
+uint32_t config_get_video_mode(void);
+void config_get_video_resolution(uint32_t *width, uint32_t *height);
+const char *config_get_splash_path(void);
+uint32_t config_get_entry_count(void);
+uint32_t config_get_default_index(void);
+struct config_entry *config_get_entry(uint32_t index);
+struct config_entry *config_get_default_entry(void);
+
+#endif /* _CONFIG_CONFIG_H */
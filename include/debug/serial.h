@@ -20,8 +20,26 @@
 #ifndef _DEBUG_SERIAL_H
 #define _DEBUG_SERIAL_H
 
-void serial_init(void);
+#include <stdint.h>
+#include <stddef.h>
+
+#define SERIAL_DEFAULT_BAUD 115200
+
+// Picks the port and baud rate: `port` is 1-4 for COM1-4 or an I/O port,
+// and either may be 0 to use the ACPI SPCR or the firmware's settings
+void serial_configure(uint32_t port, uint32_t baud);
+
+void serial_init(uint16_t port, uint32_t baud);
 void serial_send(char c);
 void serial_sendstr(char *s);
 
-#endif /* _DEBUG_SERIAL_H */
\ No newline at end of file
+// Text, with line endings turned into "\r\n"
+void serial_write(const char *s, size_t len);
+
+// Binary data, sent as is
+void serial_write_raw(const void *data, size_t len);
+
+// Stops going through the firmware, the UART is driven directly afterwards
+void serial_release_firmware(void);
+
+#endif /* _DEBUG_SERIAL_H */
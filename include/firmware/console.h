@@ -0,0 +1,51 @@
+/*********************************************************************************/
+/* Module Name:  console.h                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _FIRMWARE_CONSOLE_H
+#define _FIRMWARE_CONSOLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// fw_read_key() returns printable keys as their ASCII value
+#define KEY_NONE 0
+#define KEY_ENTER '\r'
+#define KEY_ESCAPE 0x1b
+#define KEY_UP 0x100
+#define KEY_DOWN 0x101
+
+void fw_console_init(void);
+void fw_console_clear(void);
+void fw_console_set_cursor(uint32_t column, uint32_t row);
+
+int fw_read_key(void);
+
+enum {
+	FwEventNone,
+	FwEventKey,
+	FwEventTimer,
+};
+
+int fw_timer_start(uint32_t period_ms);
+void fw_timer_stop(void);
+int fw_wait_event(bool block, int *key);
+
+void fw_stall(uint64_t microseconds);
+
+#endif /* _FIRMWARE_CONSOLE_H */
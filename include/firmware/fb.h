@@ -22,7 +22,44 @@
 
 #include <stdint.h>
 
+#define FW_MAX_VIDEO_MODES 128
+
+// pixel_format is 1 for RGBA and 2 for BGRA, modes without a linear
+// framebuffer aren't listed
+struct fw_video_mode {
+	uint32_t number; // GOP mode number
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint16_t bpp;
+	uint8_t pixel_format;
+};
+
+// Picks the mode fw_initialize_fb() sets up, policy is a ConfigVideo*
+// value. Only width and height of ConfigVideoFixed are looked at.
+void fw_set_fb_policy(int policy, uint32_t width, uint32_t height);
+
+// Enumerates the modes once and applies the policy; only calls SetMode()
+// when the policy asks for something other than the current mode
 int fw_initialize_fb(void);
+int fw_set_fb_resolution(uint32_t width, uint32_t height);
 void fw_get_framebuffer(void **address, uint32_t *width, uint32_t *height, uint16_t *bpp, uint8_t *pixelformat);
 
+// Bytes per scanline, which may be more than width * bpp / 8
+uint32_t fw_get_fb_pitch(void);
+
+// Copies a BGRX image to the screen in one Blt(), whatever the framebuffer's
+// own pixel format is
+int fw_fb_blt(const uint32_t *pixels, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+// The cached mode list, *current is the index of the active mode
+const struct fw_video_mode *fw_get_fb_modes(uint32_t *count, uint32_t *current);
+
+#define FW_GLYPH_MAX_WIDTH 16
+#define FW_GLYPH_MAX_HEIGHT 32
+
+// Rasterizes a character with the firmware's font. Bit (15 - x) of rows[y]
+// is set where the glyph is drawn.
+int fw_get_glyph(uint32_t ch, uint16_t rows[FW_GLYPH_MAX_HEIGHT], uint32_t *width, uint32_t *height);
+
 #endif /* _FIRMWARE_FB_H */
\ No newline at end of file
@@ -21,6 +21,7 @@
 #define _FIRMWARE_FILE_H
 
 #include <arch/firmware/file.h>
+#include <stdint.h>
 #include <stddef.h>
 
 FILE *fw_file_open(FILE *directory, const char *path);
@@ -22,6 +22,10 @@
 
 void fw_prepare_handoff(void);
 
+// Allocates the memory map buffer needed to leave the firmware; has to be
+// called before the kernel's memory map is taken
+void fw_reserve_exit_map(void);
+
 void uefi_exit_boot_services(void);
 
 #endif /* _FIRMWARE_HANDOFF_H */
\ No newline at end of file
@@ -20,7 +20,63 @@
 #ifndef _FIRMWARE_HWMGMT_H
 #define _FIRMWARE_HWMGMT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// Firmware boot phases from the ACPI FPDT, in nanoseconds; 0 if not recorded
+struct fw_boot_performance {
+	uint64_t reset_end;
+	uint64_t os_loader_load_image_start;
+	uint64_t os_loader_start_image_start;
+	uint64_t exit_boot_services_entry;
+	uint64_t exit_boot_services_exit;
+};
+
+// EFI configuration tables the loader knows about
+enum {
+	FwTableAcpi10,
+	FwTableAcpi20,
+	FwTableSmbios,
+	FwTableSmbios3,
+	FwTableDtb,
+	FwTableEsrt,
+	FwTableMemoryAttributes,
+	FwTableRngSeed,
+	FwTableCount,
+};
+
+// NULL if the firmware doesn't install the table
+void *fw_get_config_table(int table);
+
+// Prefer ACPI 2.0 over 1.0 and SMBIOS 3 over 2, whatever order the
+// firmware lists them in
 void *fw_get_acpi_rsdp(void);
+void *fw_get_acpi_table(const char *signature);
 void *fw_get_smbios_entry_point(void);
 
+// Serial console from the ACPI SPCR; baud is 0 if it should be left as is
+bool fw_get_spcr_port(uint16_t *port, uint32_t *baud);
+
+// A processor as the firmware's MP services report it
+#define FW_CPU_BSP (1 << 0)
+#define FW_CPU_ENABLED (1 << 1)
+#define FW_CPU_HEALTHY (1 << 2)
+
+struct fw_cpu {
+	uint32_t apic_id;
+	uint32_t flags;
+	uint32_t package;
+	uint32_t core;
+	uint32_t thread;
+};
+
+// Every processor the firmware initialized, read once; NULL without MP services
+const struct fw_cpu *fw_get_cpus(uint32_t *count);
+
+// Finds the FBPT boot performance record; it's looked up through ACPI, so
+// this has to happen before ExitBootServices(). False without one.
+bool fw_boot_performance_init(void);
+bool fw_get_boot_performance(struct fw_boot_performance *perf);
+void fw_publish_boot_performance(const struct fw_boot_performance *perf);
+
 #endif /* _FIRMWARE_ACPI_H */
\ No newline at end of file
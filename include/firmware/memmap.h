@@ -21,6 +21,7 @@
 #define _FIRMWARE_MEMMAP_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 enum {
 	MemoryMapReserved,
@@ -30,14 +31,25 @@ enum {
 	MemoryMapAcpiNVS,
 	MemoryMapMmio,
 	MemoryMapUnusable,
+	MemoryMapPersistent,      // NVDIMMs, left for the kernel to tier
+	MemoryMapSpecificPurpose, // HBM, CXL and the like; never allocated from
 };
 
+// address-range mirrored, the most reliable memory in the machine
+#define MEMMAP_FLAG_MIRRORED (1 << 0)
+
+#define MEMMAP_NO_PROXIMITY 0xffffffff
+
 struct memory_map_entry {
 	uint64_t base;
 	uint64_t length;
 	uint16_t type;
+	uint16_t flags; // MEMMAP_FLAG_*
+	uint32_t proximity; // NUMA domain, MEMMAP_NO_PROXIMITY if unknown
 };
 
+struct numa_range;
+
 struct memory_map_info {
 	struct memory_map_entry *entries;
 	uint64_t entry_count;
@@ -45,6 +57,16 @@ struct memory_map_info {
 
 void fw_get_memory_map(struct memory_map_info *memmap);
 void memmap_dump(struct memory_map_info *memmap);
+void memmap_normalize(struct memory_map_info *memmap);
+
+// Splits entries at NUMA range boundaries and tags them with the range's
+// proximity domain; the new entries array comes from the loader arena
+void memmap_split_numa(struct memory_map_info *memmap, const struct numa_range *ranges, uint32_t range_count);
+
+// Largest usable range for the loader's own allocations: mirrored memory in
+// the proximity domain, any mirrored memory, then usable memory in the
+// domain. False if none of these exist.
+bool memmap_find_preferred(struct memory_map_info *memmap, uint32_t proximity, uint64_t *base, uint64_t *length);
 char *memmap_type_to_str(uint16_t type);
 
 #endif /* _FIRMWARE_MEMMAP_H */
\ No newline at end of file
@@ -20,8 +20,29 @@
 #ifndef FIRMWARE_MEMORY_H
 #define FIRMWARE_MEMORY_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+// granularity of fw_allocpages()
+#define FW_PAGE_SIZE 0x1000
+
+// what page allocations are used for
+enum {
+	FwMemoryLoader,			// freed or left usable once the kernel runs
+	FwMemoryReclaimable,	// reported to the kernel as bootloader-reclaimable
+};
+
 void *fw_allocmem(size_t size);
 int fw_allocpage(size_t np, void *base);
 void fw_free(void *p);
 
+// fw_allocpages() tries this range first, e.g. the memory local to the BSP
+void fw_set_preferred_memory(uint64_t base, uint64_t length);
+
+void *fw_allocpages(size_t np, int type);
+
+// Pages that end below limit, e.g. for real-mode code; NULL if there are none
+void *fw_allocpages_below(size_t np, uint64_t limit, int type);
+void fw_freepages(void *base, size_t np);
+
 #endif /* FIRMWARE_MEMORY_H */
\ No newline at end of file
@@ -0,0 +1,38 @@
+/*********************************************************************************/
+/* Module Name:  serial.h                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _FIRMWARE_SERIAL_H
+#define _FIRMWARE_SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The firmware's own serial driver, usable until handoff
+
+int fw_serial_init(uint32_t baud);
+int fw_serial_write(const void *buffer, size_t size);
+
+// Which COM port (0 for COM1) the firmware driver talks to, from its ACPI
+// device path node; -1 if it isn't a legacy COM port or can't be told
+int fw_serial_get_com_index(uint32_t *index);
+
+// Stops using the firmware driver, must be called before ExitBootServices()
+void fw_serial_release(void);
+
+#endif /* _FIRMWARE_SERIAL_H */
@@ -0,0 +1,31 @@
+/*********************************************************************************/
+/* Module Name:  var.h                                                           */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _FIRMWARE_VAR_H
+#define _FIRMWARE_VAR_H
+
+#include <stdint.h>
+
+// Non-volatile variables owned by AxBoot; only usable before handoff
+
+// Returns the variable's size, or -1 if it doesn't exist or doesn't fit
+int fw_var_get(const char *name, void *buffer, uint64_t size);
+int fw_var_set(const char *name, const void *buffer, uint64_t size);
+
+#endif /* _FIRMWARE_VAR_H */
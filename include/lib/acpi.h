@@ -0,0 +1,219 @@
+/*********************************************************************************/
+/* Module Name:  acpi.h                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_ACPI_H
+#define _LIB_ACPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// ACPI table directory. The RSDT/XSDT is walked and checksummed once by
+// acpi_init(); lookups after that are a scan of a small flat array and
+// never touch the root table again. Tables with a bad checksum are left
+// out.
+//
+
+#define ACPI_MAX_TABLES 256
+
+struct acpi_sdt_header {
+	char signature[4];
+	uint32_t length;
+	uint8_t revision;
+	uint8_t checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	uint32_t oem_revision;
+	uint32_t creator_id;
+	uint32_t creator_revision;
+} __attribute__((packed));
+
+struct acpi_rsdp {
+	char signature[8];
+	uint8_t checksum;
+	char oem_id[6];
+	uint8_t revision;
+	uint32_t rsdt_address;
+	uint32_t length;
+	uint64_t xsdt_address;
+	uint8_t extended_checksum;
+	uint8_t reserved[3];
+} __attribute__((packed));
+
+struct acpi_gas {
+	uint8_t address_space;
+	uint8_t bit_width;
+	uint8_t bit_offset;
+	uint8_t access_size;
+	uint64_t address;
+} __attribute__((packed));
+
+#define ACPI_GAS_SYSTEM_MEMORY 0
+#define ACPI_GAS_SYSTEM_IO 1
+
+///
+// MADT
+///
+
+struct acpi_madt {
+	struct acpi_sdt_header header;
+	uint32_t lapic_address;
+	uint32_t flags;
+} __attribute__((packed));
+
+#define ACPI_MADT_PCAT_COMPAT (1 << 0)
+
+enum {
+	AcpiMadtLapic = 0,
+	AcpiMadtIoapic = 1,
+	AcpiMadtInterruptOverride = 2,
+	AcpiMadtLapicNmi = 4,
+	AcpiMadtLapicAddressOverride = 5,
+	AcpiMadtX2apic = 9,
+	AcpiMadtX2apicNmi = 10,
+};
+
+struct acpi_madt_entry {
+	uint8_t type;
+	uint8_t length;
+} __attribute__((packed));
+
+struct acpi_madt_lapic {
+	struct acpi_madt_entry header;
+	uint8_t acpi_uid;
+	uint8_t apic_id;
+	uint32_t flags;
+} __attribute__((packed));
+
+#define ACPI_LAPIC_ENABLED (1 << 0)
+#define ACPI_LAPIC_ONLINE_CAPABLE (1 << 1)
+
+struct acpi_madt_ioapic {
+	struct acpi_madt_entry header;
+	uint8_t id;
+	uint8_t reserved;
+	uint32_t address;
+	uint32_t gsi_base;
+} __attribute__((packed));
+
+struct acpi_madt_override {
+	struct acpi_madt_entry header;
+	uint8_t bus;
+	uint8_t source;
+	uint32_t gsi;
+	uint16_t flags;
+} __attribute__((packed));
+
+struct acpi_madt_lapic_nmi {
+	struct acpi_madt_entry header;
+	uint8_t acpi_uid; // 0xff for all processors
+	uint16_t flags;
+	uint8_t lint;
+} __attribute__((packed));
+
+struct acpi_madt_lapic_address {
+	struct acpi_madt_entry header;
+	uint16_t reserved;
+	uint64_t address;
+} __attribute__((packed));
+
+struct acpi_madt_x2apic {
+	struct acpi_madt_entry header;
+	uint16_t reserved;
+	uint32_t x2apic_id;
+	uint32_t flags;
+	uint32_t acpi_uid;
+} __attribute__((packed));
+
+struct acpi_madt_x2apic_nmi {
+	struct acpi_madt_entry header;
+	uint16_t flags;
+	uint32_t acpi_uid; // 0xffffffff for all processors
+	uint8_t lint;
+	uint8_t reserved[3];
+} __attribute__((packed));
+
+///
+// MCFG, HPET
+///
+
+struct acpi_mcfg_segment {
+	uint64_t base;
+	uint16_t segment;
+	uint8_t bus_start;
+	uint8_t bus_end;
+	uint32_t reserved;
+} __attribute__((packed));
+
+struct acpi_mcfg {
+	struct acpi_sdt_header header;
+	uint64_t reserved;
+	struct acpi_mcfg_segment segments[];
+} __attribute__((packed));
+
+struct acpi_hpet {
+	struct acpi_sdt_header header;
+	uint32_t event_timer_block_id;
+	struct acpi_gas base_address;
+	uint8_t hpet_number;
+	uint16_t minimum_tick;
+	uint8_t page_protection;
+} __attribute__((packed));
+
+///
+// FADT, only as far as the PM timer
+///
+
+#define ACPI_FADT_TMR_VAL_EXT (1 << 8) // the PM timer is 32 bits wide, not 24
+
+struct acpi_fadt {
+	struct acpi_sdt_header header;
+	uint8_t reserved0[40];
+	uint32_t pm_tmr_blk;
+	uint8_t reserved1[11];
+	uint8_t pm_tmr_len;
+	uint8_t reserved2[20];
+	uint32_t flags;
+	uint8_t reserved3[92];
+	struct acpi_gas x_pm_tmr_blk; // ACPI 2.0+
+} __attribute__((packed));
+
+///
+// Directory
+///
+
+struct acpi_table_entry {
+	char signature[4];
+	uint32_t length;
+	uint64_t address;
+};
+
+// Sums length bytes, a valid table sums to 0
+bool acpi_checksum_valid(const void *data, uint32_t length);
+
+// Builds the directory from the RSDP; 0 on success. Only the first call
+// does any work.
+int acpi_init(void *rsdp);
+
+// First table with the signature, NULL if there is none
+void *acpi_find_table(const char *signature);
+
+const struct acpi_table_entry *acpi_get_directory(uint32_t *count);
+
+#endif /* _LIB_ACPI_H */
@@ -0,0 +1,83 @@
+/*********************************************************************************/
+/* Module Name:  arena.h                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_ARENA_H
+#define _LIB_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// Bump allocator backed by page-granular chunks from the firmware.
+// Individual allocations are never freed; memory is given back by
+// resetting to an earlier mark or by releasing the whole arena.
+//
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	uint64_t size;
+	uint64_t used;
+};
+
+struct arena {
+	const char *name;
+	int type;		// FwMemory* type of the chunks
+	int category;	// MemStat* category the chunks are accounted to
+
+	struct arena_chunk *head;
+	uint64_t chunk_count;
+
+	uint64_t used;
+	uint64_t high_water;
+};
+
+struct arena_mark {
+	struct arena_chunk *chunk;
+	uint64_t chunk_used;
+	uint64_t used;
+};
+
+#define ARENA_INIT(name, type, category) { (name), (type), (category), NULL, 0, 0, 0 }
+
+// Small allocations made while loading; left to the kernel as usable memory
+extern struct arena g_loader_arena;
+
+// Data handed to the kernel; survives as bootloader-reclaimable memory
+extern struct arena g_handoff_arena;
+
+void *arena_alloc(struct arena *arena, size_t size);
+
+// Makes sure size bytes can be allocated without asking the firmware
+bool arena_reserve(struct arena *arena, size_t size);
+
+bool arena_owns(struct arena *arena, void *p);
+
+struct arena_mark arena_mark(struct arena *arena);
+void arena_reset(struct arena *arena, struct arena_mark mark);
+
+// Gives every chunk back to the firmware
+void arena_release(struct arena *arena);
+
+void arena_dump(struct arena *arena);
+
+#endif /* _LIB_ARENA_H */
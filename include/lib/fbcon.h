@@ -0,0 +1,58 @@
+/*********************************************************************************/
+/* Module Name:  fbcon.h                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_FBCON_H
+#define _LIB_FBCON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//
+// Text console drawn straight into the framebuffer. Glyphs are rasterized
+// once from the firmware's font into ready-to-copy pixels, text is drawn
+// into a shadow buffer, and only the dirty rectangle is copied out on
+// fbcon_flush(). Scrolling is a memmove of the shadow buffer.
+//
+// Once set up it doesn't need the firmware anymore, so it keeps working
+// after ExitBootServices().
+//
+
+#define FBCON_FIRST_GLYPH 0x20
+#define FBCON_LAST_GLYPH 0x7e
+#define FBCON_GLYPH_COUNT (FBCON_LAST_GLYPH - FBCON_FIRST_GLYPH + 1)
+
+#define FBCON_FOREGROUND 0x00c0c0c0
+#define FBCON_BACKGROUND 0x00000000
+
+// Returns 0 once the console is usable; only tries the firmware once
+int fbcon_init(void);
+bool fbcon_active(void);
+
+// Stops drawing, e.g. because the mode is about to change under us
+void fbcon_release(void);
+
+void fbcon_write(const char *text, size_t len);
+void fbcon_clear(void);
+void fbcon_set_cursor(uint32_t column, uint32_t row);
+
+// Copies whatever changed since the last flush to the screen
+void fbcon_flush(void);
+
+#endif /* _LIB_FBCON_H */
@@ -0,0 +1,69 @@
+/*********************************************************************************/
+/* Module Name:  history.h                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_HISTORY_H
+#define _LIB_HISTORY_H
+
+#include <stdint.h>
+
+//
+// Timings of recent boots, kept in a non-volatile firmware variable so
+// regressions across firmware and kernel updates show up on the machine
+// itself. To spare the flash, a boot is only written out every
+// HISTORY_SAMPLE_INTERVAL boots on average, or when its boot time (total minus
+// the menu) is more than HISTORY_DELTA_PERCENT off the last recorded boot.
+//
+
+#define HISTORY_SIZE 16
+#define HISTORY_SAMPLE_INTERVAL 8
+#define HISTORY_DELTA_PERCENT 20
+
+#define HISTORY_MAGIC 0x48425841 // "AXBH"
+#define HISTORY_VERSION 1
+
+struct history_record {
+	uint32_t firmware_us; // power-on to loader entry
+	uint32_t config_us;   // loader entry to config loaded
+	uint32_t menu_us;     // config loaded to menu done
+	uint32_t load_us;     // menu done to kernel loaded
+	uint32_t prepare_us;  // kernel loaded to taking the memory map
+	uint32_t total_us;    // power-on to taking the memory map
+	uint32_t kernel_size;
+	uint32_t modules_size;
+} __attribute__((packed));
+
+struct history {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	uint32_t head; // next slot to write
+	uint32_t checksum; // CRC32 of the records
+	struct history_record records[HISTORY_SIZE];
+} __attribute__((packed));
+
+// Returns the number of recorded boots, reading the variable on first use
+uint32_t history_get_count(void);
+
+// Returns a recorded boot, 0 being the oldest
+const struct history_record *history_get(uint32_t index);
+
+// Appends this boot, writing the variable if it's due
+void history_record(const struct history_record *record);
+
+#endif /* _LIB_HISTORY_H */
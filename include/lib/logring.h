@@ -0,0 +1,90 @@
+/*********************************************************************************/
+/* Module Name:  logring.h                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_LOGRING_H
+#define _LIB_LOGRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Boot log ring. log() and debug() only append to it; the serial port and
+// the firmware console are drain targets that catch up whenever the loader
+// is idle, or synchronously when the ring would otherwise drop records a
+// target hasn't seen yet. The ring is handed to the kernel at the end.
+//
+// There's a single writer. Readers only look at data below `head`, which
+// is published after the record is complete.
+//
+// Record layout: struct log_record, then `length` bytes of text with no
+// terminator. Records may wrap around the end of the buffer.
+//
+
+#define LOG_RING_SIZE (64 * 1024)
+#define LOG_RECORD_MAX 4096
+
+enum {
+	LogLevelDebug,
+	LogLevelInfo,
+	LogLevelTrace, // binary, see lib/trace.h
+};
+
+enum {
+	LogSinkSerial,
+	LogSinkConsole,
+	LogSinkCount,
+};
+
+#define LOG_SINK_MASK(sink) (1 << (sink))
+#define LOG_SINKS_ALL (LOG_SINK_MASK(LogSinkSerial) | LOG_SINK_MASK(LogSinkConsole))
+
+struct log_record {
+	uint16_t length;
+	uint8_t level;
+	uint8_t reserved;
+} __attribute__((packed));
+
+struct log_ring {
+	char *buffer;
+	uint64_t size;
+
+	// byte positions since the ring was created; data is [tail, head)
+	volatile uint64_t head;
+	uint64_t tail;
+
+	// how far each target has been drained
+	uint64_t cursor[LogSinkCount];
+	int sinks;
+};
+
+// Sets up the ring; until then everything is written straight to the targets
+int logring_init(void);
+
+void logring_write(int level, const char *str);
+void logring_write_record(int level, const void *data, size_t len);
+
+// Drains up to `budget` bytes per target (0 drains everything)
+void logring_drain(int sinks, size_t budget);
+
+void logring_set_sinks(int sinks);
+int logring_get_sinks(void);
+
+const struct log_ring *logring_get(void);
+
+#endif /* _LIB_LOGRING_H */
@@ -0,0 +1,58 @@
+/*********************************************************************************/
+/* Module Name:  memstat.h                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_MEMSTAT_H
+#define _LIB_MEMSTAT_H
+
+#include <stdint.h>
+
+//
+// Accounting of the memory AxBoot allocates, by what it's used for.
+//
+
+enum {
+	MemStatPageTables,
+	MemStatKernel,
+	MemStatModules,
+	MemStatBootInfo,
+	MemStatStack,
+	MemStatTransient,
+	MemStatCount,
+};
+
+struct memstat_category {
+	uint64_t count;		// allocations made
+	uint64_t bytes;		// bytes allocated in total
+	uint64_t current;	// bytes not freed yet
+	uint64_t peak;		// highest value of current
+};
+
+void memstat_alloc(int category, uint64_t bytes);
+void memstat_free(int category, uint64_t bytes);
+
+// Counts a call into the firmware's memory services
+void memstat_fw_call(void);
+
+const struct memstat_category *memstat_get(int category);
+uint64_t memstat_get_peak(void);
+uint64_t memstat_get_fw_calls(void);
+
+void memstat_dump(void);
+
+#endif /* _LIB_MEMSTAT_H */
@@ -0,0 +1,54 @@
+/*********************************************************************************/
+/* Module Name:  numa.h                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_NUMA_H
+#define _LIB_NUMA_H
+
+#include <stdint.h>
+
+//
+// NUMA topology from the ACPI SRAT and SLIT. Memory affinity ranges are
+// read once so the memory map can be tagged with proximity domains, and
+// loader allocations can be steered to the node the BSP runs on.
+//
+
+#define NUMA_MAX_RANGES 64
+#define NUMA_NO_PROXIMITY 0xffffffff
+
+struct numa_range {
+	uint64_t base;
+	uint64_t length;
+	uint32_t proximity;
+};
+
+// Parses the SRAT; 0 if the machine describes its NUMA layout
+int numa_init(void);
+
+const struct numa_range *numa_get_ranges(uint32_t *count);
+
+// Proximity domain of a memory address or an APIC ID, NUMA_NO_PROXIMITY if
+// the SRAT doesn't say
+uint32_t numa_get_proximity(uint64_t address);
+uint32_t numa_get_cpu_proximity(uint32_t apic_id);
+uint32_t numa_get_bsp_proximity(void);
+
+// SLIT distances, localities * localities bytes; NULL without a SLIT
+const uint8_t *numa_get_distances(uint64_t *localities);
+
+#endif /* _LIB_NUMA_H */
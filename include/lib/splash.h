@@ -0,0 +1,47 @@
+/*********************************************************************************/
+/* Module Name:  splash.h                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_SPLASH_H
+#define _LIB_SPLASH_H
+
+#include <stdint.h>
+
+//
+// Boot splash. Takes either a QOI image or a raw blob that's already in
+// the Blt() pixel layout and shows it centered, with a single Blt().
+//
+// The raw format is a struct splash_raw_header followed by width * height
+// 32-bit pixels, blue in the lowest byte, row after row without padding.
+//
+
+#define SPLASH_RAW_MAGIC 0x52535841 // "AXSR"
+
+struct splash_raw_header {
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+} __attribute__((packed));
+
+// Called by the boot protocol once the kernel has asked for a framebuffer
+// and the mode is final. Does nothing without a path or a framebuffer;
+// read, decode and present times go to the serial log
+void splash_show(const char *path);
+
+#endif /* _LIB_SPLASH_H */
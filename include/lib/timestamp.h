@@ -0,0 +1,80 @@
+/*********************************************************************************/
+/* Module Name:  timestamp.h                                                     */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_TIMESTAMP_H
+#define _LIB_TIMESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot phases, in the order they're reached
+enum {
+	TimestampLoaderEntry,
+	TimestampConfigLoaded,
+	TimestampMenuDone,
+	TimestampKernelLoaded,
+	TimestampPagingDone,
+	TimestampExitBootServicesEntry,
+	TimestampExitBootServicesExit,
+	TimestampHandoff,
+	TimestampCount,
+};
+
+// Records the current TSC value for a boot phase
+void timestamp_record(int id);
+
+// Returns the TSC value recorded for a boot phase, 0 if it wasn't reached
+uint64_t timestamp_get(int id);
+
+// Where the TSC frequency came from
+enum {
+	TimestampSourceUnknown,
+	TimestampSourceCpuid15,  // CPUID crystal clock and ratio
+	TimestampSourceCpuid16,  // CPUID ratio, crystal derived from the base frequency
+	TimestampSourceHpet,
+	TimestampSourcePmTimer,
+	TimestampSourceFirmware, // measured across the firmware's Stall()
+};
+
+// Starts measuring the TSC against the HPET or the ACPI PM timer unless
+// CPUID already tells; needs the ACPI tables
+void timestamp_calibration_start(void);
+
+// Keeps the measurement going across reference timer wrap-arounds; cheap,
+// meant for loops that wait on the firmware anyway
+void timestamp_calibration_poll(void);
+
+// Determines the TSC frequency; must be called while firmware services are up
+void timestamp_calibrate(void);
+
+// Returns the TSC frequency in Hz, 0 if it isn't known
+uint64_t timestamp_get_frequency(void);
+
+int timestamp_get_source(void);
+
+// How long the reference timer was watched, 0 if no measurement was needed
+uint64_t timestamp_get_calibration_ns(void);
+
+// The TSC ticks at a constant rate through P-, C- and T-state changes
+bool timestamp_tsc_invariant(void);
+
+// Converts a TSC value to nanoseconds since the TSC was reset, 0 if unknown
+uint64_t timestamp_to_ns(uint64_t tsc);
+
+#endif /* _LIB_TIMESTAMP_H */
@@ -0,0 +1,160 @@
+/*********************************************************************************/
+/* Module Name:  trace.h                                                         */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#ifndef _LIB_TRACE_H
+#define _LIB_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Binary trace mode (build with TRACE=yes). debug() then records only the
+// call site, a TSC timestamp and its raw arguments, and leaves formatting
+// to axtrace on the host.
+//
+// Every call site places "file:line\0format" in the .axtrace section of
+// the image. A site's ID is its offset in that section, which axtrace
+// reads back from the image or from the table extracted at build time.
+//
+// Record payload: struct trace_header, then one entry per argument the
+// format consumes: integers, pointers and doubles as 8 bytes, strings as
+// a 16-bit length followed by that many bytes. On the serial port each
+// record is framed as TRACE_FRAME_SYNC, struct log_record, payload.
+//
+
+#define TRACE_SECTION_START ".axtrace$a"
+#define TRACE_SECTION ".axtrace$b"
+#define TRACE_MAGIC "AXTRACE"
+
+#define TRACE_FRAME_SYNC 0x1e
+#define TRACE_RECORD_MAX 512
+#define TRACE_STRING_MAX 128
+
+struct trace_header {
+	uint32_t id;
+	uint64_t tsc;
+} __attribute__((packed));
+
+enum {
+	TraceArgInt,
+	TraceArgLong,
+	TraceArgPointer,
+	TraceArgString,
+	TraceArgDouble,
+};
+
+struct trace_spec {
+	const char *start; // the '%'
+	size_t length;
+	int stars; // '*' widths/precisions, each an int argument before the value
+	int precision; // -1 if none or given as '*'
+	int type;
+};
+
+// Finds the next conversion in fmt that takes an argument. Shared with
+// axtrace, which has to walk the arguments exactly the same way.
+static inline const char *trace_next_spec(const char *fmt, struct trace_spec *spec)
+{
+	int longs = 0;
+
+	while (*fmt != '\0') {
+		if (*fmt++ != '%') {
+			continue;
+		}
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+
+		spec->start = fmt - 1;
+		spec->stars = 0;
+		spec->precision = -1;
+		longs = 0;
+
+		while (*fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#' || *fmt == '0') {
+			fmt++;
+		}
+		while ((*fmt >= '0' && *fmt <= '9') || *fmt == '*') {
+			spec->stars += (*fmt == '*');
+			fmt++;
+		}
+		if (*fmt == '.') {
+			fmt++;
+			if (*fmt == '*') {
+				spec->stars++;
+				fmt++;
+			} else {
+				spec->precision = 0;
+				while (*fmt >= '0' && *fmt <= '9') {
+					spec->precision = spec->precision * 10 + (*fmt++ - '0');
+				}
+			}
+		}
+		while (*fmt == 'l' || *fmt == 'h' || *fmt == 'z' || *fmt == 'j' || *fmt == 't') {
+			longs += (*fmt == 'l' || *fmt == 'z' || *fmt == 'j' || *fmt == 't');
+			fmt++;
+		}
+
+		switch (*fmt) {
+			case 's':
+				spec->type = TraceArgString;
+				break;
+			case 'p':
+				spec->type = TraceArgPointer;
+				break;
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+				spec->type = TraceArgDouble;
+				break;
+			case '\0':
+				return NULL;
+			default:
+				spec->type = longs ? TraceArgLong : TraceArgInt;
+				break;
+		}
+
+		fmt++;
+		spec->length = fmt - spec->start;
+		return fmt;
+	}
+
+	return NULL;
+}
+
+#ifdef AXBOOT_TRACE
+
+#define TRACE_STR_(x) #x
+#define TRACE_STR(x) TRACE_STR_(x)
+
+void trace_write(const char *site, ...);
+
+#define TRACE(fmt, ...) \
+	do { \
+		static const char trace_site[] __attribute__((section(TRACE_SECTION), used)) = \
+			__FILE__ ":" TRACE_STR(__LINE__) "\0" fmt; \
+		trace_write(trace_site, ##__VA_ARGS__); \
+	} while (0)
+
+#endif
+
+#endif /* _LIB_TRACE_H */
@@ -21,6 +21,7 @@
 #define _LOADER_ELF_ELF_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 //
@@ -369,6 +370,28 @@ typedef struct {
     Elf64_Xword p_align;
 } Elf64_Phdr;
 
+//
+// ELF Note header
+//
+typedef struct {
+    Elf32_Word n_namesz;
+    Elf32_Word n_descsz;
+    Elf32_Word n_type;
+} Elf32_Nhdr;
+
+typedef struct {
+    Elf64_Word n_namesz;
+    Elf64_Word n_descsz;
+    Elf64_Word n_type;
+} Elf64_Nhdr;
+
+typedef void (*elf_note_callback)(uint32_t type, void *desc, uint32_t descsz, void *ctx);
+
+int elf_validate_header(Elf32_Ehdr *header);
+// Calls callback for every note of the given owner, returns how many were
+// found or -1 if the file is invalid or its headers lie past size
+int elf_parse_notes(void *kernel, size_t size, const char *owner, elf_note_callback callback, void *ctx);
+
 bool elf_load(void *kernel, void **entryp);
 
 #endif /* _LOADER_ELF_ELF_H */
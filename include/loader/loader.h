@@ -20,14 +20,36 @@
 #ifndef _LOADER_LOADER_H
 #define _LOADER_LOADER_H
 
+#include <stdint.h>
+
 enum BootProtocol {
     // 0 if EFI chainload
     ProtocolAbp,
     ProtocolMultiboot,
     ProtocolMultiboot2,
     ProtocolLinux,
+    ProtocolChainload,
+};
+
+struct config_entry;
+
+struct loader_file {
+    const char *path;
+    void *file; // FILE *, kept opaque so this header stays firmware-neutral
+    void *buffer;
+    uint64_t size;
+    uint64_t loaded;
+    int category; // MemStat* category the buffer is accounted to
 };
 
-void loader_load(int protocol, const char *filepath);
+// Points firmware page allocations at mirrored memory, or memory local to
+// the BSP, before anything big is read
+void loader_init_placement(void);
+
+int loader_stage_begin(struct config_entry *entry);
+int loader_stage_step(void);
+void loader_stage_drop(void);
+
+void loader_load(struct config_entry *entry);
 
 #endif /* _LOADER_LOADER_H */
\ No newline at end of file
@@ -20,6 +20,8 @@
 #ifndef _MENU_MENU_H
 #define _MENU_MENU_H
 
-void menu_main(void);
+struct config_entry;
+
+struct config_entry *menu_main(void);
 
 #endif /* _MENU_MENU_H */
\ No newline at end of file
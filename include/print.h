@@ -25,7 +25,13 @@
 #include <stdbool.h>
 
 void log(const char *fmt, ...);
+
+#ifdef AXBOOT_TRACE
+#include <lib/trace.h>
+#define debug(fmt, ...) TRACE(fmt, ##__VA_ARGS__)
+#else
 void debug(const char *fmt, ...);
+#endif
 
 void printstr(const char *str);
 
@@ -23,7 +23,10 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define AXBOOT_PROTOCOL_VERSION_STR "0.2"
+// Bumped whenever struct abp_boot_info, or anything it points to, changes
+// layout. 0.4 added everything from hhdm_base on, the framebuffer pitch,
+// and the proximity and flags of memory map entries.
+#define AXBOOT_PROTOCOL_VERSION_STR "0.4"
 
 ///
 // ACPI and SMBIOS
@@ -39,6 +42,100 @@ struct abp_smbios_info {
     void *entry_point;
 };
 
+// EFI configuration tables, NULL where the firmware has none. acpi_rsdp and
+// smbios_entry_point are the ones also reported in acpi and smbios.
+struct abp_firmware_tables {
+    void *acpi_rsdp;
+    void *acpi10_rsdp;
+    void *smbios_entry_point;
+    void *smbios2_entry_point;
+    void *smbios3_entry_point;
+    void *dtb;
+    void *esrt;
+    void *memory_attributes;
+    void *rng_seed;
+};
+
+// Pre-parsed ACPI, so the kernel can bring up interrupts and other CPUs
+// without walking the tables itself. Every table in the XSDT with a valid
+// checksum is listed in tables.
+
+struct abp_acpi_table {
+    char signature[4];
+    uint32_t length;
+    uint64_t address;
+};
+
+#define ABP_CPU_ENABLED (1 << 0)
+#define ABP_CPU_ONLINE_CAPABLE (1 << 1)
+#define ABP_CPU_X2APIC (1 << 2) // listed as x2APIC in the MADT
+
+struct abp_cpu {
+    uint32_t apic_id;
+    uint32_t acpi_uid;
+    uint32_t flags;
+    uint32_t proximity; // ABP_NO_PROXIMITY without an SRAT
+};
+
+struct abp_ioapic {
+    uint32_t id;
+    uint32_t gsi_base;
+    uint64_t address;
+};
+
+// MPS INTI flags, polarity in bits 0-1, trigger mode in bits 2-3
+struct abp_irq_override {
+    uint8_t bus;
+    uint8_t source;
+    uint16_t flags;
+    uint32_t gsi;
+};
+
+struct abp_lapic_nmi {
+    uint32_t acpi_uid; // 0xffffffff for all processors
+    uint16_t flags;
+    uint8_t lint;
+};
+
+struct abp_pci_segment {
+    uint64_t base; // ECAM
+    uint16_t segment;
+    uint8_t bus_start;
+    uint8_t bus_end;
+};
+
+struct abp_acpi_directory {
+    struct abp_acpi_table *tables;
+    uint32_t table_count;
+
+    // MADT
+    uint32_t madt_flags; // bit 0: legacy PICs present
+    uint64_t lapic_address;
+    struct abp_cpu *cpus;
+    uint32_t cpu_count;
+    struct abp_ioapic *ioapics;
+    uint32_t ioapic_count;
+    struct abp_irq_override *irq_overrides;
+    uint32_t irq_override_count;
+    struct abp_lapic_nmi *lapic_nmis;
+    uint32_t lapic_nmi_count;
+
+    // MCFG
+    struct abp_pci_segment *pci_segments;
+    uint32_t pci_segment_count;
+
+    // HPET, 0 if there is none
+    uint64_t hpet_address;
+};
+
+// SLIT distances: distances[i * locality_count + j] is the distance from
+// domain i to domain j, 10 meaning local
+struct abp_numa_info {
+    uint32_t bsp_proximity; // ABP_NO_PROXIMITY without an SRAT
+    uint64_t locality_count;
+    uint8_t *distances; // NULL without a SLIT
+};
+
 ///
 // Memory Map
 ///
@@ -50,14 +147,25 @@ struct abp_smbios_info {
 #define ABP_MEMORY_ACPI_NVS 0xf4
 #define ABP_MEMORY_ACPI_RECLAIMABLE 0xf5
 #define ABP_MEMORY_KERNEL 0xf7
+#define ABP_MEMORY_PERSISTENT 0xf8 // NVDIMMs; survives reboots, slower than DRAM
+#define ABP_MEMORY_SPECIFIC_PURPOSE 0xf9 // HBM, CXL; usable, but meant for particular workloads
 #define ABP_MEMORY_NOT_USABLE 0xff
 
+#define ABP_NO_PROXIMITY 0xffffffff
+
+// address-range mirrored, put the kernel's critical data here
+#define ABP_MEMORY_FLAG_MIRRORED (1 << 0)
+
+// Entries are split where NUMA domains change
 struct abp_memory_map {
     uint64_t base;
     uint64_t length;
     uint64_t type;
 
     struct abp_memory_map *next;
+
+    uint32_t proximity; // SRAT proximity domain, ABP_NO_PROXIMITY if unknown
+    uint32_t flags; // ABP_MEMORY_FLAG_*
 };
 
 ///
@@ -75,8 +183,264 @@ struct abp_framebuffer_info {
     uint32_t height;
     uint16_t bpp;
     uint8_t pixel_format;
+    uint32_t pitch; // bytes per scanline, don't assume width * bpp / 8
 };
 
+struct abp_video_mode {
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint16_t bpp;
+    uint8_t pixel_format;
+};
+
+// Every mode with a linear framebuffer, for kernels that switch modes themselves
+struct abp_video_modes {
+    struct abp_video_mode *modes;
+    uint32_t count;
+    uint32_t current; // index of the mode in framebuffer
+};
+
+///
+// SMP
+///
+
+#define ABP_SMP_X2APIC (1 << 0) // the LAPICs were left in x2APIC mode
+
+#define ABP_SMP_CPU_BSP (1 << 0)
+#define ABP_SMP_CPU_PARKED (1 << 1) // checked in and spinning on goto_address
+
+// One per CPU the firmware brought up, each on its own cache line. A parked
+// AP runs with interrupts off, on the kernel's page tables and a GDT with
+// the BSP's code and data selectors, and spins on goto_address. Storing to
+// goto_address starts it there, with rsp at stack_top and a pointer to this
+// structure in rdi and rcx. The mailboxes, stacks and the spin loop are in
+// bootloader-reclaimable memory, so start every AP before reclaiming it.
+struct abp_smp_cpu {
+    uint32_t apic_id;
+    uint32_t flags;
+    uint32_t package;
+    uint32_t core;
+    uint32_t thread;
+    uint32_t proximity; // ABP_NO_PROXIMITY without an SRAT
+    uint64_t stack_top;
+    uint64_t argument; // free for the kernel, e.g. to pass per-CPU data
+    void (*volatile goto_address)(struct abp_smp_cpu *);
+} __attribute__((aligned(64)));
+
+struct abp_smp_info {
+    uint32_t flags;
+    uint32_t bsp_apic_id;
+    uint64_t cpu_count;
+    struct abp_smp_cpu *cpus; // NULL if the kernel has to start the APs itself
+};
+
+///
+// Modules
+///
+
+struct abp_module {
+    void *base;
+    uint64_t size;
+    char *path;
+};
+
+///
+// Timestamps
+///
+
+// Raw TSC values taken by the loader; 0 if a phase wasn't reached
+struct abp_timestamps {
+    uint64_t loader_entry;
+    uint64_t config_loaded;
+    uint64_t menu_done;
+    uint64_t kernel_loaded;
+    uint64_t paging_done;
+    uint64_t handoff;
+};
+
+// Firmware and loader phases on one timeline, in nanoseconds since reset as
+// reported by the ACPI FPDT; 0 if a phase wasn't recorded
+struct abp_boot_timeline {
+    uint64_t tsc_frequency; // Hz, 0 if unknown
+    uint8_t firmware_valid; // the firmware provided an FPDT
+
+    uint64_t reset_end;
+    uint64_t os_loader_load_image_start;
+    uint64_t os_loader_start_image_start;
+    uint64_t exit_boot_services_entry;
+    uint64_t exit_boot_services_exit;
+
+    uint64_t loader_entry;
+    uint64_t config_loaded;
+    uint64_t menu_done;
+    uint64_t kernel_loaded;
+    uint64_t paging_done;
+    uint64_t handoff;
+};
+
+// How the loader determined the TSC frequency, so the kernel can skip its
+// own calibration. CPUID sources are exact; measured ones are as good as
+// calibration_ns is long.
+#define ABP_TSC_SOURCE_UNKNOWN 0
+#define ABP_TSC_SOURCE_CPUID_15H 1 // crystal clock and ratio
+#define ABP_TSC_SOURCE_CPUID_16H 2 // ratio, crystal derived from the base frequency
+#define ABP_TSC_SOURCE_HPET 3
+#define ABP_TSC_SOURCE_PM_TIMER 4
+#define ABP_TSC_SOURCE_FIRMWARE 5 // measured across the firmware's Stall()
+
+#define ABP_TSC_INVARIANT (1 << 0) // constant rate in every P-, C- and T-state
+
+struct abp_tsc_info {
+    uint64_t frequency; // Hz, 0 if unknown
+    uint32_t source;
+    uint32_t flags;
+    uint64_t calibration_ns; // how long the reference timer was watched
+    uint64_t loader_entry; // TSC value when the loader was entered
+};
+
+// Boot timings kept by the loader across boots, oldest first. Not every
+// boot is recorded, see lib/history.h.
+#define ABP_BOOT_HISTORY_MAX 16
+
+struct abp_boot_history_entry {
+    uint32_t firmware_us; // power-on to loader entry
+    uint32_t config_us;
+    uint32_t menu_us;
+    uint32_t load_us;
+    uint32_t prepare_us;
+    uint32_t total_us; // power-on to taking the memory map
+    uint32_t kernel_size;
+    uint32_t modules_size;
+};
+
+struct abp_boot_history {
+    uint32_t count;
+    struct abp_boot_history_entry entries[ABP_BOOT_HISTORY_MAX];
+};
+
+///
+// Boot log
+///
+
+#define ABP_LOG_DEBUG 0
+#define ABP_LOG_INFO 1
+#define ABP_LOG_TRACE 2 // binary, decoded with axtrace against the loader image
+
+// Each record is a struct abp_log_record followed by `length` bytes of
+// text without a terminator. Valid data is [tail, head) modulo size, and
+// records may wrap around the end of the buffer.
+struct abp_log_record {
+    uint16_t length;
+    uint8_t level;
+    uint8_t reserved;
+} __attribute__((packed));
+
+struct abp_log {
+    char *buffer; // NULL if the loader logged synchronously
+    uint64_t size;
+    uint64_t head;
+    uint64_t tail;
+};
+
+///
+// Memory usage
+///
+
+struct abp_memory_usage {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+};
+
+// What the loader allocated, and for what
+struct abp_memory_stats {
+    struct abp_memory_usage page_tables;
+    struct abp_memory_usage kernel;
+    struct abp_memory_usage modules;
+    struct abp_memory_usage boot_info;
+    struct abp_memory_usage stack;
+    struct abp_memory_usage transient;
+
+    uint64_t page_tables_per_level[4]; // PML4, PDPT, PD, PT
+    uint64_t identity_map_tables;
+    uint64_t hhdm_tables;
+
+    uint64_t peak_bytes;
+    uint64_t firmware_calls;
+};
+
+///
+// Kernel requests
+//
+// A kernel declares what it needs from the bootloader by embedding
+// notes owned by ABP_NOTE_NAME in a PT_NOTE segment (or a .note.axboot
+// section). If no such note is present, AxBoot provides everything.
+// If at least one is present, AxBoot only does the work that was asked for.
+///
+
+#define ABP_NOTE_NAME "AxBoot"
+
+#define ABP_REQUEST_HHDM 0x100
+#define ABP_REQUEST_STACK 0x101
+#define ABP_REQUEST_FRAMEBUFFER 0x102
+#define ABP_REQUEST_SMP 0x103
+#define ABP_REQUEST_MODULES 0x104
+#define ABP_REQUEST_PAGING 0x105
+#define ABP_REQUEST_ACPI 0x106
+#define ABP_REQUEST_SMBIOS 0x107
+
+// paging request flags
+#define ABP_PAGING_LVL5 (1 << 0)
+#define ABP_PAGING_2M (1 << 1)
+#define ABP_PAGING_1G (1 << 2)
+
+struct abp_note_header {
+    uint32_t namesz;
+    uint32_t descsz;
+    uint32_t type;
+    char name[8];
+} __attribute__((packed));
+
+struct abp_hhdm_request {
+    uint64_t base;
+} __attribute__((packed));
+
+struct abp_stack_request {
+    uint64_t size;
+} __attribute__((packed));
+
+// width and height of 0 keep the mode set up by the firmware
+struct abp_framebuffer_request {
+    uint32_t width;
+    uint32_t height;
+} __attribute__((packed));
+
+// stack_size of 0 gives every AP a 16 KiB stack
+struct abp_smp_request {
+    uint32_t flags;
+    uint64_t stack_size;
+} __attribute__((packed));
+
+struct abp_paging_request {
+    uint32_t flags;
+} __attribute__((packed));
+
+struct abp_empty_request {
+    uint32_t reserved;
+} __attribute__((packed));
+
+// Usage: ABP_REQUEST(fb_request, ABP_REQUEST_FRAMEBUFFER, struct abp_framebuffer_request, 1920, 1080);
+#define ABP_REQUEST(ident, req_type, req_struct, ...) \
+    __attribute__((used, section(".note.axboot"), aligned(4))) \
+    static const struct { \
+        struct abp_note_header header; \
+        req_struct desc; \
+    } __attribute__((packed)) ident = { \
+        { sizeof(ABP_NOTE_NAME), sizeof(req_struct), (req_type), ABP_NOTE_NAME }, \
+        { __VA_ARGS__ } \
+    }
+
 ///
 // General
 ///
@@ -97,6 +461,46 @@ struct abp_boot_info {
 
     // Framebuffer
     struct abp_framebuffer_info framebuffer;
+
+    // Higher half direct map (0 if not requested)
+    uint64_t hhdm_base;
+
+    // Modules
+    struct abp_module *modules;
+    uint64_t module_count;
+
+    // Boot timeline
+    struct abp_timestamps timestamps;
+
+    // Loader memory usage
+    struct abp_memory_stats memory_stats;
+
+    // Firmware and loader boot phases
+    struct abp_boot_timeline timeline;
+
+    // Timings of previous boots
+    struct abp_boot_history history;
+
+    // The loader's own log, for replaying into the kernel's
+    struct abp_log log;
+
+    // Display modes the firmware offered
+    struct abp_video_modes video_modes;
+
+    // Everything found in the EFI configuration table
+    struct abp_firmware_tables firmware_tables;
+
+    // Parsed ACPI tables (if ACPI was requested)
+    struct abp_acpi_directory acpi_directory;
+
+    // NUMA topology
+    struct abp_numa_info numa;
+
+    // Parked APs (if SMP was requested)
+    struct abp_smp_info smp;
+
+    // TSC frequency and where it came from
+    struct abp_tsc_info tsc;
 };
 
 ///
@@ -105,7 +509,16 @@ struct abp_boot_info {
 
 typedef void (*abp_entryp)(struct abp_boot_info *);
 
-void abp_load(void *kernel, size_t kernel_size);
+struct loader_file;
+
+void abp_load(void *kernel, size_t kernel_size, struct loader_file *modules, uint32_t module_count);
 void abp_handoff(void *entrypoint, struct abp_boot_info *bootinfo, void *stack, uint16_t stack_size);
 
+// Parking APs: prepare allocates before the memory map is taken, map runs
+// after paging_init() and start after the firmware is gone. map returns
+// non-zero if it ran out of memory for page tables.
+int abp_smp_prepare(struct abp_smp_info *smp, uint64_t stack_size);
+int abp_smp_map(struct abp_smp_info *smp);
+void abp_smp_start(struct abp_smp_info *smp);
+
 #endif /* _ABP_H */
\ No newline at end of file
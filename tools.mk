@@ -0,0 +1,60 @@
+###################################################################################
+## Module Name:  tools.mk                                                        ##
+## Project:      AurixOS                                                         ##
+##                                                                               ##
+## Copyright (c) 2024 Jozef Nagy                                                 ##
+##                                                                               ##
+## This source is subject to the MIT License.                                    ##
+## See License.txt in the root of this repository.                               ##
+## All other rights reserved.                                                    ##
+##                                                                               ##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    ##
+## IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      ##
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   ##
+## AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        ##
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, ##
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE ##
+## SOFTWARE.                                                                     ##
+###################################################################################
+
+# Host-side tools, built with the host compiler.
+
+HOST_CC ?= cc
+HOST_CFLAGS ?= -O2 -Wall -Wno-builtin-declaration-mismatch
+
+HOST_INCLUDE_DIRS := include include/arch/$(ARCH)
+
+CFGC := $(BUILD_DIR)/tools/axboot-cfgc
+CFGC_CFILES := tools/cfgc/cfgc.c \
+				common/config/parser.c \
+				common/lib/crc32.c
+
+CONFIG_SRC ?= base/axboot.cfg
+CONFIG_BIN := $(BUILD_DIR)/axboot.bin
+
+# -s to have the loader checksum CONFIG_SRC on every boot
+CFGC_FLAGS ?=
+
+$(CFGC): $(CFGC_CFILES)
+	@mkdir -p $(@D)
+	@printf "  HOSTCC\t$(notdir $@)\n"
+	@$(HOST_CC) $(HOST_CFLAGS) -fno-builtin $(foreach d, $(HOST_INCLUDE_DIRS), -I$d) $^ -o $@
+
+$(CONFIG_BIN): $(CONFIG_SRC) $(CFGC)
+	@mkdir -p $(@D)
+	@printf "  CFGC\t$(notdir $@)\n"
+	@$(CFGC) $(CFGC_FLAGS) $(CONFIG_SRC) $@
+
+AXTRACE := $(BUILD_DIR)/tools/axtrace
+
+$(AXTRACE): tools/axtrace/axtrace.c
+	@mkdir -p $(@D)
+	@printf "  HOSTCC\t$(notdir $@)\n"
+	@$(HOST_CC) $(HOST_CFLAGS) $(foreach d, $(HOST_INCLUDE_DIRS), -I$d) $^ -o $@
+
+# call site table for axtrace, matching this exact image
+UEFI_TRACE_TABLE := $(BUILD_DIR)/boot/axboot.axtrace
+
+$(UEFI_TRACE_TABLE): $(UEFI_BOOTFILE) $(AXTRACE)
+	@printf "  AXTRACE\t$(notdir $@)\n"
+	@$(AXTRACE) -x $(UEFI_BOOTFILE) $@
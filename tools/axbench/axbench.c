@@ -0,0 +1,531 @@
+/*********************************************************************************/
+/* Module Name:  axbench.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// AXBENCH.EFI: firmware microbenchmarks, built from the same uefi/fw layer
+// as AxBoot. Results are printed to ConOut and COM1 as one line per
+// measurement:
+//
+//   AXBENCH name=<name> arg=<n> iterations=<n> cycles=<n> ns=<n> mb_s=<n>
+//
+// where cycles and ns are per iteration and mb_s is 0 when the benchmark
+// doesn't move data. ExitBootServices() is measured last; its result only
+// goes to COM1, after which the machine is shut down.
+//
+
+#include <efi.h>
+#include <efilib.h>
+
+#include <arch/cpu/cpu.h>
+#include <config/config.h>
+#include <debug/serial.h>
+#include <firmware/firmware.h>
+#include <firmware/file.h>
+#include <firmware/handoff.h>
+#include <lib/string.h>
+#include <nanoprintf.h>
+#include <print.h>
+#include <axboot.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define AXBENCH_DATA_FILE "\\axbench.dat"
+
+#define SIZE_TO_PAGES(size) (((size) + 0xfff) / 0x1000)
+
+#define COPY_BUFFER_SIZE (16 * 1024 * 1024)
+#define COPY_BYTES_PER_RUN (64 * 1024 * 1024)
+
+static uint64_t tsc_per_us = 1;
+
+static void report_line(const char *fmt, ...)
+{
+	va_list args;
+	char buf[512];
+
+	va_start(args, fmt);
+	npf_vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	printstr(buf);
+	serial_sendstr(buf);
+}
+
+static void report(const char *name, uint64_t arg, uint64_t iterations, uint64_t cycles, uint64_t bytes)
+{
+	uint64_t per_iteration = iterations ? cycles / iterations : 0;
+	uint64_t mb_s = (bytes && cycles) ? (bytes * iterations * tsc_per_us) / cycles : 0;
+
+	report_line("AXBENCH name=%s arg=%llu iterations=%llu cycles=%llu ns=%llu mb_s=%llu\r\n",
+				name, arg, iterations, per_iteration, (per_iteration * 1000) / tsc_per_us, mb_s);
+}
+
+static void calibrate_tsc(void)
+{
+	uint64_t start = rdtsc();
+
+	gSystemTable->BootServices->Stall(10000);
+	tsc_per_us = (rdtsc() - start) / 10000;
+	if (tsc_per_us == 0) {
+		tsc_per_us = 1;
+	}
+}
+
+static void report_platform(void)
+{
+	char vendor[64];
+	CHAR16 *wvendor = gSystemTable->FirmwareVendor;
+	uint32_t i = 0;
+
+	for (; wvendor != NULL && wvendor[i] != 0 && i < sizeof(vendor) - 1; i++) {
+		vendor[i] = (wvendor[i] < 0x80 && wvendor[i] != ' ') ? (char)wvendor[i] : '_';
+	}
+	vendor[i] = '\0';
+
+	report_line("AXBENCH-INFO vendor=%s revision=0x%x uefi=%u.%u tsc_per_us=%llu\r\n",
+				vendor, gSystemTable->FirmwareRevision,
+				gSystemTable->Hdr.Revision >> 16, gSystemTable->Hdr.Revision & 0xffff,
+				tsc_per_us);
+}
+
+static void *alloc_pages(uint64_t size)
+{
+	EFI_PHYSICAL_ADDRESS addr = 0;
+	EFI_STATUS status;
+
+	status = gSystemTable->BootServices->AllocatePages(AllocateAnyPages, EfiLoaderData, SIZE_TO_PAGES(size), &addr);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to allocate %llu bytes: 0x%lx\r\n", size, status);
+		return NULL;
+	}
+
+	return (void *)addr;
+}
+
+static void free_pages(void *p, uint64_t size)
+{
+	gSystemTable->BootServices->FreePages((EFI_PHYSICAL_ADDRESS)p, SIZE_TO_PAGES(size));
+}
+
+///
+// File I/O
+///
+
+static void bench_file_read(const char *path)
+{
+	static const uint64_t chunk_sizes[] = {
+		4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024,
+		1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024,
+	};
+	const uint32_t passes = 3;
+	FILE *file;
+	uint64_t size;
+	void *buffer;
+
+	file = fw_file_open(NULL, path);
+	if (file == NULL) {
+		report_line("AXBENCH-SKIP name=file_read reason=open_failed\r\n");
+		return;
+	}
+	size = fw_file_size(file);
+	fw_file_close(file);
+
+	if (size == 0) {
+		report_line("AXBENCH-SKIP name=file_read reason=empty_file\r\n");
+		return;
+	}
+
+	buffer = alloc_pages(size);
+	if (buffer == NULL) {
+		report_line("AXBENCH-SKIP name=file_read reason=no_buffer\r\n");
+		return;
+	}
+
+	for (uint32_t c = 0; c < ARRAY_LENGTH(chunk_sizes); c++) {
+		uint64_t cycles = 0;
+		bool failed = false;
+
+		for (uint32_t pass = 0; pass < passes && !failed; pass++) {
+			file = fw_file_open(NULL, path);
+			if (file == NULL) {
+				failed = true;
+				break;
+			}
+
+			uint64_t start = rdtsc();
+			for (uint64_t offset = 0; offset < size; offset += chunk_sizes[c]) {
+				uint64_t len = (size - offset < chunk_sizes[c]) ? size - offset : chunk_sizes[c];
+				if (fw_file_read(file, len, (uint8_t *)buffer + offset) != 0) {
+					failed = true;
+					break;
+				}
+			}
+			cycles += rdtsc() - start;
+
+			fw_file_close(file);
+		}
+
+		if (failed) {
+			report_line("AXBENCH-SKIP name=file_read arg=%llu reason=read_failed\r\n", chunk_sizes[c]);
+			continue;
+		}
+		report("file_read", chunk_sizes[c], passes, cycles, size);
+	}
+
+	free_pages(buffer, size);
+}
+
+///
+// Memory allocation
+///
+
+static void bench_alloc(void)
+{
+	static const uint64_t sizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+	const uint32_t iterations = 256;
+	EFI_BOOT_SERVICES *bs = gSystemTable->BootServices;
+
+	for (uint32_t s = 0; s < ARRAY_LENGTH(sizes); s++) {
+		uint64_t alloc_cycles = 0;
+		uint64_t free_cycles = 0;
+		uint32_t i;
+
+		for (i = 0; i < iterations; i++) {
+			void *p = NULL;
+
+			uint64_t start = rdtsc();
+			if (EFI_ERROR(bs->AllocatePool(EfiLoaderData, sizes[s], &p))) {
+				break;
+			}
+			uint64_t mid = rdtsc();
+			bs->FreePool(p);
+			uint64_t end = rdtsc();
+
+			alloc_cycles += mid - start;
+			free_cycles += end - mid;
+		}
+		report("pool_alloc", sizes[s], i, alloc_cycles, 0);
+		report("pool_free", sizes[s], i, free_cycles, 0);
+
+		alloc_cycles = 0;
+		free_cycles = 0;
+		for (i = 0; i < iterations; i++) {
+			EFI_PHYSICAL_ADDRESS addr = 0;
+
+			uint64_t start = rdtsc();
+			if (EFI_ERROR(bs->AllocatePages(AllocateAnyPages, EfiLoaderData, SIZE_TO_PAGES(sizes[s]), &addr))) {
+				break;
+			}
+			uint64_t mid = rdtsc();
+			bs->FreePages(addr, SIZE_TO_PAGES(sizes[s]));
+			uint64_t end = rdtsc();
+
+			alloc_cycles += mid - start;
+			free_cycles += end - mid;
+		}
+		report("pages_alloc", sizes[s], i, alloc_cycles, 0);
+		report("pages_free", sizes[s], i, free_cycles, 0);
+	}
+}
+
+///
+// Memory map
+///
+
+static void bench_memory_map(void)
+{
+	const uint32_t iterations = 64;
+	EFI_BOOT_SERVICES *bs = gSystemTable->BootServices;
+	EFI_MEMORY_DESCRIPTOR *map = NULL;
+	EFI_UINTN size = 0;
+	EFI_UINTN key = 0;
+	EFI_UINTN desc_size = 0;
+	EFI_UINT32 desc_ver = 0;
+	EFI_UINTN buffer_size;
+	uint64_t cycles = 0;
+	uint32_t i;
+
+	bs->GetMemoryMap(&size, map, &key, &desc_size, &desc_ver);
+	buffer_size = size + (desc_size * 16);
+	if (EFI_ERROR(bs->AllocatePool(EfiLoaderData, buffer_size, (void **)&map))) {
+		report_line("AXBENCH-SKIP name=get_memory_map reason=no_buffer\r\n");
+		return;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		size = buffer_size;
+
+		uint64_t start = rdtsc();
+		EFI_STATUS status = bs->GetMemoryMap(&size, map, &key, &desc_size, &desc_ver);
+		cycles += rdtsc() - start;
+
+		if (EFI_ERROR(status)) {
+			break;
+		}
+	}
+	report("get_memory_map", desc_size ? size / desc_size : 0, i, cycles, 0);
+
+	bs->FreePool(map);
+}
+
+///
+// Graphics
+///
+
+static void bench_gop(void)
+{
+	const uint32_t max_set_modes = 4;
+	EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop = NULL;
+	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info = NULL;
+	EFI_UINTN info_size = 0;
+	uint64_t cycles = 0;
+	uint32_t original_mode;
+	uint32_t set_count = 0;
+
+	if (EFI_ERROR(gSystemTable->BootServices->LocateProtocol(&gop_guid, NULL, (VOID **)&gop))) {
+		report_line("AXBENCH-SKIP name=gop reason=no_gop\r\n");
+		return;
+	}
+	original_mode = gop->Mode->Mode;
+
+	for (uint32_t i = 0; i < gop->Mode->MaxMode; i++) {
+		uint64_t start = rdtsc();
+		EFI_STATUS status = gop->QueryMode(gop, i, &info_size, &info);
+		cycles += rdtsc() - start;
+
+		// every call hands out a new pool allocation
+		if (!EFI_ERROR(status)) {
+			gSystemTable->BootServices->FreePool(info);
+		}
+	}
+	report("gop_query_mode", gop->Mode->MaxMode, gop->Mode->MaxMode, cycles, 0);
+
+	// SetMode() clears the screen, so these are mostly useful on COM1
+	for (uint32_t i = 0; i < gop->Mode->MaxMode && set_count < max_set_modes; i++) {
+		if (i == original_mode) {
+			continue;
+		}
+
+		uint64_t start = rdtsc();
+		EFI_STATUS status = gop->SetMode(gop, i);
+		uint64_t end = rdtsc();
+
+		if (!EFI_ERROR(status)) {
+			report("gop_set_mode", i, 1, end - start, 0);
+			set_count++;
+		}
+	}
+
+	if (set_count > 0) {
+		uint64_t start = rdtsc();
+		gop->SetMode(gop, original_mode);
+		report("gop_set_mode", original_mode, 1, rdtsc() - start, 0);
+	}
+}
+
+///
+// Copy and fill bandwidth
+///
+
+static void copy_rep_movsb(void *dest, void *src, size_t len)
+{
+	__asm__ volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(len) :: "memory");
+}
+
+static void copy_rep_movsq(void *dest, void *src, size_t len)
+{
+	size_t qwords = len / 8;
+
+	__asm__ volatile("rep movsq" : "+D"(dest), "+S"(src), "+c"(qwords) :: "memory");
+}
+
+static void copy_axboot(void *dest, void *src, size_t len)
+{
+	memcpy(dest, src, len);
+}
+
+static void copy_boot_services(void *dest, void *src, size_t len)
+{
+	gSystemTable->BootServices->CopyMem(dest, src, len);
+}
+
+static void fill_rep_stosb(void *dest, size_t len)
+{
+	__asm__ volatile("rep stosb" : "+D"(dest), "+c"(len) : "a"(0) : "memory");
+}
+
+static void fill_axboot(void *dest, size_t len)
+{
+	memset(dest, 0, len);
+}
+
+static void fill_boot_services(void *dest, size_t len)
+{
+	gSystemTable->BootServices->SetMem(dest, len, 0);
+}
+
+static void bench_copy(void)
+{
+	static const uint64_t sizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+	static const struct {
+		const char *name;
+		void (*fn)(void *dest, void *src, size_t len);
+	} copies[] = {
+		{ "memcpy_axboot", copy_axboot },
+		{ "memcpy_rep_movsb", copy_rep_movsb },
+		{ "memcpy_rep_movsq", copy_rep_movsq },
+		{ "memcpy_boot_services", copy_boot_services },
+	};
+	static const struct {
+		const char *name;
+		void (*fn)(void *dest, size_t len);
+	} fills[] = {
+		{ "memset_axboot", fill_axboot },
+		{ "memset_rep_stosb", fill_rep_stosb },
+		{ "memset_boot_services", fill_boot_services },
+	};
+	uint8_t *src = alloc_pages(COPY_BUFFER_SIZE);
+	uint8_t *dest = alloc_pages(COPY_BUFFER_SIZE);
+
+	if (src == NULL || dest == NULL) {
+		report_line("AXBENCH-SKIP name=memcpy reason=no_buffer\r\n");
+		if (src != NULL) {
+			free_pages(src, COPY_BUFFER_SIZE);
+		}
+		if (dest != NULL) {
+			free_pages(dest, COPY_BUFFER_SIZE);
+		}
+		return;
+	}
+
+	// fault everything in before timing
+	fill_rep_stosb(src, COPY_BUFFER_SIZE);
+	fill_rep_stosb(dest, COPY_BUFFER_SIZE);
+
+	for (uint32_t s = 0; s < ARRAY_LENGTH(sizes); s++) {
+		uint64_t iterations = COPY_BYTES_PER_RUN / sizes[s];
+
+		for (uint32_t c = 0; c < ARRAY_LENGTH(copies); c++) {
+			uint64_t start = rdtsc();
+			for (uint64_t i = 0; i < iterations; i++) {
+				copies[c].fn(dest, src, sizes[s]);
+			}
+			report(copies[c].name, sizes[s], iterations, rdtsc() - start, sizes[s]);
+		}
+
+		for (uint32_t f = 0; f < ARRAY_LENGTH(fills); f++) {
+			uint64_t start = rdtsc();
+			for (uint64_t i = 0; i < iterations; i++) {
+				fills[f].fn(dest, sizes[s]);
+			}
+			report(fills[f].name, sizes[s], iterations, rdtsc() - start, sizes[s]);
+		}
+	}
+
+	free_pages(src, COPY_BUFFER_SIZE);
+	free_pages(dest, COPY_BUFFER_SIZE);
+}
+
+///
+// Serial
+///
+
+static void bench_serial(void)
+{
+	const uint32_t lines = 64;
+	char line[64];
+	uint64_t start;
+
+	memset(line, 'x', sizeof(line));
+	memcpy(line, "AXBENCH-PAD ", 12);
+	line[sizeof(line) - 2] = '\n';
+	line[sizeof(line) - 1] = '\0';
+
+	start = rdtsc();
+	for (uint32_t i = 0; i < lines; i++) {
+		serial_sendstr(line);
+	}
+	report("serial_write", sizeof(line) - 1, lines, rdtsc() - start, sizeof(line) - 1);
+}
+
+///
+// ExitBootServices
+///
+
+static void bench_exit_boot_services(void)
+{
+	uint64_t start = rdtsc();
+	uint64_t cycles;
+
+	uefi_exit_boot_services();
+	cycles = rdtsc() - start;
+
+	// boot services and ConOut are gone
+	debug("AXBENCH name=exit_boot_services arg=0 iterations=1 cycles=%llu ns=%llu mb_s=0\r\n",
+		  cycles, (cycles * 1000) / tsc_per_us);
+	debug("AXBENCH-DONE\r\n");
+}
+
+EFI_STATUS axbench_entry(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
+{
+	struct config_entry *entry;
+	const char *path = AXBENCH_DATA_FILE;
+	FILE *file;
+
+	gImageHandle = ImageHandle;
+	gSystemTable = SystemTable;
+
+	gSystemTable->BootServices->SetWatchdogTimer(0, 0, 0, NULL);
+
+	if (firmware_init() != 0) {
+		log("AXBENCH: couldn't initialize firmware services\r\n");
+		return EFI_LOAD_ERROR;
+	}
+
+	calibrate_tsc();
+	report_platform();
+
+	// read \axbench.dat if there is one, the default entry's kernel otherwise
+	file = fw_file_open(NULL, path);
+	if (file != NULL) {
+		fw_file_close(file);
+	} else {
+		config_init();
+		entry = config_get_default_entry();
+		path = entry ? entry->image_path : NULL;
+	}
+
+	if (path != NULL) {
+		bench_file_read(path);
+	}
+	bench_alloc();
+	bench_memory_map();
+	bench_copy();
+	bench_serial();
+	bench_gop();
+	bench_exit_boot_services();
+
+	gSystemTable->RuntimeServices->ResetSystem(EfiResetShutdown, EFI_SUCCESS, 0, NULL);
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,377 @@
+/*********************************************************************************/
+/* Module Name:  axtrace.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// axtrace: decodes the binary trace records AxBoot writes in trace mode
+// (see include/lib/trace.h) using the call site table from its image.
+//
+// Usage: axtrace [-r] [-f tsc_hz] <image|table> [input]
+//        axtrace -x <image> <table>
+//
+// The input defaults to stdin and is a serial capture, where anything
+// outside a trace frame is passed through as is. With -r it is the raw
+// ABP log ring instead, records back to back starting at its tail.
+//
+
+#include <lib/logring.h>
+#include <lib/trace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+static char *table = NULL;
+static size_t table_size = 0;
+
+static uint64_t tsc_hz = 0;
+static uint64_t first_tsc = 0;
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE *file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+	uint8_t *buffer = NULL;
+	size_t capacity = 0;
+	size_t n;
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	*size = 0;
+	do {
+		if (*size == capacity) {
+			capacity = capacity ? capacity * 2 : 64 * 1024;
+			buffer = realloc(buffer, capacity);
+			if (buffer == NULL) {
+				return NULL;
+			}
+		}
+		n = fread(buffer + *size, 1, capacity - *size, file);
+		*size += n;
+	} while (n > 0);
+
+	if (file != stdin) {
+		fclose(file);
+	}
+	return buffer;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+// Finds the .axtrace section in a PE image
+static int load_table(const char *path)
+{
+	size_t size;
+	uint8_t *image = read_file(path, &size);
+
+	if (image == NULL) {
+		fprintf(stderr, "axtrace: couldn't read '%s'\n", path);
+		return -1;
+	}
+
+	// already extracted
+	if (size >= sizeof(TRACE_MAGIC) && memcmp(image, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0) {
+		table = (char *)image;
+		table_size = size;
+		return 0;
+	}
+
+	if (size < 0x40 || image[0] != 'M' || image[1] != 'Z') {
+		fprintf(stderr, "axtrace: '%s' is neither a PE image nor a trace table\n", path);
+		return -1;
+	}
+
+	uint32_t pe = get32(image + 0x3c);
+	if (pe + 24 > size || memcmp(image + pe, "PE\0\0", 4) != 0) {
+		fprintf(stderr, "axtrace: '%s' has no PE header\n", path);
+		return -1;
+	}
+
+	uint16_t section_count = get16(image + pe + 6);
+	uint16_t optional_size = get16(image + pe + 20);
+	uint8_t *section = image + pe + 24 + optional_size;
+
+	for (uint16_t i = 0; i < section_count; i++, section += 40) {
+		if (section + 40 > image + size) {
+			break;
+		}
+		if (memcmp(section, ".axtrace", 8) != 0) {
+			continue;
+		}
+
+		uint32_t virtual_size = get32(section + 8);
+		uint32_t raw_size = get32(section + 16);
+		uint32_t raw_offset = get32(section + 20);
+
+		table_size = (virtual_size && virtual_size < raw_size) ? virtual_size : raw_size;
+		if (raw_offset + table_size > size) {
+			break;
+		}
+		table = (char *)image + raw_offset;
+		return 0;
+	}
+
+	fprintf(stderr, "axtrace: '%s' has no .axtrace section, was it built with TRACE=yes?\n", path);
+	return -1;
+}
+
+static void put_text(const char *text, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (text[i] != '\r') {
+			putchar(text[i]);
+		}
+	}
+}
+
+// Prints one conversion with its '*' arguments folded into the format
+static void print_spec(const struct trace_spec *spec, const uint64_t *stars, const uint8_t *arg, size_t arg_size)
+{
+	char fmt[64];
+	size_t len = 0;
+	int star = 0;
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < spec->length && len < sizeof(fmt) - 24; i++) {
+		if (spec->start[i] == '*') {
+			len += snprintf(fmt + len, sizeof(fmt) - len, "%d", (int)stars[star++]);
+		} else {
+			fmt[len++] = spec->start[i];
+		}
+	}
+	fmt[len] = '\0';
+
+	// strings aren't terminated, so their length always goes in as the precision
+	if (spec->type == TraceArgString) {
+		char *dot = strchr(fmt, '.');
+		size_t str_len = arg_size;
+
+		if (dot != NULL) {
+			size_t precision = strtoul(dot + 1, NULL, 10);
+			if (precision < str_len) {
+				str_len = precision;
+			}
+		} else {
+			dot = fmt + len - 1;
+		}
+		strcpy(dot, ".*s");
+
+		printf(fmt, (int)str_len, (const char *)arg);
+		return;
+	}
+
+	memcpy(&value, arg, sizeof(uint64_t));
+	switch (spec->type) {
+		case TraceArgPointer:
+			printf(fmt, (void *)(uintptr_t)value);
+			break;
+		case TraceArgLong:
+			printf(fmt, (unsigned long long)value);
+			break;
+		case TraceArgDouble: {
+			double d;
+			memcpy(&d, &value, sizeof(double));
+			printf(fmt, d);
+			break;
+		}
+		default:
+			printf(fmt, (unsigned int)value);
+			break;
+	}
+}
+
+static void decode_record(const uint8_t *data, size_t size)
+{
+	struct trace_header header;
+	struct trace_spec spec;
+	const char *site;
+	const char *fmt;
+	const char *text;
+	size_t offset = sizeof(struct trace_header);
+
+	if (size < sizeof(struct trace_header)) {
+		printf("<short trace record>\n");
+		return;
+	}
+	memcpy(&header, data, sizeof(struct trace_header));
+
+	if (header.id < sizeof(TRACE_MAGIC) || header.id >= table_size) {
+		printf("<unknown trace site %u>\n", header.id);
+		return;
+	}
+	site = table + header.id;
+	fmt = site + strlen(site) + 1;
+
+	if (first_tsc == 0) {
+		first_tsc = header.tsc;
+	}
+	if (tsc_hz != 0) {
+		printf("[%12.6f] ", (double)(header.tsc - first_tsc) / (double)tsc_hz);
+	} else {
+		printf("[%14llu] ", (unsigned long long)(header.tsc - first_tsc));
+	}
+	printf("%s: ", site);
+
+	text = fmt;
+	while ((fmt = trace_next_spec(text, &spec)) != NULL) {
+		uint64_t stars[2] = {0};
+
+		put_text(text, spec.start - text);
+		text = fmt;
+
+		for (int i = 0; i < spec.stars; i++) {
+			if (offset + sizeof(uint64_t) > size) {
+				goto truncated;
+			}
+			if (i < 2) {
+				memcpy(&stars[i], data + offset, sizeof(uint64_t));
+			}
+			offset += sizeof(uint64_t);
+		}
+
+		if (spec.type == TraceArgString) {
+			uint16_t len;
+
+			if (offset + sizeof(uint16_t) > size) {
+				goto truncated;
+			}
+			len = get16(data + offset);
+			offset += sizeof(uint16_t);
+			if (offset + len > size) {
+				goto truncated;
+			}
+
+			print_spec(&spec, stars, data + offset, len);
+			offset += len;
+		} else {
+			if (offset + sizeof(uint64_t) > size) {
+				goto truncated;
+			}
+			print_spec(&spec, stars, data + offset, sizeof(uint64_t));
+			offset += sizeof(uint64_t);
+		}
+	}
+	put_text(text, strlen(text));
+	return;
+
+truncated:
+	printf("<truncated>\n");
+}
+
+static void decode_stream(const uint8_t *data, size_t size, int raw)
+{
+	struct log_record record;
+	size_t i = 0;
+
+	while (i < size) {
+		if (!raw && data[i] != TRACE_FRAME_SYNC) {
+			// plain text around the frames, typically firmware output
+			put_text((const char *)data + i, 1);
+			i++;
+			continue;
+		}
+
+		size_t start = raw ? i : i + 1;
+		if (start + sizeof(struct log_record) > size) {
+			break;
+		}
+		memcpy(&record, data + start, sizeof(struct log_record));
+		start += sizeof(struct log_record);
+		if (start + record.length > size) {
+			break;
+		}
+
+		if (record.level == LogLevelTrace) {
+			decode_record(data + start, record.length);
+		} else {
+			// text records only show up in the raw ring
+			put_text((const char *)data + start, record.length);
+		}
+		i = start + record.length;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *input = "-";
+	uint8_t *data;
+	size_t size;
+	int raw = 0;
+	int arg = 1;
+
+	if (argc == 4 && strcmp(argv[1], "-x") == 0) {
+		FILE *out;
+
+		if (load_table(argv[2]) != 0) {
+			return 1;
+		}
+
+		out = fopen(argv[3], "wb");
+		if (out == NULL || fwrite(table, 1, table_size, out) != table_size) {
+			fprintf(stderr, "axtrace: couldn't write '%s'\n", argv[3]);
+			return 1;
+		}
+		fclose(out);
+		return 0;
+	}
+
+	while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+		if (strcmp(argv[arg], "-r") == 0) {
+			raw = 1;
+			arg++;
+		} else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+			tsc_hz = strtoull(argv[arg + 1], NULL, 0);
+			arg += 2;
+		} else {
+			break;
+		}
+	}
+
+	if (arg >= argc || argc - arg > 2) {
+		fprintf(stderr, "Usage: %s [-r] [-f tsc_hz] <image|table> [input]\n", argv[0]);
+		fprintf(stderr, "       %s -x <image> <table>\n", argv[0]);
+		return 1;
+	}
+
+	if (load_table(argv[arg]) != 0) {
+		return 1;
+	}
+	if (arg + 1 < argc) {
+		input = argv[arg + 1];
+	}
+
+	data = read_file(input, &size);
+	if (data == NULL) {
+		fprintf(stderr, "axtrace: couldn't read '%s'\n", input);
+		return 1;
+	}
+
+	decode_stream(data, size, raw);
+	return 0;
+}
@@ -0,0 +1,285 @@
+#!/bin/sh
+###################################################################################
+## Module Name:  bench-boot.sh                                                   ##
+## Project:      AurixOS                                                         ##
+##                                                                               ##
+## Copyright (c) 2024 Jozef Nagy                                                 ##
+##                                                                               ##
+## This source is subject to the MIT License.                                    ##
+## See License.txt in the root of this repository.                               ##
+## All other rights reserved.                                                    ##
+##                                                                               ##
+## THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    ##
+## IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      ##
+## FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   ##
+## AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        ##
+## LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, ##
+## OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE ##
+## SOFTWARE.                                                                     ##
+###################################################################################
+
+#
+# Boots the bench kernel under QEMU/OVMF and reports the boot timeline.
+# Normally run through `make bench-boot`.
+#
+# Environment:
+#   BENCH_DIR     output directory (ESPs, serial logs, results.json)
+#   SYSROOT_DIR   ESP contents; must contain EFI/BOOT/BOOTX64.EFI
+#   KERNEL_SIZES  kernel image sizes in MiB; BENCH_DIR/kernel-<n>M.elf
+#   MEM_SIZES     guest memory sizes in GiB
+#   RUNS          boots per configuration
+#   BASELINE      results.json of an earlier run to compare against
+#   THRESHOLD     allowed regression of a median, in percent
+#   QEMU          QEMU binary
+#   OVMF          OVMF firmware image
+#   TIMEOUT       seconds before a boot counts as hung
+#
+# All timestamps are TSC cycles. QEMU starts the TSC at 0 on reset, so the
+# loader's entry timestamp is the time spent in firmware.
+#
+
+set -e
+
+BENCH_DIR=${BENCH_DIR:-build/bench-boot}
+SYSROOT_DIR=${SYSROOT_DIR:-sysroot}
+KERNEL_SIZES=${KERNEL_SIZES:-1 16 128}
+MEM_SIZES=${MEM_SIZES:-1 16 256}
+RUNS=${RUNS:-10}
+THRESHOLD=${THRESHOLD:-5}
+QEMU=${QEMU:-qemu-system-x86_64}
+TIMEOUT=${TIMEOUT:-120}
+
+if [ -z "$OVMF" ]; then
+	for f in /usr/share/ovmf/OVMF.fd /usr/share/OVMF/OVMF.fd /usr/share/qemu/OVMF.fd \
+			/usr/share/edk2/x64/OVMF.fd /usr/share/edk2-ovmf/x64/OVMF.fd; do
+		if [ -f "$f" ]; then
+			OVMF=$f
+			break
+		fi
+	done
+fi
+
+if [ -z "$OVMF" ] || [ ! -f "$OVMF" ]; then
+	echo "bench-boot: OVMF not found, set OVMF=/path/to/OVMF.fd" >&2
+	exit 1
+fi
+
+if [ ! -f "$SYSROOT_DIR/EFI/BOOT/BOOTX64.EFI" ]; then
+	echo "bench-boot: $SYSROOT_DIR/EFI/BOOT/BOOTX64.EFI is missing" >&2
+	exit 1
+fi
+
+if [ -w /dev/kvm ]; then
+	ACCEL="-accel kvm -cpu host"
+else
+	ACCEL="-accel tcg"
+fi
+
+RAW=$BENCH_DIR/raw.txt
+RESULTS=$BENCH_DIR/results.json
+
+mkdir -p "$BENCH_DIR/logs"
+: > "$RAW"
+
+failures=0
+
+for k in $KERNEL_SIZES; do
+	esp=$BENCH_DIR/esp-${k}M
+
+	rm -rf "$esp"
+	mkdir -p "$esp"
+	cp -R "$SYSROOT_DIR/." "$esp/"
+	cp "$BENCH_DIR/kernel-${k}M.elf" "$esp/bench.elf"
+	rm -f "$esp/axboot.bin"
+	cat > "$esp/axboot.cfg" <<CFG
+TIMEOUT=0
+DEFAULT_ENTRY="bench"
+
+entry "bench" {
+    PROTOCOL="aurix"
+    IMAGE_PATH="boot:///bench.elf"
+}
+CFG
+
+	for m in $MEM_SIZES; do
+		run=1
+		while [ "$run" -le "$RUNS" ]; do
+			log=$BENCH_DIR/logs/k${k}M-m${m}G-r${run}.log
+			printf "  BOOT\tkernel=%sM mem=%sG run %s/%s\n" "$k" "$m" "$run" "$RUNS"
+
+			start=$(date +%s%N)
+			timeout "$TIMEOUT" "$QEMU" -machine q35 -smp 1 -m "${m}G" $ACCEL \
+				-bios "$OVMF" \
+				-drive format=raw,file=fat:"$esp" \
+				-serial file:"$log" \
+				-display none -nic none -no-reboot \
+				-device isa-debug-exit,iobase=0xf4,iosize=0x04 || true
+			end=$(date +%s%N)
+
+			line=$(grep -a '^AXBENCH ' "$log" | tail -n 1 || true)
+			if [ -z "$line" ]; then
+				echo "bench-boot: no timestamps in $log" >&2
+				failures=$((failures + 1))
+			else
+				echo "kernel_mib=$k mem_gib=$m wall_ns=$((end - start)) ${line#AXBENCH }" >> "$RAW"
+			fi
+
+			run=$((run + 1))
+		done
+	done
+done
+
+awk -v runs="$RUNS" '
+function field(name,    i, kv) {
+	for (i = 1; i <= NF; i++) {
+		split($i, kv, "=")
+		if (kv[1] == name) {
+			return kv[2] + 0
+		}
+	}
+	return 0
+}
+
+function add(phase, value,    key) {
+	key = cfg SUBSEP phase
+	n[key]++
+	v[key, n[key]] = value
+}
+
+# nearest-rank percentile
+function pct(key, p,    i, j, t, rank, a) {
+	for (i = 1; i <= n[key]; i++) {
+		a[i] = v[key, i]
+	}
+	for (i = 2; i <= n[key]; i++) {
+		t = a[i]
+		for (j = i - 1; j >= 1 && a[j] > t; j--) {
+			a[j + 1] = a[j]
+		}
+		a[j + 1] = t
+	}
+	rank = int((p * n[key]) / 100)
+	if (rank < (p * n[key]) / 100) {
+		rank++
+	}
+	if (rank < 1) {
+		rank = 1
+	}
+	return a[rank]
+}
+
+BEGIN {
+	nphases = split("firmware config menu load paging handoff kernel total wall_ms", phases, " ")
+}
+
+{
+	cfg = field("kernel_mib") SUBSEP field("mem_gib")
+	if (!(cfg in seen)) {
+		seen[cfg] = 1
+		order[++ncfg] = cfg
+	}
+
+	add("firmware", field("loader_entry"))
+	add("config", field("config_loaded") - field("loader_entry"))
+	add("menu", field("menu_done") - field("config_loaded"))
+	add("load", field("kernel_loaded") - field("menu_done"))
+	add("paging", field("paging_done") - field("kernel_loaded"))
+	add("handoff", field("handoff") - field("paging_done"))
+	add("kernel", field("kernel_entry") - field("handoff"))
+	add("total", field("kernel_entry"))
+	add("wall_ms", int(field("wall_ns") / 1000000))
+}
+
+END {
+	printf "%-8s %-8s %-10s %14s %14s\n", "kernel", "memory", "phase", "median", "p95"
+	print "------------------------------------------------------------"
+
+	print "{" > json
+	printf "  \"runs\": %d,\n", runs > json
+	print "  \"results\": [" > json
+
+	first = 1
+	for (c = 1; c <= ncfg; c++) {
+		split(order[c], parts, SUBSEP)
+		for (p = 1; p <= nphases; p++) {
+			key = order[c] SUBSEP phases[p]
+			med = pct(key, 50)
+			p95 = pct(key, 95)
+
+			if (phases[p] == "wall_ms") {
+				printf "%-8s %-8s %-10s %11d ms %11d ms\n", parts[1] "M", parts[2] "G", phases[p], med, p95
+			} else {
+				printf "%-8s %-8s %-10s %14.3f %14.3f Mcycles\n", parts[1] "M", parts[2] "G", phases[p], med / 1e6, p95 / 1e6
+			}
+
+			if (!first) {
+				print "," > json
+			}
+			first = 0
+			printf "    {\"kernel_mib\": %d, \"mem_gib\": %d, \"phase\": \"%s\", \"median\": %.0f, \"p95\": %.0f, \"samples\": %d}", \
+				parts[1], parts[2], phases[p], med, p95, n[key] > json
+		}
+	}
+
+	print "" > json
+	print "  ]" > json
+	print "}" > json
+}
+' json="$RESULTS" "$RAW"
+
+echo "Results written to $RESULTS"
+
+if [ -n "$BASELINE" ]; then
+	echo
+	echo "Comparing against $BASELINE (threshold ${THRESHOLD}%)"
+
+	# Phases regress when their median grows by more than the threshold and
+	# by more than 1% of the baseline's total, so tiny phases don't flap.
+	awk -v threshold="$THRESHOLD" '
+	function get(line, name,    re, s) {
+		re = "\"" name "\": *\"?[^,\"}]*"
+		if (match(line, re)) {
+			s = substr(line, RSTART, RLENGTH)
+			sub(/^[^:]*: *"?/, "", s)
+			return s
+		}
+		return ""
+	}
+
+	/"kernel_mib"/ {
+		key = get($0, "kernel_mib") " " get($0, "mem_gib") " " get($0, "phase")
+		if (FILENAME == ARGV[1]) {
+			base[key] = get($0, "median") + 0
+		} else {
+			cur[key] = get($0, "median") + 0
+			keys[++nkeys] = key
+		}
+	}
+
+	END {
+		bad = 0
+		printf "%-8s %-8s %-10s %14s %14s %8s\n", "kernel", "memory", "phase", "baseline", "current", "delta"
+		for (i = 1; i <= nkeys; i++) {
+			key = keys[i]
+			if (!(key in base)) {
+				continue
+			}
+			split(key, parts, " ")
+			total = base[parts[1] " " parts[2] " " (parts[3] == "wall_ms" ? "wall_ms" : "total")]
+			delta = base[key] ? ((cur[key] - base[key]) * 100) / base[key] : 0
+			mark = ""
+			if (delta > threshold && cur[key] - base[key] > total / 100) {
+				mark = "  REGRESSION"
+				bad = 1
+			}
+			printf "%-8s %-8s %-10s %14.0f %14.0f %+7.1f%%%s\n", parts[1] "M", parts[2] "G", parts[3], base[key], cur[key], delta, mark
+		}
+		exit bad
+	}
+	' "$BASELINE" "$RESULTS"
+fi
+
+if [ "$failures" -gt 0 ]; then
+	echo "bench-boot: $failures boot(s) failed" >&2
+	exit 1
+fi
@@ -0,0 +1,87 @@
+/*********************************************************************************/
+/* Module Name:  kernel.c                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// Minimal ABP kernel for `make bench-boot`. Prints the loader's boot
+// timeline and its own entry timestamp on COM1 as a single line, then
+// shuts QEMU down through the isa-debug-exit device.
+//
+
+#include <protocol/abp.h>
+#include <arch/cpu/cpu.h>
+
+#include <stdint.h>
+
+#define COM1 0x3f8
+#define DEBUG_EXIT_PORT 0xf4
+
+ABP_REQUEST(hhdm_request, ABP_REQUEST_HHDM, struct abp_hhdm_request, 0xffff800000000000);
+ABP_REQUEST(paging_request, ABP_REQUEST_PAGING, struct abp_paging_request, ABP_PAGING_2M | ABP_PAGING_1G);
+
+static void serial_putc(char c)
+{
+	while (!(inb(COM1 + 5) & 0x20));
+	outb(COM1, c);
+}
+
+static void serial_puts(const char *s)
+{
+	while (*s != '\0') {
+		serial_putc(*s++);
+	}
+}
+
+static void serial_put_field(const char *name, uint64_t value)
+{
+	char buf[21];
+	int i = sizeof(buf) - 1;
+
+	buf[i] = '\0';
+	do {
+		buf[--i] = '0' + (value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	serial_putc(' ');
+	serial_puts(name);
+	serial_putc('=');
+	serial_puts(&buf[i]);
+}
+
+__attribute__((ms_abi, noreturn))
+void _start(struct abp_boot_info *info)
+{
+	uint64_t kernel_entry = rdtsc();
+
+	serial_puts("AXBENCH");
+	serial_put_field("loader_entry", info->timestamps.loader_entry);
+	serial_put_field("config_loaded", info->timestamps.config_loaded);
+	serial_put_field("menu_done", info->timestamps.menu_done);
+	serial_put_field("kernel_loaded", info->timestamps.kernel_loaded);
+	serial_put_field("paging_done", info->timestamps.paging_done);
+	serial_put_field("handoff", info->timestamps.handoff);
+	serial_put_field("kernel_entry", kernel_entry);
+	serial_puts("\n");
+
+	outb(DEBUG_EXIT_PORT, 0);
+
+	for (;;) {
+		__asm__ volatile("cli; hlt");
+	}
+}
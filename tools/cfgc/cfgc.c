@@ -0,0 +1,198 @@
+/*********************************************************************************/
+/* Module Name:  cfgc.c                                                          */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+//
+// axboot-cfgc: compiles axboot.cfg into the binary configuration format
+// described in include/config/binary.h.
+//
+// Usage: axboot-cfgc [-s] <axboot.cfg> <axboot.bin>
+//
+// -s makes the loader checksum axboot.cfg on every boot to catch edits
+// that keep its size; by default only the size is compared.
+//
+
+#include <config/config.h>
+#include <config/binary.h>
+#include <lib/crc32.h>
+#include <lib/string.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define CFGC_MAX_STRINGS (64 * 1024)
+
+// the parser reports errors through the bootloader's print functions
+void log(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+void debug(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+static char string_pool[CFGC_MAX_STRINGS];
+static uint32_t string_pool_size = 0;
+
+static uint32_t add_string(const char *str)
+{
+	uint32_t offset = string_pool_size;
+	size_t len = strlen(str) + 1;
+
+	if (string_pool_size + len > sizeof(string_pool)) {
+		fprintf(stderr, "axboot-cfgc: string pool overflow\n");
+		return 0;
+	}
+
+	memcpy(string_pool + string_pool_size, (void *)str, len);
+	string_pool_size += len;
+	return offset;
+}
+
+static char *read_file(const char *path, long *size)
+{
+	FILE *file = fopen(path, "rb");
+	char *buffer;
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	buffer = malloc(*size + 1);
+	if (buffer == NULL || fread(buffer, 1, *size, file) != (size_t)*size) {
+		fclose(file);
+		return NULL;
+	}
+	buffer[*size] = '\0';
+
+	fclose(file);
+	return buffer;
+}
+
+int main(int argc, char **argv)
+{
+	static struct config config;
+	struct config_bin_header header;
+	struct config_bin_entry entries[CONFIG_MAX_ENTRIES];
+	uint8_t *image;
+	uint32_t total_size;
+	uint32_t source_crc;
+	uint32_t splash_path;
+	uint32_t flags = 0;
+	long source_size;
+	char *source;
+	FILE *out;
+
+	if (argc == 4 && memcmp(argv[1], "-s", 3) == 0) {
+		flags |= CONFIG_BIN_VERIFY_SOURCE;
+		argc--;
+		argv++;
+	}
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: axboot-cfgc [-s] <axboot.cfg> <axboot.bin>\n");
+		return 1;
+	}
+
+	source = read_file(argv[1], &source_size);
+	if (source == NULL) {
+		fprintf(stderr, "axboot-cfgc: couldn't read '%s'\n", argv[1]);
+		return 1;
+	}
+
+	// the parser tokenizes in place, so checksum the source first
+	source_crc = crc32(source, source_size);
+
+	if (config_parse(source, source_size, &config) != 0) {
+		fprintf(stderr, "axboot-cfgc: '%s' has errors, not compiling\n", argv[1]);
+		return 1;
+	}
+
+	// offset 0 of the pool is reserved so no valid string starts there
+	add_string("");
+	splash_path = (config.splash_path != NULL) ? add_string(config.splash_path) : 0;
+
+	memset(entries, 0, sizeof(entries));
+	for (uint32_t i = 0; i < config.entry_count; i++) {
+		struct config_entry *entry = &config.entries[i];
+
+		entries[i].name = add_string(entry->name);
+		entries[i].protocol = (uint32_t)entry->protocol;
+		entries[i].image_path = add_string(entry->image_path);
+		entries[i].module_count = entry->module_count;
+		for (uint32_t j = 0; j < entry->module_count; j++) {
+			entries[i].module_paths[j] = add_string(entry->module_paths[j]);
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = CONFIG_BIN_MAGIC;
+	header.version = CONFIG_BIN_VERSION;
+	header.header_size = sizeof(struct config_bin_header);
+	header.source_size = (uint32_t)source_size;
+	header.source_crc = source_crc;
+	header.flags = flags;
+	header.timeout = config.timeout;
+	header.default_entry = config.default_entry;
+	header.serial_port = config.serial_port;
+	header.serial_baud = config.serial_baud;
+	header.video_mode = config.video_mode;
+	header.video_width = config.video_width;
+	header.video_height = config.video_height;
+	header.splash_path = splash_path;
+	header.entry_count = config.entry_count;
+	header.entry_offset = sizeof(struct config_bin_header);
+	header.strings_offset = header.entry_offset + config.entry_count * sizeof(struct config_bin_entry);
+	header.strings_size = string_pool_size;
+
+	total_size = header.strings_offset + header.strings_size;
+	header.total_size = total_size;
+
+	image = malloc(total_size);
+	if (image == NULL) {
+		fprintf(stderr, "axboot-cfgc: out of memory\n");
+		return 1;
+	}
+
+	memcpy(image + header.entry_offset, entries, config.entry_count * sizeof(struct config_bin_entry));
+	memcpy(image + header.strings_offset, string_pool, string_pool_size);
+	header.checksum = crc32(image + header.header_size, total_size - header.header_size);
+	memcpy(image, &header, sizeof(header));
+
+	out = fopen(argv[2], "wb");
+	if (out == NULL || fwrite(image, 1, total_size, out) != total_size) {
+		fprintf(stderr, "axboot-cfgc: couldn't write '%s'\n", argv[2]);
+		return 1;
+	}
+	fclose(out);
+
+	printf("axboot-cfgc: %u entries, %u bytes\n", config.entry_count, total_size);
+	return 0;
+}
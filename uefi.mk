@@ -56,11 +56,14 @@ UEFI_CFLAGS := $(CFLAGS) \
 				-mno-sse \
 				-mno-sse2
 
+ifeq ($(TRACE),yes)
+UEFI_CFLAGS += -DAXBOOT_TRACE=1
+endif
+
 UEFI_LDFLAGS := $(LDFLAGS) \
 				-target $(ARCH)-unknown-windows \
 				-fuse-ld=lld-link \
-				-Wl,-subsystem:efi_application \
-				-Wl,-entry:uefi_entry
+				-Wl,-subsystem:efi_application
 
 UEFI_CFILES := $(shell find uefi -name '*.c') $(shell find arch/$(ARCH)/uefi -name '*.c')
 UEFI_ASFILES := $(shell find uefi -name '*.S') $(shell find arch/$(ARCH)/uefi -name '*.S')
@@ -80,7 +83,23 @@ install-uefi:
 $(UEFI_BOOTFILE): $(UEFI_OBJ)
 	@mkdir -p $(@D)
 	@printf "  LD\t$(notdir $@)\n"
-	@$(UEFI_LD) $(UEFI_LDFLAGS) $^ -o $@
+	@$(UEFI_LD) $(UEFI_LDFLAGS) -Wl,-entry:uefi_entry $^ -o $@
+
+# firmware microbenchmarks, sharing everything but the entry point
+AXBENCH_FILE := $(BUILD_DIR)/boot/tools/AXBENCH.EFI
+AXBENCH_OBJ := $(filter-out $(BUILD_DIR)/boot/uefi/entry.c.o, $(UEFI_OBJ)) \
+				$(BUILD_DIR)/boot/tools/axbench/axbench.c.o
+
+.PHONY: install-axbench
+install-axbench:
+	@mkdir -p $(SYSROOT_DIR)
+	@printf "  INSTALL\t/AXBENCH.EFI\n"
+	@cp $(AXBENCH_FILE) $(SYSROOT_DIR)/
+
+$(AXBENCH_FILE): $(AXBENCH_OBJ)
+	@mkdir -p $(@D)
+	@printf "  LD\t$(notdir $@)\n"
+	@$(UEFI_LD) $(UEFI_LDFLAGS) -Wl,-entry:axbench_entry $^ -o $@
 
 -include $(wildcard $(BUILD_DIR)/boot/*.d)
 
@@ -94,6 +113,11 @@ $(BUILD_DIR)/boot/uefi/common/%.c.o: common/%.c
 	@printf "  CC\t$<\n"
 	@$(UEFI_CC) $(UEFI_CFLAGS) -c $< -o $@
 
+$(BUILD_DIR)/boot/tools/%.c.o: tools/%.c
+	@mkdir -p $(@D)
+	@printf "  CC\t$<\n"
+	@$(UEFI_CC) $(UEFI_CFLAGS) -c $< -o $@
+
 $(BUILD_DIR)/boot/uefi/arch/%.c.o: arch/$(ARCH)/common/%.c
 	@mkdir -p $(@D)
 	@printf "  CC\t$<\n"
@@ -20,11 +20,15 @@
 #include <efi.h>
 #include <efilib.h>
 
-#include <firmware/firmware.h>
+#include <config/config.h>
+#include <debug/serial.h>
 #include <firmware/fb.h>
+#include <firmware/firmware.h>
 #include <menu/menu.h>
 #include <loader/loader.h>
 #include <loader/elf.h>
+#include <lib/logring.h>
+#include <lib/timestamp.h>
 #include <print.h>
 
 #include <stddef.h>
@@ -34,11 +38,13 @@ EFI_STATUS uefi_entry(EFI_HANDLE ImageHandle,
 {
     EFI_STATUS Status;
 
+    timestamp_record(TimestampLoaderEntry);
+
     gImageHandle = ImageHandle;
     gSystemTable = SystemTable;
 
-    // clear the screen
-    gSystemTable->ConOut->ClearScreen(gSystemTable->ConOut);
+    // from here on log output is buffered and drained when there's time
+    logring_init();
 
     // disable UEFI watchdog
     Status = gSystemTable->BootServices->SetWatchdogTimer(0, 0, 0, NULL);
@@ -48,15 +54,27 @@ EFI_STATUS uefi_entry(EFI_HANDLE ImageHandle,
 
     firmware_init();
 
-    if (fw_initialize_fb() != 0) {
-        debug("No valid framebuffer was found!\r\n");
-    }
+    // the TSC is measured while the loader waits on the menu and the disk
+    timestamp_calibration_start();
+    config_init();
+    serial_configure(config_get_serial_port(), config_get_serial_baud());
+
+    uint32_t video_width, video_height;
+    config_get_video_resolution(&video_width, &video_height);
+    fw_set_fb_policy(config_get_video_mode(), video_width, video_height);
+
+    // modules are read during the menu, so point allocations at mirrored or BSP-local memory first
+    loader_init_placement();
+    timestamp_record(TimestampConfigLoaded);
 
-    //menu_main();
+    // the console and the framebuffer are only set up when they're needed
+    struct config_entry *entry = menu_main();
+    timestamp_record(TimestampMenuDone);
 
-    loader_load(ProtocolAbp, "\\System\\axkrnl");
+    loader_load(entry);
 
     debug("Tried to return from main()! Halting...\r\n");
+    logring_drain(LOG_SINKS_ALL, 0);
     while(1);
 
     return EFI_SUCCESS;
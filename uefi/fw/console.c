@@ -0,0 +1,161 @@
+/*********************************************************************************/
+/* Module Name:  console.c                                                       */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <firmware/firmware.h>
+#include <firmware/console.h>
+#include <lib/fbcon.h>
+#include <print.h>
+#include <efi.h>
+#include <efilib.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCAN_UP 0x01
+#define SCAN_DOWN 0x02
+#define SCAN_ESC 0x17
+
+// the menu draws through the framebuffer console when there is one, ConOut
+// redraws glyph by glyph through the firmware's font on every call
+void fw_console_init(void)
+{
+	gSystemTable->ConOut->EnableCursor(gSystemTable->ConOut, FALSE);
+	if (fbcon_init() == 0) {
+		fbcon_clear();
+		fbcon_flush();
+		return;
+	}
+
+	gSystemTable->ConOut->ClearScreen(gSystemTable->ConOut);
+}
+
+void fw_console_clear(void)
+{
+	if (fbcon_active()) {
+		fbcon_clear();
+		fbcon_flush();
+		return;
+	}
+
+	gSystemTable->ConOut->ClearScreen(gSystemTable->ConOut);
+}
+
+void fw_console_set_cursor(uint32_t column, uint32_t row)
+{
+	if (fbcon_active()) {
+		fbcon_set_cursor(column, row);
+		return;
+	}
+
+	gSystemTable->ConOut->SetCursorPosition(gSystemTable->ConOut, column, row);
+}
+
+int fw_read_key(void)
+{
+	EFI_STATUS status;
+	EFI_INPUT_KEY key;
+
+	// doesn't block, EFI_NOT_READY means no key is pending
+	status = gSystemTable->ConIn->ReadKeyStroke(gSystemTable->ConIn, &key);
+	if (EFI_ERROR(status)) {
+		return KEY_NONE;
+	}
+
+	switch (key.ScanCode) {
+		case SCAN_UP:
+			return KEY_UP;
+		case SCAN_DOWN:
+			return KEY_DOWN;
+		case SCAN_ESC:
+			return KEY_ESCAPE;
+		default:
+			break;
+	}
+
+	return key.UnicodeChar;
+}
+
+static EFI_EVENT timer_event = NULL;
+
+int fw_timer_start(uint32_t period_ms)
+{
+	EFI_STATUS status;
+
+	status = gSystemTable->BootServices->CreateEvent(EVT_TIMER, TPL_CALLBACK, NULL, NULL, &timer_event);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to create timer event: 0x%lx\r\n", status);
+		timer_event = NULL;
+		return 1;
+	}
+
+	// the timer period is in 100ns units
+	status = gSystemTable->BootServices->SetTimer(timer_event, TimerPeriodic, (uint64_t)period_ms * 10000);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to arm timer event: 0x%lx\r\n", status);
+		fw_timer_stop();
+		return 1;
+	}
+
+	return 0;
+}
+
+void fw_timer_stop(void)
+{
+	if (timer_event == NULL) {
+		return;
+	}
+
+	gSystemTable->BootServices->SetTimer(timer_event, TimerCancel, 0);
+	gSystemTable->BootServices->CloseEvent(timer_event);
+	timer_event = NULL;
+}
+
+int fw_wait_event(bool block, int *key)
+{
+	EFI_EVENT events[2];
+	EFI_UINTN index;
+	EFI_STATUS status;
+
+	*key = KEY_NONE;
+
+	if (block) {
+		events[0] = gSystemTable->ConIn->WaitForKey;
+		events[1] = timer_event;
+
+		status = gSystemTable->BootServices->WaitForEvent(timer_event != NULL ? 2 : 1, events, &index);
+		if (EFI_ERROR(status)) {
+			return FwEventNone;
+		}
+
+		if (index == 1) {
+			return FwEventTimer;
+		}
+	} else if (timer_event != NULL &&
+			   gSystemTable->BootServices->CheckEvent(timer_event) == EFI_SUCCESS) {
+		return FwEventTimer;
+	}
+
+	*key = fw_read_key();
+	return (*key != KEY_NONE) ? FwEventKey : FwEventNone;
+}
+
+void fw_stall(uint64_t microseconds)
+{
+	gSystemTable->BootServices->Stall(microseconds);
+}
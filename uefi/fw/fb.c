@@ -17,6 +17,7 @@
 /* SOFTWARE.                                                                     */
 /*********************************************************************************/
 
+#include <config/config.h>
 #include <firmware/firmware.h>
 #include <firmware/fb.h>
 #include <lib/string.h>
@@ -26,16 +27,195 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 EFI_GRAPHICS_OUTPUT_PROTOCOL *gop = NULL;
 
 uint8_t is_initialized = 0;
 
+static struct fw_video_mode modes[FW_MAX_VIDEO_MODES];
+static uint32_t mode_count = 0;
+static uint32_t current_mode = 0;
+// the firmware's mode may be blt-only or past FW_MAX_VIDEO_MODES
+static bool current_listed = false;
+
+static int policy = ConfigVideoFirmware;
+static uint32_t policy_width = 0;
+static uint32_t policy_height = 0;
+
+void fw_set_fb_policy(int new_policy, uint32_t width, uint32_t height)
+{
+	policy = new_policy;
+	policy_width = width;
+	policy_height = height;
+}
+
+// QueryMode() hands out pool memory every time, so ask once per mode
+static void fb_enumerate_modes(void)
+{
+	EFI_STATUS status;
+	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *modeinfo = NULL;
+	EFI_UINTN modeinfo_size = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+
+	mode_count = 0;
+	current_listed = false;
+	for (uint32_t i = 0; i < gop->Mode->MaxMode && mode_count < FW_MAX_VIDEO_MODES; i++) {
+		status = gop->QueryMode(gop, i, &modeinfo_size, &modeinfo);
+		if (EFI_ERROR(status)) {
+			continue;
+		}
+
+		struct fw_video_mode *mode = &modes[mode_count];
+		if (modeinfo->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
+			mode->pixel_format = 1; // rgba
+		} else if (modeinfo->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
+			mode->pixel_format = 2; // bgra
+		} else {
+			// bitmask and blt-only modes aren't of any use to us
+			gSystemTable->BootServices->FreePool(modeinfo);
+			continue;
+		}
+
+		mode->number = i;
+		mode->width = modeinfo->HorizontalResolution;
+		mode->height = modeinfo->VerticalResolution;
+		mode->pitch = modeinfo->PixelsPerScanLine * 4;
+		mode->bpp = 32;
+		gSystemTable->BootServices->FreePool(modeinfo);
+
+		if (i == gop->Mode->Mode) {
+			current_mode = mode_count;
+			current_listed = true;
+		}
+		mode_count++;
+	}
+
+	debug("GOP: %u usable modes, current is %ux%u%s\r\n", mode_count,
+		  gop->Mode->Info->HorizontalResolution, gop->Mode->Info->VerticalResolution,
+		  current_listed ? "" : " (not usable)");
+}
+
+static int fb_set_mode(uint32_t index)
+{
+	EFI_STATUS status;
+
+	if (index == current_mode && modes[index].number == gop->Mode->Mode) {
+		return 0;
+	}
+
+	status = gop->SetMode(gop, modes[index].number);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to set GOP mode %u: 0x%lx\r\n", modes[index].number, status);
+		return 1;
+	}
+
+	debug("GOP: switched to %ux%u\r\n", modes[index].width, modes[index].height);
+	current_mode = index;
+	current_listed = true;
+	return 0;
+}
+
+// The EDID of the display gop drives; LocateProtocol() would return
+// whichever display's EDID the firmware happens to list first
+static EFI_EDID_ACTIVE_PROTOCOL *fb_get_edid(void)
+{
+	EFI_STATUS status;
+	EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+	EFI_GUID edid_guid = EFI_EDID_ACTIVE_PROTOCOL_GUID;
+	EFI_EDID_ACTIVE_PROTOCOL *edid = NULL;
+	EFI_HANDLE *handles = NULL;
+	EFI_UINTN handle_count = 0;
+
+	status = gSystemTable->BootServices->LocateHandleBuffer(ByProtocol, &gop_guid, NULL, &handle_count, &handles);
+	if (EFI_ERROR(status)) {
+		return NULL;
+	}
+
+	for (EFI_UINTN i = 0; i < handle_count; i++) {
+		VOID *interface = NULL;
+
+		status = gSystemTable->BootServices->HandleProtocol(handles[i], &gop_guid, &interface);
+		if (EFI_ERROR(status) || interface != gop) {
+			continue;
+		}
+
+		status = gSystemTable->BootServices->HandleProtocol(handles[i], &edid_guid, (VOID **)&edid);
+		if (EFI_ERROR(status)) {
+			edid = NULL;
+		}
+		break;
+	}
+
+	gSystemTable->BootServices->FreePool(handles);
+	return edid;
+}
+
+// the first detailed timing descriptor holds the panel's preferred mode
+static int fb_get_native_resolution(uint32_t *width, uint32_t *height)
+{
+	EFI_EDID_ACTIVE_PROTOCOL *edid = fb_get_edid();
+
+	if (edid == NULL || edid->SizeOfEdid < 128 || edid->Edid == NULL) {
+		return 1;
+	}
+
+	uint8_t *dtd = edid->Edid + 54;
+	if (dtd[0] == 0 && dtd[1] == 0) {
+		// a display descriptor, not a timing
+		return 1;
+	}
+
+	*width = dtd[2] | ((dtd[4] & 0xf0) << 4);
+	*height = dtd[5] | ((dtd[7] & 0xf0) << 4);
+	return (*width == 0 || *height == 0);
+}
+
+static void fb_apply_policy(void)
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t smallest;
+
+	switch (policy) {
+		case ConfigVideoNative:
+			if (fb_get_native_resolution(&width, &height) != 0) {
+				debug("GOP: no EDID, keeping the firmware's mode\r\n");
+				break;
+			}
+			fw_set_fb_resolution(width, height);
+			break;
+		case ConfigVideoFixed:
+			fw_set_fb_resolution(policy_width, policy_height);
+			break;
+		case ConfigVideoSmallest:
+			smallest = current_mode;
+			for (uint32_t i = 0; i < mode_count; i++) {
+				if ((uint64_t)modes[i].width * modes[i].height <
+					(uint64_t)modes[smallest].width * modes[smallest].height) {
+					smallest = i;
+				}
+			}
+			fb_set_mode(smallest);
+			break;
+		default:
+			break;
+	}
+}
+
 int fw_initialize_fb(void)
 {
 	EFI_STATUS status;
 	EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
 
+	if (is_initialized) {
+		return 0;
+	}
+
+	// headless machines don't get a framebuffer, and don't pay for a modeset
+	if (policy == ConfigVideoHeadless) {
+		return 1;
+	}
+
 	// get GOP
 	status = gSystemTable->BootServices->LocateProtocol(&gop_guid,
 														NULL,
@@ -45,40 +225,154 @@ int fw_initialize_fb(void)
 		return 1;
 	}
 
-	// UEFI should already set the framebuffer to the best available
-	// mode
+	fb_enumerate_modes();
+	if (mode_count == 0) {
+		debug("ERROR: GOP has no mode with a linear framebuffer\r\n");
+		return 1;
+	}
+
+	// everything below reports modes[current_mode], so it has to be the
+	// live mode; prefer a listed one at the same resolution
+	if (!current_listed) {
+		uint32_t index = 0;
+
+		for (uint32_t i = 0; i < mode_count; i++) {
+			if (modes[i].width == gop->Mode->Info->HorizontalResolution &&
+				modes[i].height == gop->Mode->Info->VerticalResolution) {
+				index = i;
+				break;
+			}
+		}
+
+		if (fb_set_mode(index) != 0) {
+			return 1;
+		}
+	}
+
 	// all went well :>
 	is_initialized = 1;
+
+	fb_apply_policy();
 	return 0;
 }
 
-void fw_get_framebuffer(void **address, uint32_t *width, uint32_t *height, uint16_t *bpp, uint8_t *pixelformat)
+int fw_set_fb_resolution(uint32_t width, uint32_t height)
 {
-	EFI_STATUS status;
-	EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *modeinfo = NULL;
-	EFI_UINTN modeinfo_size = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+	if (!is_initialized) {
+		debug("Called fw_set_fb_resolution() when is_initialized = 0!\r\n");
+		return 1;
+	}
 
+	// nothing to do if the current mode already matches
+	if (modes[current_mode].width == width && modes[current_mode].height == height) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < mode_count; i++) {
+		if (modes[i].width == width && modes[i].height == height) {
+			return fb_set_mode(i);
+		}
+	}
+
+	debug("No GOP mode matches %ux%u, keeping the current mode\r\n", width, height);
+	return 1;
+}
+
+void fw_get_framebuffer(void **address, uint32_t *width, uint32_t *height, uint16_t *bpp, uint8_t *pixelformat)
+{
 	if (!is_initialized) {
 		debug("Called fw_get_framebuffer() when is_initialized = 0!\r\n");
 		return;
 	}
 
-	status = gop->QueryMode(gop, gop->Mode->Mode, &modeinfo_size, &modeinfo);
+	*address = (void *)gop->Mode->FrameBufferBase;
+	*width = modes[current_mode].width;
+	*height = modes[current_mode].height;
+	*bpp = modes[current_mode].bpp;
+	*pixelformat = modes[current_mode].pixel_format;
+}
+
+uint32_t fw_get_fb_pitch(void)
+{
+	if (!is_initialized) {
+		return 0;
+	}
+
+	return modes[current_mode].pitch;
+}
+
+int fw_fb_blt(const uint32_t *pixels, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	EFI_STATUS status;
+
+	if (!is_initialized) {
+		return 1;
+	}
+
+	status = gop->Blt(gop, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)pixels, EfiBltBufferToVideo,
+					  0, 0, x, y, width, height, width * sizeof(uint32_t));
 	if (EFI_ERROR(status)) {
-		debug("ERROR: Failed to query GOP mode %u\r\n", gop->Mode->Mode);
-		return;
+		debug("ERROR: Blt() of %ux%u failed: 0x%lx\r\n", width, height, status);
+		return 1;
+	}
+
+	return 0;
+}
+
+const struct fw_video_mode *fw_get_fb_modes(uint32_t *count, uint32_t *current)
+{
+	*count = is_initialized ? mode_count : 0;
+	*current = current_mode;
+	return modes;
+}
+
+int fw_get_glyph(uint32_t ch, uint16_t rows[FW_GLYPH_MAX_HEIGHT], uint32_t *width, uint32_t *height)
+{
+	static EFI_HII_FONT_PROTOCOL *font = NULL;
+	static uint8_t font_missing = 0;
+	EFI_GUID font_guid = EFI_HII_FONT_PROTOCOL_GUID;
+	EFI_IMAGE_OUTPUT *image = NULL;
+	EFI_STATUS status;
+
+	if (font == NULL) {
+		if (font_missing) {
+			return 1;
+		}
+
+		status = gSystemTable->BootServices->LocateProtocol(&font_guid, NULL, (VOID **)&font);
+		if (EFI_ERROR(status)) {
+			debug("No HII font available: 0x%lx\r\n", status);
+			font_missing = 1;
+			font = NULL;
+			return 1;
+		}
 	}
 
+	status = font->GetGlyph(font, (CHAR16)ch, NULL, &image, NULL);
+	if (EFI_ERROR(status) || image == NULL) {
+		return 1;
+	}
 
-	if (modeinfo->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
-		*pixelformat = 1; // rgba
-		*bpp = 32;
-	} else if (modeinfo->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
-		*pixelformat = 2; // bgra
-		*bpp = 32;
+	if (image->Width > FW_GLYPH_MAX_WIDTH || image->Height > FW_GLYPH_MAX_HEIGHT) {
+		gSystemTable->BootServices->FreePool(image->Image.Bitmap);
+		gSystemTable->BootServices->FreePool(image);
+		return 1;
 	}
 
-	*address = (void *)gop->Mode->FrameBufferBase;
-	*width = modeinfo->HorizontalResolution;
-	*height = modeinfo->VerticalResolution;
-}
\ No newline at end of file
+	// the glyph comes back drawn in the default colors; anything lit is foreground
+	*width = image->Width;
+	*height = image->Height;
+	for (uint32_t y = 0; y < image->Height; y++) {
+		rows[y] = 0;
+		for (uint32_t x = 0; x < image->Width; x++) {
+			EFI_GRAPHICS_OUTPUT_BLT_PIXEL *pixel = &image->Image.Bitmap[y * image->Width + x];
+			if (pixel->Red | pixel->Green | pixel->Blue) {
+				rows[y] |= 0x8000 >> x;
+			}
+		}
+	}
+
+	gSystemTable->BootServices->FreePool(image->Image.Bitmap);
+	gSystemTable->BootServices->FreePool(image);
+	return 0;
+}
@@ -27,6 +27,9 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// the boot volume is opened once and reused for every lookup
+static FILE *boot_volume = NULL;
+
 FILE *fw_file_open(FILE *directory, const char *path)
 {
 	EFI_STATUS Status;
@@ -36,11 +39,15 @@ FILE *fw_file_open(FILE *directory, const char *path)
 	debug("Opening file '%s'...\r\n", path);
 
 	if (directory == NULL) {
-		Status = gFileSystem->OpenVolume(gFileSystem, &directory);
-		if (EFI_ERROR(Status)) {
-			debug("Error when opening volume: %x\r\n", Status);
-			return NULL;
+		if (boot_volume == NULL) {
+			Status = gFileSystem->OpenVolume(gFileSystem, &boot_volume);
+			if (EFI_ERROR(Status)) {
+				debug("Error when opening volume: %x\r\n", Status);
+				boot_volume = NULL;
+				return NULL;
+			}
 		}
+		directory = boot_volume;
 	}
 
 	mbstowcs(wpath, &path, strlen(path));
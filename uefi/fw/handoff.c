@@ -18,11 +18,13 @@
 /*********************************************************************************/
 
 #include <arch/cpu/cpu.h>
+#include <debug/serial.h>
 #include <firmware/firmware.h>
 #include <firmware/memmap.h>
 #include <firmware/handoff.h>
 
 void fw_prepare_handoff(void)
 {
+	serial_release_firmware();
 	uefi_exit_boot_services();
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 
 #include <firmware/hwmgmnt.h>
 #include <firmware/firmware.h>
+#include <firmware/memory.h>
+#include <lib/acpi.h>
 #include <lib/string.h>
 #include <print.h>
 
@@ -26,52 +28,448 @@
 #include <efilib.h>
 
 #include <stddef.h>
+#include <stdint.h>
 
-void *fw_get_acpi_rsdp(void)
+struct acpi_spcr {
+    struct acpi_sdt_header header;
+    uint8_t interface_type;
+    uint8_t reserved[3];
+    struct acpi_gas base_address;
+    uint8_t interrupt_type;
+    uint8_t irq;
+    uint32_t gsiv;
+    uint8_t baud_rate;
+    uint8_t parity;
+    uint8_t stop_bits;
+    uint8_t flow_control;
+    uint8_t terminal_type;
+} __attribute__((packed));
+
+#define SPCR_INTERFACE_16550 0x00
+#define SPCR_INTERFACE_16450 0x01
+#define SPCR_INTERFACE_16550_GAS 0x12
+
+#define FPDT_RECORD_FBPT_POINTER 0x0000
+#define FBPT_RECORD_BASIC_BOOT 0x0002
+
+struct fpdt_record_header {
+    uint16_t type;
+    uint8_t length;
+    uint8_t revision;
+} __attribute__((packed));
+
+struct fpdt_fbpt_pointer {
+    struct fpdt_record_header header;
+    uint32_t reserved;
+    uint64_t address;
+} __attribute__((packed));
+
+struct fbpt_header {
+    char signature[4];
+    uint32_t length;
+} __attribute__((packed));
+
+struct fbpt_basic_boot_record {
+    struct fpdt_record_header header;
+    uint32_t reserved;
+    uint64_t reset_end;
+    uint64_t os_loader_load_image_start;
+    uint64_t os_loader_start_image_start;
+    uint64_t exit_boot_services_entry;
+    uint64_t exit_boot_services_exit;
+} __attribute__((packed));
+
+// lives in firmware-reserved memory, so it's still valid after ExitBootServices()
+static struct fbpt_basic_boot_record *boot_record = NULL;
+
+// PI specification MP services, not in every EFI header
+#ifndef EFI_MP_SERVICES_PROTOCOL_GUID
+#define EFI_MP_SERVICES_PROTOCOL_GUID {0x3fdda605, 0xa76e, 0x4f46, {0xad, 0x29, 0x12, 0xf4, 0x53, 0x1b, 0x3d, 0x08}}
+
+#define PROCESSOR_AS_BSP_BIT 0x00000001
+#define PROCESSOR_ENABLED_BIT 0x00000002
+#define PROCESSOR_HEALTH_STATUS_BIT 0x00000004
+
+typedef struct {
+    EFI_UINT32 Package;
+    EFI_UINT32 Core;
+    EFI_UINT32 Thread;
+} EFI_CPU_PHYSICAL_LOCATION;
+
+typedef struct {
+    EFI_UINT64 ProcessorId;
+    EFI_UINT32 StatusFlag;
+    EFI_CPU_PHYSICAL_LOCATION Location;
+} EFI_PROCESSOR_INFORMATION;
+
+typedef struct _EFI_MP_SERVICES_PROTOCOL EFI_MP_SERVICES_PROTOCOL;
+
+struct _EFI_MP_SERVICES_PROTOCOL {
+    EFI_STATUS (EFIAPI *GetNumberOfProcessors)(EFI_MP_SERVICES_PROTOCOL *This, EFI_UINTN *NumberOfProcessors, EFI_UINTN *NumberOfEnabledProcessors);
+    EFI_STATUS (EFIAPI *GetProcessorInfo)(EFI_MP_SERVICES_PROTOCOL *This, EFI_UINTN ProcessorNumber, EFI_PROCESSOR_INFORMATION *ProcessorInfoBuffer);
+    VOID *StartupAllAPs;
+    VOID *StartupThisAP;
+    VOID *SwitchBSP;
+    VOID *EnableDisableAP;
+    VOID *WhoAmI;
+};
+#endif
+
+static struct {
+    bool read;
+    uint32_t count;
+    struct fw_cpu *cpus;
+} cpu_list;
+
+//
+// The configuration table is indexed once: every known GUID gets a slot in
+// a small open-addressed hash table, so each firmware entry costs a hash
+// and at most one compare instead of one compare per known GUID.
+//
+
+#define CONFIG_INDEX_BITS 5
+#define CONFIG_INDEX_SIZE (1 << CONFIG_INDEX_BITS)
+
+static const EFI_GUID known_tables[FwTableCount] = {
+    [FwTableAcpi10] = EFI_ACPI_10_TABLE_GUID,
+    [FwTableAcpi20] = EFI_ACPI_20_TABLE_GUID,
+    [FwTableSmbios] = SMBIOS_TABLE_GUID,
+    [FwTableSmbios3] = SMBIOS3_TABLE_GUID,
+    [FwTableDtb] = {0xb1b621d5, 0xf19c, 0x41a5, {0x83, 0x0b, 0xd9, 0x15, 0x2c, 0x69, 0xaa, 0xe0}},
+    [FwTableEsrt] = {0xb122a263, 0x3661, 0x4f68, {0x99, 0x29, 0x78, 0xf8, 0xb0, 0xd6, 0x21, 0x80}},
+    [FwTableMemoryAttributes] = {0xdcfa911d, 0x26eb, 0x469f, {0xa2, 0x20, 0x38, 0xb7, 0xdc, 0x46, 0x12, 0x20}},
+    [FwTableRngSeed] = {0x1ce1e5bc, 0x7ceb, 0x42f2, {0x81, 0xe5, 0x8a, 0xad, 0xf1, 0x80, 0xf5, 0x7b}},
+};
+
+static struct {
+    bool built;
+    uint8_t buckets[CONFIG_INDEX_SIZE]; // index into known_tables + 1, 0 if empty
+    void *tables[FwTableCount];
+} config_index;
+
+static uint32_t guid_hash(const EFI_GUID *guid)
+{
+    const uint64_t *words = (const uint64_t *)guid;
+    uint64_t lo = words[0];
+    uint64_t hi = words[1];
+
+    return (uint32_t)(((lo ^ hi) * 0x9e3779b97f4a7c15ull) >> (64 - CONFIG_INDEX_BITS));
+}
+
+static void build_config_index(void)
 {
-    void *cfgtbl = gSystemTable->ConfigurationTable->VendorTable;
-    EFI_GUID acpi10 = EFI_ACPI_10_TABLE_GUID;
-    EFI_GUID acpi20 = EFI_ACPI_20_TABLE_GUID;
+    for (int i = 0; i < FwTableCount; i++) {
+        uint32_t slot = guid_hash(&known_tables[i]);
+        while (config_index.buckets[slot] != 0) {
+            slot = (slot + 1) & (CONFIG_INDEX_SIZE - 1);
+        }
+        config_index.buckets[slot] = i + 1;
+    }
 
     for (EFI_UINTN i = 0; i < gSystemTable->NumberOfTableEntries; i++) {
-        if (!memcmp(&gSystemTable->ConfigurationTable[i].VendorGuid, &acpi10, sizeof(EFI_GUID)) ||
-            !memcmp(&gSystemTable->ConfigurationTable[i].VendorGuid, &acpi20, sizeof(EFI_GUID))) {
-            // let's just do one more check to be sure
-            void *ptr = gSystemTable->ConfigurationTable[i].VendorTable;
-            if (!memcmp(ptr, "RSD PTR ", 8)) {
-                debug("Found RSDP at 0x%lx\r\n", ptr);
-                return ptr;
+        EFI_CONFIGURATION_TABLE *entry = &gSystemTable->ConfigurationTable[i];
+        uint32_t slot = guid_hash(&entry->VendorGuid);
+
+        while (config_index.buckets[slot] != 0) {
+            int table = config_index.buckets[slot] - 1;
+            if (!memcmp(&entry->VendorGuid, &known_tables[table], sizeof(EFI_GUID))) {
+                // the first instance wins if a GUID is listed twice
+                if (config_index.tables[table] == NULL) {
+                    config_index.tables[table] = entry->VendorTable;
+                }
+                break;
             }
+            slot = (slot + 1) & (CONFIG_INDEX_SIZE - 1);
+        }
+    }
+
+    config_index.built = true;
+    debug("Indexed %u configuration tables\r\n", (uint32_t)gSystemTable->NumberOfTableEntries);
+}
+
+void *fw_get_config_table(int table)
+{
+    if (table < 0 || table >= FwTableCount) {
+        return NULL;
+    }
+
+    if (!config_index.built) {
+        build_config_index();
+    }
+
+    return config_index.tables[table];
+}
+
+void *fw_get_acpi_rsdp(void)
+{
+    static struct acpi_rsdp *rsdp = NULL;
+    struct acpi_rsdp *candidate;
+
+    if (rsdp != NULL) {
+        return rsdp;
+    }
+
+    // the 2.0 table may still be a revision 0 RSDP on odd firmware, check
+    candidate = fw_get_config_table(FwTableAcpi20);
+    if (candidate != NULL && !memcmp(candidate->signature, "RSD PTR ", 8) && candidate->revision >= 2) {
+        rsdp = candidate;
+    } else {
+        candidate = fw_get_config_table(FwTableAcpi10);
+        if (candidate != NULL && !memcmp(candidate->signature, "RSD PTR ", 8)) {
+            rsdp = candidate;
+        }
+    }
+
+    if (rsdp == NULL) {
+        // no rsdp was found
+        debug("ERROR: No RSDP was found!\r\n");
+        return NULL;
+    }
+
+    debug("Found ACPI %s RSDP at 0x%lx\r\n", rsdp->revision >= 2 ? "2.0" : "1.0", rsdp);
+    return rsdp;
+}
+
+void *fw_get_acpi_table(const char *signature)
+{
+    void *table;
+
+    if (acpi_init(fw_get_acpi_rsdp()) != 0) {
+        return NULL;
+    }
+
+    table = acpi_find_table(signature);
+    if (table == NULL) {
+        debug("ACPI table '%.4s' not found\r\n", signature);
+    }
+
+    return table;
+}
+
+bool fw_get_spcr_port(uint16_t *port, uint32_t *baud)
+{
+    struct acpi_spcr *spcr = fw_get_acpi_table("SPCR");
+
+    if (spcr == NULL || spcr->header.length < sizeof(struct acpi_spcr)) {
+        return false;
+    }
+
+    if (spcr->interface_type != SPCR_INTERFACE_16550 &&
+        spcr->interface_type != SPCR_INTERFACE_16450 &&
+        spcr->interface_type != SPCR_INTERFACE_16550_GAS) {
+        debug("SPCR describes an unsupported interface type %u\r\n", spcr->interface_type);
+        return false;
+    }
+
+    // only port I/O UARTs for now
+    if (spcr->base_address.address_space != ACPI_GAS_SYSTEM_IO || spcr->base_address.address > 0xffff) {
+        debug("SPCR UART isn't in I/O space\r\n");
+        return false;
+    }
+
+    *port = (uint16_t)spcr->base_address.address;
+    switch (spcr->baud_rate) {
+        case 3:
+            *baud = 9600;
+            break;
+        case 4:
+            *baud = 19200;
+            break;
+        case 6:
+            *baud = 57600;
+            break;
+        case 7:
+            *baud = 115200;
+            break;
+        default:
+            *baud = 0;
+            break;
+    }
+
+    debug("SPCR: UART at 0x%x, baud %u\r\n", *port, *baud);
+    return true;
+}
+
+static struct fbpt_basic_boot_record *find_boot_record(void)
+{
+    struct acpi_sdt_header *fpdt = fw_get_acpi_table("FPDT");
+    struct fbpt_header *fbpt = NULL;
+
+    if (fpdt == NULL) {
+        return NULL;
+    }
+
+    uint8_t *ptr = (uint8_t *)fpdt + sizeof(struct acpi_sdt_header);
+    uint8_t *end = (uint8_t *)fpdt + fpdt->length;
+    while (ptr + sizeof(struct fpdt_record_header) <= end) {
+        struct fpdt_record_header *record = (struct fpdt_record_header *)ptr;
+        if (record->length == 0) {
+            break;
         }
+
+        if (record->type == FPDT_RECORD_FBPT_POINTER && record->length >= sizeof(struct fpdt_fbpt_pointer)) {
+            fbpt = (struct fbpt_header *)(uintptr_t)((struct fpdt_fbpt_pointer *)record)->address;
+            break;
+        }
+
+        ptr += record->length;
+    }
+
+    if (fbpt == NULL || memcmp(fbpt->signature, "FBPT", 4) != 0) {
+        debug("FPDT has no valid FBPT\r\n");
+        return NULL;
     }
 
-    // no rsdp was found
-    debug("ERROR: No RSDP was found!\r\n");
+    ptr = (uint8_t *)fbpt + sizeof(struct fbpt_header);
+    end = (uint8_t *)fbpt + fbpt->length;
+    while (ptr + sizeof(struct fpdt_record_header) <= end) {
+        struct fpdt_record_header *record = (struct fpdt_record_header *)ptr;
+        if (record->length == 0) {
+            break;
+        }
+
+        if (record->type == FBPT_RECORD_BASIC_BOOT && record->length >= sizeof(struct fbpt_basic_boot_record)) {
+            debug("Found FBPT boot performance record at 0x%lx\r\n", record);
+            return (struct fbpt_basic_boot_record *)record;
+        }
 
+        ptr += record->length;
+    }
+
+    debug("FBPT has no boot performance record\r\n");
     return NULL;
 }
 
-void *fw_get_smbios_entry_point(void)
+bool fw_boot_performance_init(void)
 {
-    void *cfgtbl = gSystemTable->ConfigurationTable->VendorTable;
-    EFI_GUID smbios2 = SMBIOS_TABLE_GUID;
-    EFI_GUID smbios3 = SMBIOS3_TABLE_GUID;
+    if (boot_record == NULL) {
+        boot_record = find_boot_record();
+    }
 
-    for (EFI_UINTN i = 0; i < gSystemTable->NumberOfTableEntries; i++) {
-        if (!memcmp(&gSystemTable->ConfigurationTable[i].VendorGuid, &smbios2, sizeof(EFI_GUID)) ||
-            !memcmp(&gSystemTable->ConfigurationTable[i].VendorGuid, &smbios3, sizeof(EFI_GUID))) {
-            // let's just do one more check to be sure
-            void *ptr = gSystemTable->ConfigurationTable[i].VendorTable;
-            if (!memcmp(ptr, "_SM_", 5) ||
-                !memcmp(ptr, "_SM3_", 5)) {
-                debug("Found SMBIOS entry point at 0x%lx\r\n", ptr);
-                return ptr;
-            }
+    return boot_record != NULL;
+}
+
+bool fw_get_boot_performance(struct fw_boot_performance *perf)
+{
+    memset(perf, 0, sizeof(struct fw_boot_performance));
+
+    if (!fw_boot_performance_init()) {
+        return false;
+    }
+
+    perf->reset_end = boot_record->reset_end;
+    perf->os_loader_load_image_start = boot_record->os_loader_load_image_start;
+    perf->os_loader_start_image_start = boot_record->os_loader_start_image_start;
+    perf->exit_boot_services_entry = boot_record->exit_boot_services_entry;
+    perf->exit_boot_services_exit = boot_record->exit_boot_services_exit;
+    return true;
+}
+
+void fw_publish_boot_performance(const struct fw_boot_performance *perf)
+{
+    if (boot_record == NULL) {
+        return;
+    }
+
+    // only fill in what the firmware didn't record itself
+    if (boot_record->os_loader_load_image_start == 0) {
+        boot_record->os_loader_load_image_start = perf->os_loader_load_image_start;
+    }
+    if (boot_record->os_loader_start_image_start == 0) {
+        boot_record->os_loader_start_image_start = perf->os_loader_start_image_start;
+    }
+    if (boot_record->exit_boot_services_entry == 0) {
+        boot_record->exit_boot_services_entry = perf->exit_boot_services_entry;
+    }
+    if (boot_record->exit_boot_services_exit == 0) {
+        boot_record->exit_boot_services_exit = perf->exit_boot_services_exit;
+    }
+}
+
+// Only the processor list is used; APs are left to the firmware until
+// ExitBootServices(), which takes them back anyway
+const struct fw_cpu *fw_get_cpus(uint32_t *count)
+{
+    EFI_GUID mp_guid = EFI_MP_SERVICES_PROTOCOL_GUID;
+    EFI_MP_SERVICES_PROTOCOL *mp;
+    EFI_UINTN total, enabled;
+    EFI_STATUS status;
+
+    if (cpu_list.read) {
+        *count = cpu_list.count;
+        return cpu_list.cpus;
+    }
+    cpu_list.read = true;
+    *count = 0;
+
+    status = gSystemTable->BootServices->LocateProtocol(&mp_guid, NULL, (VOID **)&mp);
+    if (EFI_ERROR(status)) {
+        debug("No MP services protocol: 0x%lx\r\n", status);
+        return NULL;
+    }
+
+    status = mp->GetNumberOfProcessors(mp, &total, &enabled);
+    if (EFI_ERROR(status) || total == 0) {
+        debug("ERROR: GetNumberOfProcessors() returned 0x%lx\r\n", status);
+        return NULL;
+    }
+
+    cpu_list.cpus = fw_allocmem(total * sizeof(struct fw_cpu));
+    if (cpu_list.cpus == NULL) {
+        return NULL;
+    }
+
+    for (EFI_UINTN i = 0; i < total; i++) {
+        EFI_PROCESSOR_INFORMATION info;
+        struct fw_cpu *cpu = &cpu_list.cpus[cpu_list.count];
+
+        status = mp->GetProcessorInfo(mp, i, &info);
+        if (EFI_ERROR(status)) {
+            debug("ERROR: GetProcessorInfo(%u) returned 0x%lx\r\n", i, status);
+            continue;
+        }
+
+        cpu->apic_id = (uint32_t)info.ProcessorId;
+        cpu->flags = 0;
+        if (info.StatusFlag & PROCESSOR_AS_BSP_BIT) {
+            cpu->flags |= FW_CPU_BSP;
+        }
+        if (info.StatusFlag & PROCESSOR_ENABLED_BIT) {
+            cpu->flags |= FW_CPU_ENABLED;
         }
+        if (info.StatusFlag & PROCESSOR_HEALTH_STATUS_BIT) {
+            cpu->flags |= FW_CPU_HEALTHY;
+        }
+        cpu->package = info.Location.Package;
+        cpu->core = info.Location.Core;
+        cpu->thread = info.Location.Thread;
+        cpu_list.count++;
+    }
+
+    debug("MP services: %u processors, %u enabled\r\n", (uint32_t)total, (uint32_t)enabled);
+
+    *count = cpu_list.count;
+    return cpu_list.cpus;
+}
+
+void *fw_get_smbios_entry_point(void)
+{
+    void *ptr;
+
+    ptr = fw_get_config_table(FwTableSmbios3);
+    if (ptr != NULL && !memcmp(ptr, "_SM3_", 5)) {
+        debug("Found SMBIOS 3 entry point at 0x%lx\r\n", ptr);
+        return ptr;
+    }
+
+    ptr = fw_get_config_table(FwTableSmbios);
+    if (ptr != NULL && !memcmp(ptr, "_SM_", 4)) {
+        debug("Found SMBIOS 2 entry point at 0x%lx\r\n", ptr);
+        return ptr;
     }
 
     // no entry point was found
     debug("ERROR: No SMBIOS Entry Point was found!\r\n");
 
     return NULL;
-}
\ No newline at end of file
+}
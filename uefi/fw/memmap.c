@@ -21,7 +21,11 @@
 #include <firmware/firmware.h>
 #include <firmware/memmap.h>
 #include <firmware/handoff.h>
+#include <uefi/firmware/memory.h>
+#include <lib/arena.h>
+#include <lib/logring.h>
 #include <lib/string.h>
+#include <lib/timestamp.h>
 #include <print.h>
 #include <efi.h>
 #include <efilib.h>
@@ -29,6 +33,14 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// UEFI 2.5 and 2.8 attributes, missing from older headers
+#ifndef EFI_MEMORY_MORE_RELIABLE
+#define EFI_MEMORY_MORE_RELIABLE 0x0000000000010000ull
+#endif
+#ifndef EFI_MEMORY_SP
+#define EFI_MEMORY_SP 0x0000000000040000ull
+#endif
+
 void fw_get_memory_map(struct memory_map_info *memmap)
 {
 	EFI_STATUS status;
@@ -37,6 +49,7 @@ void fw_get_memory_map(struct memory_map_info *memmap)
 	EFI_UINTN key = 0;
 	EFI_UINTN desc_size = 0;
 	EFI_UINT32 desc_ver = 0;
+	struct arena_mark scratch;
 
 	if (memmap == NULL) {
 		return;
@@ -48,127 +61,167 @@ void fw_get_memory_map(struct memory_map_info *memmap)
 		return;
 	}
 
+	// allocating may split a descriptor or two
 	size += desc_size * 2;
+
+	// allocate memory for AxBoot-format memory map
+	memmap->entry_count = 0;
+	memmap->entries = (struct memory_map_entry *)malloc((size / desc_size) * sizeof(struct memory_map_entry));
+	if (memmap->entries == NULL) {
+		debug("ERROR: Failed to allocate memory map\r\n");
+		return;
+	}
+
+	// the UEFI map is only needed until it's translated
+	scratch = arena_mark(&g_loader_arena);
 	map = (EFI_MEMORY_DESCRIPTOR *)malloc(size);
 
 	status = gSystemTable->BootServices->GetMemoryMap(&size, map, &key, &desc_size, &desc_ver);
 	if (EFI_ERROR(status)) {
 		debug("ERROR: Failed to acquire memory map (step 2): 0x%lx\r\n", status);
 		free(map);
+		arena_reset(&g_loader_arena, scratch);
 		return;
 	}
 
-	// allocate memory for AxBoot-format memory map
-	memmap->entry_count = size / desc_size - 1;
-	memmap->entries = (struct memory_map_entry *)malloc(memmap->entry_count * sizeof(struct memory_map_entry));
-
 	// translate UEFI memory map to AxBoot one
 	debug("Processing memory map\r\n");
-	for (EFI_UINTN i = 0; i < size / desc_size - 1; i++) {
+	for (EFI_UINTN i = 0; i < size / desc_size; i++) {
 		EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)((uint8_t *)map + (i * desc_size));
-		
+		struct memory_map_entry *entry = &memmap->entries[memmap->entry_count];
+
 		if (desc->NumberOfPages == 0) {
 			continue;
 		}
 
-		memmap->entries[i].base = (uint64_t)desc->PhysicalStart;
-		memmap->entries[i].length = (uint64_t)(desc->NumberOfPages * PAGE_SIZE);
+		entry->base = (uint64_t)desc->PhysicalStart;
+		entry->length = (uint64_t)(desc->NumberOfPages * PAGE_SIZE);
+		entry->flags = (desc->Attribute & EFI_MEMORY_MORE_RELIABLE) ? MEMMAP_FLAG_MIRRORED : 0;
+		entry->proximity = MEMMAP_NO_PROXIMITY;
+
+		if (desc->Type == AXBOOT_MEMORY_RECLAIMABLE) {
+			entry->type = MemoryMapLoader;
+			memmap->entry_count++;
+			continue;
+		}
 
 		switch (desc->Type) {
 			case EfiReservedMemoryType:
 			case EfiPalCode:
-				memmap->entries[i].type = MemoryMapReserved;
+				entry->type = MemoryMapReserved;
 				break;
 			case EfiLoaderCode:
 			case EfiLoaderData:
 			case EfiBootServicesCode:
 			case EfiBootServicesData:
 			case EfiConventionalMemory:
+				// the firmware keeps specific-purpose memory out of its own allocations too
+				entry->type = (desc->Attribute & EFI_MEMORY_SP) ? MemoryMapSpecificPurpose : MemoryMapUsable;
+				break;
 			case EfiPersistentMemory:
-				memmap->entries[i].type = MemoryMapUsable;
+				entry->type = MemoryMapPersistent;
 				break;
 			case EfiUnusableMemory:
-				memmap->entries[i].type = MemoryMapUnusable;
+				entry->type = MemoryMapUnusable;
 				break;
 			case EfiACPIReclaimMemory:
-				memmap->entries[i].type = MemoryMapAcpiReclaimable;
+				entry->type = MemoryMapAcpiReclaimable;
 				break;
 			case EfiRuntimeServicesCode:
 			case EfiRuntimeServicesData:
 			case EfiACPIMemoryNVS:
-				memmap->entries[i].type = MemoryMapAcpiNVS;
+				entry->type = MemoryMapAcpiNVS;
 				break;
 			case EfiMemoryMappedIO:
 			case EfiMemoryMappedIOPortSpace:
-				memmap->entries[i].type = MemoryMapMmio;
+				entry->type = MemoryMapMmio;
 				break;
 			default:
 				debug("Unknown memory type %x; marking as unusable\r\n", desc->Type);
-				memmap->entries[i].type = MemoryMapUnusable;
+				entry->type = MemoryMapUnusable;
 				break;
 		}
-	}
 
-    // check for overlapping entries and merge them
-	for (int i = 0; i < memmap->entry_count; i++) {
-		struct memory_map_entry *entry = &memmap->entries[i];
-	
-		// are we on the last entry?
-		if (i == memmap->entry_count - 1) {
-			break;
-		}
-	
-		if (entry->length == 0) {
-			for (int j = i; j < memmap->entry_count; j++) {
-				memmap->entries[j] = memmap->entries[j + 1];
-			}
-		}
-	
-		struct memory_map_entry *next_entry = &memmap->entries[i+1];
-
-		uint64_t entry_end = (uint64_t)entry->base + entry->length;
-		if (entry_end >= next_entry->base) {
-			if (entry->type == next_entry->type) {
-				// two consecutive entries are the same, so just merge them
-				entry->length += next_entry->length;
-	
-				for (int j = i + 1; j < memmap->entry_count; j++) {
-					memmap->entries[j] = memmap->entries[j + 1];
-				}
-	
-				memmap->entry_count--;
-				i--;
-				continue;
-			}
-		}
+		memmap->entry_count++;
 	}
+
+	free(map);
+	arena_reset(&g_loader_arena, scratch);
+
+	memmap_normalize(memmap);
 }
 
-void uefi_exit_boot_services(void)
+// The buffer ExitBootServices() takes its memory map into; allocated
+// ahead of time so nothing is allocated after the kernel's map is taken
+static EFI_MEMORY_DESCRIPTOR *exit_map = NULL;
+static EFI_UINTN exit_map_size = 0;
+
+// whatever gets allocated between the reservation and the kernel's
+// memory map may split a few more descriptors
+#define EXIT_MAP_SLACK 16
+
+static void exit_map_alloc(EFI_UINTN extra)
 {
 	EFI_STATUS status;
-	EFI_MEMORY_DESCRIPTOR *map = NULL;
 	EFI_UINTN size = 0;
 	EFI_UINTN key = 0;
 	EFI_UINTN desc_size = 0;
 	EFI_UINT32 desc_ver = 0;
-	EFI_UINT32 retries = 0;
 
-	status = gSystemTable->BootServices->GetMemoryMap(&size, map, &key, &desc_size, &desc_ver);
+	status = gSystemTable->BootServices->GetMemoryMap(&size, NULL, &key, &desc_size, &desc_ver);
 	if (EFI_ERROR(status) && status != EFI_BUFFER_TOO_SMALL) {
 		debug("ERROR: Failed to acquire memory map (step 1): 0x%lx\r\n", status);
 		return;
 	}
 
-	size += desc_size * 2;
-	map = (EFI_MEMORY_DESCRIPTOR *)malloc(size);
+	size += desc_size * extra;
+	exit_map = (EFI_MEMORY_DESCRIPTOR *)malloc(size);
+	exit_map_size = (exit_map != NULL) ? size : 0;
+}
+
+void fw_reserve_exit_map(void)
+{
+	if (exit_map == NULL) {
+		exit_map_alloc(EXIT_MAP_SLACK);
+	}
+}
+
+void uefi_exit_boot_services(void)
+{
+	EFI_STATUS status;
+	EFI_UINTN size = 0;
+	EFI_UINTN key = 0;
+	EFI_UINTN desc_size = 0;
+	EFI_UINT32 desc_ver = 0;
+	EFI_UINT32 retries = 0;
+
+	if (exit_map == NULL) {
+		exit_map_alloc(2);
+		if (exit_map == NULL) {
+			return;
+		}
+	}
 
 #define MAX_RETRIES 10
 
+	timestamp_record(TimestampExitBootServicesEntry);
 	do {
 		debug("Exitting Boot Services: Attempt %u/%u\r\n", retries + 1, MAX_RETRIES);
 
-		status = gSystemTable->BootServices->GetMemoryMap(&size, map, &key, &desc_size, &desc_ver);
+		size = exit_map_size;
+		status = gSystemTable->BootServices->GetMemoryMap(&size, exit_map, &key, &desc_size, &desc_ver);
+		if (status == EFI_BUFFER_TOO_SMALL) {
+			// this allocation isn't in the kernel's memory map, but
+			// failing to leave would be worse
+			debug("The reserved memory map buffer is too small (%u < %u bytes)\r\n", exit_map_size, size);
+			exit_map = NULL;
+			exit_map_alloc(2);
+			if (exit_map == NULL) {
+				continue;
+			}
+			size = exit_map_size;
+			status = gSystemTable->BootServices->GetMemoryMap(&size, exit_map, &key, &desc_size, &desc_ver);
+		}
 		if (EFI_ERROR(status)) {
 			debug("Failed to acquire memory map: 0x%lx\r\n", status);
 		}
@@ -179,9 +232,12 @@ void uefi_exit_boot_services(void)
 		}
 
 	} while (retries++ < MAX_RETRIES && EFI_ERROR(status));
+	timestamp_record(TimestampExitBootServicesExit);
 
-	if (retries == MAX_RETRIES) {
+	// retries runs one past MAX_RETRIES when the loop gives up
+	if (EFI_ERROR(status)) {
 		debug("ERROR: Failed to exit boot services!\r\n");
+		logring_drain(LOG_SINKS_ALL, 0);
 		// TODO: die?
 		while (1);
 	}
@@ -19,6 +19,8 @@
 
 #include <firmware/memory.h>
 #include <firmware/firmware.h>
+#include <uefi/firmware/memory.h>
+#include <lib/memstat.h>
 #include <print.h>
 #include <efi.h>
 #include <efilib.h>
@@ -30,6 +32,7 @@ void *fw_allocmem(size_t size)
 	void *ptr = NULL;
 	EFI_STATUS status;
 
+	memstat_fw_call();
 	status = gSystemTable->BootServices->AllocatePool(EfiLoaderData, (EFI_UINTN)size, &ptr);
 	if (EFI_ERROR(status)) {
 		debug("ERROR: Failed to allocate memory: 0x%x\r\n", status);
@@ -43,6 +46,7 @@ int fw_allocpage(size_t np, void *base)
 {
 	EFI_STATUS status;
 	
+	memstat_fw_call();
 	status = gSystemTable->BootServices->AllocatePages(AllocateAddress, 0x80000000, (EFI_UINTN)np, (EFI_PHYSICAL_ADDRESS *)base);
 	if (EFI_ERROR(status)) {
 		debug("ERROR: Failed to allocate %u pages at address 0x%x: 0x%x\r\n", np, base, status);
@@ -57,5 +61,86 @@ void fw_free(void *p)
 	if (p == NULL)
 		return;
 
+	memstat_fw_call();
 	gSystemTable->BootServices->FreePool(p);
-}
\ No newline at end of file
+}
+
+static uint64_t preferred_base = 0;
+static uint64_t preferred_length = 0;
+
+void fw_set_preferred_memory(uint64_t base, uint64_t length)
+{
+	preferred_base = base;
+	preferred_length = length;
+}
+
+// Firmware allocates top-down below the limit, so this lands in the
+// preferred range unless it's full; then it's given back.
+static void *fw_allocpages_preferred(size_t np, EFI_MEMORY_TYPE efi_type)
+{
+	EFI_PHYSICAL_ADDRESS addr = preferred_base + preferred_length - 1;
+	EFI_STATUS status;
+
+	memstat_fw_call();
+	status = gSystemTable->BootServices->AllocatePages(AllocateMaxAddress, efi_type, (EFI_UINTN)np, &addr);
+	if (EFI_ERROR(status)) {
+		return NULL;
+	}
+
+	if (addr < preferred_base) {
+		fw_freepages((void *)addr, np);
+		return NULL;
+	}
+
+	return (void *)addr;
+}
+
+void *fw_allocpages(size_t np, int type)
+{
+	EFI_PHYSICAL_ADDRESS addr = 0;
+	EFI_MEMORY_TYPE efi_type = EfiLoaderData;
+	EFI_STATUS status;
+	void *p;
+
+	if (type == FwMemoryReclaimable) {
+		efi_type = AXBOOT_MEMORY_RECLAIMABLE;
+	}
+
+	if (preferred_length != 0 && (p = fw_allocpages_preferred(np, efi_type)) != NULL) {
+		return p;
+	}
+
+	memstat_fw_call();
+	status = gSystemTable->BootServices->AllocatePages(AllocateAnyPages, efi_type, (EFI_UINTN)np, &addr);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to allocate %u pages: 0x%x\r\n", np, status);
+		return NULL;
+	}
+
+	return (void *)addr;
+}
+
+void *fw_allocpages_below(size_t np, uint64_t limit, int type)
+{
+	EFI_PHYSICAL_ADDRESS addr = limit - 1;
+	EFI_MEMORY_TYPE efi_type = (type == FwMemoryReclaimable) ? AXBOOT_MEMORY_RECLAIMABLE : EfiLoaderData;
+	EFI_STATUS status;
+
+	memstat_fw_call();
+	status = gSystemTable->BootServices->AllocatePages(AllocateMaxAddress, efi_type, (EFI_UINTN)np, &addr);
+	if (EFI_ERROR(status)) {
+		debug("ERROR: Failed to allocate %u pages below 0x%llx: 0x%x\r\n", np, limit, status);
+		return NULL;
+	}
+
+	return (void *)addr;
+}
+
+void fw_freepages(void *base, size_t np)
+{
+	if (base == NULL)
+		return;
+
+	memstat_fw_call();
+	gSystemTable->BootServices->FreePages((EFI_PHYSICAL_ADDRESS)base, (EFI_UINTN)np);
+}
@@ -0,0 +1,137 @@
+/*********************************************************************************/
+/* Module Name:  serial.c                                                        */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <firmware/firmware.h>
+#include <firmware/serial.h>
+#include <efi.h>
+#include <efilib.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// device path nodes naming a 16550 COM port: ACPI PNP0501, with the UID
+// counting from COM1
+#define DEVICE_PATH_TYPE_ACPI 0x02
+#define DEVICE_PATH_SUBTYPE_ACPI 0x01
+#define DEVICE_PATH_TYPE_END 0x7f
+#define DEVICE_PATH_PNP0501 0x050141d0
+
+static EFI_SERIAL_IO_PROTOCOL *serial_io = NULL;
+
+int fw_serial_init(uint32_t baud)
+{
+	EFI_STATUS status;
+	EFI_GUID serial_io_guid = EFI_SERIAL_IO_PROTOCOL_GUID;
+
+	status = gSystemTable->BootServices->LocateProtocol(&serial_io_guid,
+														NULL,
+														(VOID **)&serial_io);
+	if (EFI_ERROR(status)) {
+		serial_io = NULL;
+		return -1;
+	}
+
+	// keep the firmware's FIFO depth, timeout and framing
+	if (baud != 0) {
+		status = serial_io->SetAttributes(serial_io, baud, 0, 0, DefaultParity, 0, DefaultStopBits);
+		if (EFI_ERROR(status)) {
+			serial_io = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int fw_serial_write(const void *buffer, size_t size)
+{
+	EFI_UINTN written = size;
+
+	if (serial_io == NULL) {
+		return -1;
+	}
+
+	if (EFI_ERROR(serial_io->Write(serial_io, &written, (VOID *)buffer)) || written != size) {
+		return -1;
+	}
+
+	return 0;
+}
+
+// Walks the device path of the handle serial_io came from
+int fw_serial_get_com_index(uint32_t *index)
+{
+	EFI_STATUS status;
+	EFI_GUID serial_io_guid = EFI_SERIAL_IO_PROTOCOL_GUID;
+	EFI_GUID device_path_guid = EFI_DEVICE_PATH_PROTOCOL_GUID;
+	EFI_HANDLE *handles = NULL;
+	EFI_UINTN handle_count = 0;
+	int ret = -1;
+
+	if (serial_io == NULL) {
+		return -1;
+	}
+
+	status = gSystemTable->BootServices->LocateHandleBuffer(ByProtocol, &serial_io_guid, NULL, &handle_count, &handles);
+	if (EFI_ERROR(status)) {
+		return -1;
+	}
+
+	for (EFI_UINTN i = 0; i < handle_count; i++) {
+		VOID *interface = NULL;
+		uint8_t *node = NULL;
+
+		status = gSystemTable->BootServices->HandleProtocol(handles[i], &serial_io_guid, &interface);
+		if (EFI_ERROR(status) || interface != serial_io) {
+			continue;
+		}
+
+		status = gSystemTable->BootServices->HandleProtocol(handles[i], &device_path_guid, (VOID **)&node);
+		if (EFI_ERROR(status)) {
+			break;
+		}
+
+		// nodes are a type, a subtype and a 16-bit length, packed
+		while (node[0] != DEVICE_PATH_TYPE_END) {
+			uint16_t length = node[2] | (node[3] << 8);
+
+			if (length < 4) {
+				break;
+			}
+
+			if (node[0] == DEVICE_PATH_TYPE_ACPI && node[1] == DEVICE_PATH_SUBTYPE_ACPI && length >= 12 &&
+				*(uint32_t *)(node + 4) == DEVICE_PATH_PNP0501) {
+				*index = *(uint32_t *)(node + 8);
+				ret = 0;
+				break;
+			}
+
+			node += length;
+		}
+		break;
+	}
+
+	gSystemTable->BootServices->FreePool(handles);
+	return ret;
+}
+
+void fw_serial_release(void)
+{
+	serial_io = NULL;
+}
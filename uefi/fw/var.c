@@ -0,0 +1,89 @@
+/*********************************************************************************/
+/* Module Name:  var.c                                                           */
+/* Project:      AurixOS                                                         */
+/*                                                                               */
+/* Copyright (c) 2024 Jozef Nagy                                                 */
+/*                                                                               */
+/* This source is subject to the MIT License.                                    */
+/* See License.txt in the root of this repository.                               */
+/* All other rights reserved.                                                    */
+/*                                                                               */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE.                                                                     */
+/*********************************************************************************/
+
+#include <firmware/firmware.h>
+#include <firmware/var.h>
+#include <lib/string.h>
+#include <print.h>
+#include <efi.h>
+#include <efilib.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AXBOOT_VAR_NAME_MAX 64
+
+// {8a6f3c21-5b9e-4d2a-9c41-7e13b05d62f8}
+static EFI_GUID axboot_vendor_guid = {0x8a6f3c21, 0x5b9e, 0x4d2a, {0x9c, 0x41, 0x7e, 0x13, 0xb0, 0x5d, 0x62, 0xf8}};
+
+static int var_name(const char *name, CHAR16 *wname)
+{
+	size_t len = strlen(name);
+
+	if (len >= AXBOOT_VAR_NAME_MAX) {
+		debug("ERROR: Variable name '%s' is too long\r\n", name);
+		return -1;
+	}
+
+	mbstowcs(wname, &name, len);
+	wname[len] = '\0';
+	return 0;
+}
+
+int fw_var_get(const char *name, void *buffer, uint64_t size)
+{
+	EFI_STATUS Status;
+	CHAR16 wname[AXBOOT_VAR_NAME_MAX];
+	EFI_UINTN var_size = size;
+	EFI_UINT32 attributes = 0;
+
+	if (var_name(name, wname) != 0) {
+		return -1;
+	}
+
+	Status = gSystemTable->RuntimeServices->GetVariable(wname, &axboot_vendor_guid, &attributes, &var_size, buffer);
+	if (EFI_ERROR(Status)) {
+		if (Status != EFI_NOT_FOUND) {
+			debug("Couldn't read variable '%s': %x\r\n", name, Status);
+		}
+		return -1;
+	}
+
+	return (int)var_size;
+}
+
+int fw_var_set(const char *name, const void *buffer, uint64_t size)
+{
+	EFI_STATUS Status;
+	CHAR16 wname[AXBOOT_VAR_NAME_MAX];
+
+	if (var_name(name, wname) != 0) {
+		return -1;
+	}
+
+	Status = gSystemTable->RuntimeServices->SetVariable(wname, &axboot_vendor_guid,
+														EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+														size, (void *)buffer);
+	if (EFI_ERROR(Status)) {
+		debug("Couldn't write variable '%s': %x\r\n", name, Status);
+		return -1;
+	}
+
+	return 0;
+}